@@ -0,0 +1,167 @@
+/* One texture holding every body's surface. */
+
+#include "atlas.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Blocks are aligned to this, so that mip levels up to atlasLevels divide
+// them evenly, and DXT1 ones into whole compressed blocks.
+static int blockAlignment(int gutter) {
+	return std::max(gutter, 1 << atlasLevels);
+}
+
+int atlasBlockSize(int size, int gutter) {
+	int alignment = blockAlignment(gutter);
+	return (size + 2 * gutter + alignment - 1) & ~(alignment - 1);
+}
+
+static bool tallerFirst(const AtlasSlot *a, const AtlasSlot *b) {
+	return a->height > b->height;
+}
+
+// Places the slots on shelves of the given width, in order, and returns
+// the height used.
+static int packShelves(std::vector<AtlasSlot *> &slots, int width,
+		int gutter) {
+	int x = 0, y = 0, shelfHeight = 0;
+	for (size_t i = 0; i < slots.size(); i++) {
+		AtlasSlot &slot = *slots[i];
+		int w = atlasBlockSize(slot.width, gutter);
+		int h = atlasBlockSize(slot.height, gutter);
+		if (x + w > width) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		slot.x = x;
+		slot.y = y;
+		x += w;
+		shelfHeight = std::max(shelfHeight, h);
+	}
+	return y + shelfHeight;
+}
+
+bool layoutAtlas(std::vector<AtlasSlot> &slots, int maxSize, int *width,
+		int *height, int gutter) {
+	*width = *height = 0;
+	if (slots.empty())
+		return true;
+	if (slots.size() == 1) {
+		slots[0].x = slots[0].y = 0;
+		*width = atlasBlockSize(slots[0].width, gutter);
+		*height = atlasBlockSize(slots[0].height, gutter);
+		return *width <= maxSize && *height <= maxSize;
+	}
+
+	std::vector<AtlasSlot *> order;
+	long area = 0;
+	int widest = 0;
+	for (size_t i = 0; i < slots.size(); i++) {
+		int w = atlasBlockSize(slots[i].width, gutter);
+		order.push_back(&slots[i]);
+		area += (long) w * atlasBlockSize(slots[i].height, gutter);
+		widest = std::max(widest, w);
+	}
+	// the narrowest power of two that is about square, or fits the widest
+	std::stable_sort(order.begin(), order.end(), tallerFirst);
+	int w = blockAlignment(gutter);
+	while (w < widest || (long) w * w < area)
+		w *= 2;
+	*width = w;
+	*height = packShelves(order, w, gutter);
+	return *width <= maxSize && *height <= maxSize;
+}
+
+AtlasRect atlasRect(const AtlasSlot &slot, int width, int height,
+		int gutter) {
+	AtlasRect rect;
+	rect.s = (GLfloat) (slot.x + gutter) / width;
+	rect.t = (GLfloat) (slot.y + gutter) / height;
+	rect.width = (GLfloat) slot.width / width;
+	rect.height = (GLfloat) slot.height / height;
+	return rect;
+}
+
+void fillAtlasBlock(const AtlasSlot &slot, const unsigned char *rgb,
+		size_t stride, AtlasBlock &block, bool bgr) {
+	block.width = atlasBlockSize(slot.width);
+	block.height = atlasBlockSize(slot.height);
+
+	// the surface, clamped into the gutter and the alignment beyond it, red
+	// taken from byte red of each source texel and blue from the other end
+	int red = bgr ? 2 : 0;
+	std::vector<unsigned char> &base = block.levels[0];
+	base.resize(3 * (size_t) block.width * block.height);
+	for (int y = 0; y < block.height; y++) {
+		int sy = std::min(std::max(y - atlasGutter, 0), slot.height - 1);
+		const unsigned char *source = rgb + sy * stride;
+		unsigned char *row = &base[3 * (size_t) y * block.width];
+		for (int x = 0; x < block.width; x++) {
+			int sx = std::min(std::max(x - atlasGutter, 0), slot.width - 1);
+			row[3 * x] = source[3 * sx + red];
+			row[3 * x + 1] = source[3 * sx + 1];
+			row[3 * x + 2] = source[3 * sx + 2 - red];
+		}
+	}
+
+	// each level the average of four texels of the one above, as
+	// glGenerateMipmap would have it
+	for (int k = 1; k <= atlasLevels; k++) {
+		const std::vector<unsigned char> &above = block.levels[k - 1];
+		int aboveWidth = block.width >> (k - 1);
+		int w = block.width >> k, h = block.height >> k;
+		std::vector<unsigned char> &level = block.levels[k];
+		level.resize(3 * (size_t) w * h);
+		for (int y = 0; y < h; y++) {
+			const unsigned char *a = &above[3 * (size_t) (2 * y) * aboveWidth];
+			const unsigned char *b = a + 3 * aboveWidth;
+			unsigned char *row = &level[3 * (size_t) y * w];
+			for (int x = 0; x < 3 * w; x++) {
+				int c = x % 3, i = 2 * (x - c) + c;
+				row[x] = (unsigned char) ((a[i] + a[i + 3] + b[i] + b[i + 3] + 2)
+						/ 4);
+			}
+		}
+	}
+}
+
+void fillCompressedAtlasBlock(const AtlasSlot &slot,
+		const unsigned char *const levels[atlasLevels + 1], AtlasBlock &block) {
+	block.width = atlasBlockSize(slot.width, atlasCompressedGutter);
+	block.height = atlasBlockSize(slot.height, atlasCompressedGutter);
+
+	for (int k = 0; k <= atlasLevels; k++) {
+		int w = std::max(slot.width >> k, 1), h = std::max(slot.height >> k, 1);
+		int gutter = atlasCompressedGutter >> k;
+		int sourceWide = (w + 3) / 4;
+		int blocksWide = (block.width >> k) / 4;
+		int blocksHigh = (block.height >> k) / 4;
+		std::vector<unsigned char> &level = block.levels[k];
+		level.assign(8 * (size_t) blocksWide * blocksHigh, 0);
+		for (int by = 0; by < blocksHigh; by++) {
+			for (int bx = 0; bx < blocksWide; bx++) {
+				// the gutter is whole blocks, so every texel of this block
+				// clamps into the same block of the surface
+				int x0 = 4 * bx - gutter, y0 = 4 * by - gutter;
+				int sx = std::min(std::max(x0, 0), w - 1) / 4;
+				int sy = std::min(std::max(y0, 0), h - 1) / 4;
+				const unsigned char *source =
+						levels[k] + 8 * ((size_t) sy * sourceWide + sx);
+				unsigned char *out =
+						&level[8 * ((size_t) by * blocksWide + bx)];
+				// the same two colours, and each texel the index of the
+				// texel it clamps to
+				memcpy(out, source, 4);
+				for (int r = 0; r < 4; r++) {
+					int ty = std::min(std::max(y0 + r, 0), h - 1) - 4 * sy;
+					for (int c = 0; c < 4; c++) {
+						int tx = std::min(std::max(x0 + c, 0), w - 1) - 4 * sx;
+						int index = (source[4 + ty] >> (2 * tx)) & 3;
+						out[4 + r] |= (unsigned char) (index << (2 * c));
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/* One texture holding every body's surface.
+ *
+ * The surfaces are placed on the shelves of a single atlas from their
+ * sizes alone, each in a block surrounded by a gutter of repeated edge
+ * texels so that filtering and the first few mip levels never reach a
+ * neighbour. Blocks start and end on multiples of 1 << atlasLevels, so mip
+ * level k of a block is exactly the block shifted down by k, and every
+ * block can be filled on its own, levels included. Bodies then find their
+ * surface through a rectangle of the atlas, applied with the texture
+ * matrix, and all of them share one texture object and one bind.
+ *
+ * Surfaces compressed to DXT1 keep to atlases of their own, whose wider
+ * gutters and blocks leave every level in whole 4x4 compressed blocks. The
+ * gutter's blocks are then those at the surface's edges with their texel
+ * indices clamped, so the surface is never decoded and encoded again.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <stddef.h>
+#include <vector>
+
+// Where a surface lies in its texture, in texture coordinates.
+struct AtlasRect {
+	GLfloat s, t, width, height;
+};
+
+// The whole of a texture.
+const AtlasRect wholeTexture = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+// Texels of repeated edge around every surface. Mip level k still has
+// atlasGutter >> k of them, so levels up to atlasLevels stay clean.
+const int atlasGutter = 8;
+const int atlasLevels = 3;
+// The gutter of DXT1 atlases, whose level atlasLevels still has 4 texels.
+const int atlasCompressedGutter = 4 << atlasLevels;
+
+// One surface's block of the atlas.
+struct AtlasSlot {
+	int width, height;  // of the surface
+	int x, y;           // of the block's corner, set by layoutAtlas
+};
+
+// Width or height of the block around a surface of the given size, in an
+// atlas with the given gutter.
+int atlasBlockSize(int size, int gutter = atlasGutter);
+
+// Places the slots on the shelves of one atlas, tallest first, in the
+// narrowest power of two that is about square, and sets its size. A single
+// slot gets an atlas of just its block. Returns false if the atlas would
+// exceed maxSize on either side.
+bool layoutAtlas(std::vector<AtlasSlot> &slots, int maxSize, int *width,
+		int *height, int gutter = atlasGutter);
+
+// The surface of slot within an atlas of the given size.
+AtlasRect atlasRect(const AtlasSlot &slot, int width, int height,
+		int gutter = atlasGutter);
+
+// A slot's block as it is uploaded: RGB, tightly packed, or DXT1 blocks,
+// bottom row first, one array per mip level.
+struct AtlasBlock {
+	int width, height;  // of level 0
+	std::vector<unsigned char> levels[atlasLevels + 1];
+};
+
+// Copies an RGB surface, or with bgr a BGR one, whose rows lie stride bytes
+// apart, into the block of slot as RGB, clamping its edges into the gutter,
+// and box filters the mip levels below it. Runs on any thread.
+void fillAtlasBlock(const AtlasSlot &slot, const unsigned char *rgb,
+		size_t stride, AtlasBlock &block, bool bgr = false);
+
+// Fills the block of slot, in an atlas with atlasCompressedGutter, from the
+// DXT1 levels 0 to atlasLevels of a surface, level k being the surface's
+// size shifted down by k, at least 1. Runs on any thread.
+void fillCompressedAtlasBlock(const AtlasSlot &slot,
+		const unsigned char *const levels[atlasLevels + 1], AtlasBlock &block);
+
+#endif
@@ -0,0 +1,429 @@
+/* Table of every body in the scene, loaded from a text file. */
+
+#include "bodies.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "threadpool.h"
+
+static int findBody(const BodyTable &table, const char *name) {
+	for (int i = 0; i < table.count; i++)
+		if (table.name[i] == name)
+			return i;
+	return -1;
+}
+
+// Orbital elements of one body, in degrees.
+struct OrbitElements {
+	float eccentricity, inclination, node, periapsis, meanAnomaly;
+};
+
+// Turns the axes of orbit index into the frame q.
+static void rotateOrbit(KeplerOrbits &orbits, int index, const Quaternion &q) {
+	double p[3] = { orbits.px[index], orbits.py[index], orbits.pz[index] };
+	double r[3] = { orbits.qx[index], orbits.qy[index], orbits.qz[index] };
+	quaternionRotate(q, p);
+	quaternionRotate(q, r);
+	orbits.px[index] = p[0];
+	orbits.py[index] = p[1];
+	orbits.pz[index] = p[2];
+	orbits.qx[index] = r[0];
+	orbits.qy[index] = r[1];
+	orbits.qz[index] = r[2];
+}
+
+static void addBody(BodyTable *table, const std::string &name, int shape,
+		int parent, float distance, float radius, float inner, float year,
+		float day, const OrbitElements &orbit, float mass, float tilt,
+		int slices, int stacks, const std::string &texture) {
+	table->name.push_back(name);
+	table->shape.push_back(shape);
+	table->parent.push_back(parent);
+	table->distance.push_back(distance);
+	table->radius.push_back(radius);
+	table->innerRadius.push_back(inner);
+	table->yearRate.push_back(year);
+	table->dayRate.push_back(day);
+	table->eccentricity.push_back(orbit.eccentricity);
+	table->inclination.push_back(orbit.inclination);
+	table->node.push_back(orbit.node);
+	table->periapsis.push_back(orbit.periapsis);
+	table->meanAnomaly.push_back(orbit.meanAnomaly);
+	table->mass.push_back(mass);
+	table->tilt.push_back(tilt);
+	// the tilt is about x, in the same sense as an inclination
+	const Quaternion parentFrame = parent >= 0 ? table->frame[parent]
+			: identityQuaternion;
+	table->frame.push_back(quaternionMultiply(parentFrame,
+			quaternionAxisAngle(tilt, 1.0f, 0.0f, 0.0f)));
+	addKeplerOrbit(table->orbits, distance, orbit.eccentricity,
+			orbit.inclination, orbit.node, orbit.periapsis, orbit.meanAnomaly,
+			year != 0.0f ? 365.25 / year : 0.0);
+	rotateOrbit(table->orbits, table->count, parentFrame);
+	table->slices.push_back(slices);
+	table->stacks.push_back(stacks);
+	table->textureFile.push_back(texture);
+	table->count++;
+}
+
+// Sizes the GL resources to the number of bodies.
+static void resizeBodyResources(BodyTable *table) {
+	table->texture.resize(table->count, 0);
+	table->textureRect.resize(table->count, wholeTexture);
+	table->placeholderTexture.resize(table->count, 0);
+	table->textureReady.resize(table->count, 1);
+	table->mesh.resize(table->count);
+	table->color.resize(3 * table->count, 1.0f);
+}
+
+bool loadBodyTable(const char *filename, BodyTable *table) {
+	FILE *file;
+	char line[512];
+	int lineNumber = 0;
+
+	if ((file = fopen(filename, "r")) == NULL) {
+		printf("File Not Found : %s\n", filename);
+		return false;
+	}
+
+	table->count = 0;
+	table->ephemeris = NULL;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[64], shape[16], parent[64], texture[256];
+		float distance, radius, inner, year, day;
+		int slices, stacks;
+		OrbitElements orbit = { 0, 0, 0, 0, 0 };
+		float mass = 0.0f, tilt = 0.0f;
+
+		lineNumber++;
+		// skip blank lines and comments
+		char *p = line + strspn(line, " \t\r\n");
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		int columns = sscanf(p,
+				"%63s %15s %63s %f %f %f %f %f %d %d %255s %f %f %f %f %f %f %f",
+				name, shape, parent, &distance, &radius, &inner, &year, &day,
+				&slices, &stacks, texture, &orbit.eccentricity,
+				&orbit.inclination, &orbit.node, &orbit.periapsis,
+				&orbit.meanAnomaly, &mass, &tilt);
+		if (columns != 11 && columns < 16) {
+			printf("%s:%d: expected 11, 16, 17 or 18 columns\n", filename,
+					lineNumber);
+			fclose(file);
+			return false;
+		}
+		if (orbit.eccentricity < 0.0f || orbit.eccentricity >= 1.0f) {
+			printf("%s:%d: eccentricity of %s must be in [0, 1)\n", filename,
+					lineNumber, name);
+			fclose(file);
+			return false;
+		}
+		if (mass < 0.0f) {
+			printf("%s:%d: mass of %s is negative\n", filename, lineNumber,
+					name);
+			fclose(file);
+			return false;
+		}
+
+		int parentIndex = -1;
+		if (strcmp(parent, "-") != 0
+				&& (parentIndex = findBody(*table, parent)) < 0) {
+			printf("%s:%d: parent %s must be listed before %s\n", filename,
+					lineNumber, parent, name);
+			fclose(file);
+			return false;
+		}
+
+		int shapeIndex;
+		if (strcmp(shape, "sphere") == 0)
+			shapeIndex = SHAPE_SPHERE;
+		else if (strcmp(shape, "ring") == 0)
+			shapeIndex = SHAPE_RING;
+		else if (strcmp(shape, "belt") == 0)
+			shapeIndex = SHAPE_BELT;
+		else {
+			printf("%s:%d: unknown shape %s\n", filename, lineNumber, shape);
+			fclose(file);
+			return false;
+		}
+
+		if (shapeIndex == SHAPE_BELT) {
+			if (slices < 0 || inner <= 0.0f || radius < inner) {
+				printf("%s:%d: belt %s needs a body count and 0 < inner <= "
+						"radius\n", filename, lineNumber, name);
+				fclose(file);
+				return false;
+			}
+		} else if (slices < 3 || stacks < 1) {
+			printf("%s:%d: tessellation of %s is too coarse\n", filename,
+					lineNumber, name);
+			fclose(file);
+			return false;
+		}
+
+		addBody(table, name, shapeIndex, parentIndex, distance, radius, inner,
+				year, day, orbit, mass, tilt, slices, stacks,
+				strcmp(texture, "-") == 0 ? "" : texture);
+	}
+	fclose(file);
+
+	resizeBodyResources(table);
+	return true;
+}
+
+void addSyntheticBodies(BodyTable &table, int total, unsigned seed) {
+	// the listed planets lend the new ones a texture and a parent; moons
+	// are made below, around any planet
+	std::vector<int> templates, planets;
+	for (int i = 0; i < table.count; i++)
+		if (table.shape[i] == SHAPE_SPHERE && table.parent[i] >= 0
+				&& table.parent[table.parent[i]] < 0) {
+			templates.push_back(i);
+			planets.push_back(i);
+		}
+
+	for (int n = 0; table.count < total; n++) {
+		// a small linear congruential generator keeps runs reproducible
+		float r[10];
+		for (int k = 0; k < 10; k++) {
+			seed = seed * 1664525u + 1013904223u;
+			r[k] = (float) (seed >> 8) / (float) (1 << 24);
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "synthetic%d", n);
+		float distance = 2.0f + 14.0f * r[0];
+		// Kepler's third law, relative to Earth at distance 5
+		float year = powf(5.0f / distance, 1.5f);
+		float radius = 0.03f + 0.15f * r[2];
+		std::string texture;
+		int parent = -1;
+		if (!templates.empty()) {
+			int t = templates[(int) (r[1] * templates.size()) % templates.size()];
+			texture = table.textureFile[t];
+			parent = table.parent[t];
+		}
+		// one in four goes round a planet instead, a few of its radii out
+		// and tidally locked
+		bool moon = r[9] < 0.25f && !planets.empty();
+		float day = 0.5f + r[3];
+		if (moon) {
+			parent = planets[(int) (r[0] * planets.size()) % planets.size()];
+			distance = table.radius[parent] * (2.0f + 4.0f * r[0]);
+			radius = table.radius[parent] * (0.05f + 0.2f * r[2]);
+			year = 5.0f + 100.0f * (1.0f - r[0]);
+			day = 0.0f;
+		}
+		// mildly eccentric and inclined, like the planets
+		OrbitElements orbit = { 0.1f * r[4], 5.0f * r[5], 360.0f * r[6],
+				360.0f * r[7], 360.0f * r[8] };
+		addBody(&table, name, SHAPE_SPHERE, parent, distance, radius, 0.0f,
+				year, day, orbit, 0.0f, 0.0f, 20, 20, texture);
+		if (!moon && parent >= 0 && table.parent[parent] < 0)
+			planets.push_back(table.count - 1);
+	}
+	resizeBodyResources(&table);
+}
+
+void generateBelts(BodyTable &table, int total, unsigned seed) {
+	long listed = 0;
+	for (int i = 0; i < table.count; i++)
+		if (table.shape[i] == SHAPE_BELT)
+			listed += table.slices[i];
+
+	table.beltOrbits = KeplerOrbits();
+	table.beltFirst.assign(table.count, 0);
+	table.beltCount.assign(table.count, 0);
+	int first = 0;
+	for (int i = 0; i < table.count; i++) {
+		if (table.shape[i] != SHAPE_BELT)
+			continue;
+		int count = table.slices[i];
+		if (total >= 0)
+			count = listed > 0 ? (int) ((long long) total * count / listed) : 0;
+		table.beltFirst[i] = first;
+		table.beltCount[i] = count;
+		first += count;
+
+		// Kepler's third law, relative to Earth at distance 5 around a
+		// parent of one solar mass
+		int p = table.parent[i];
+		double parentMass = p >= 0 && table.mass[p] > 0.0f ? table.mass[p] : 1.0;
+		for (int n = 0; n < count; n++) {
+			double r[6];
+			for (int k = 0; k < 6; k++) {
+				seed = seed * 1664525u + 1013904223u;
+				r[k] = (double) (seed >> 8) / (double) (1 << 24);
+			}
+			double a = table.innerRadius[i]
+					+ (table.radius[i] - table.innerRadius[i]) * r[0];
+			// most bodies keep close to the plane
+			addKeplerOrbit(table.beltOrbits, a, table.eccentricity[i] * r[1],
+					table.inclination[i] * r[2] * r[2], 360.0 * r[3],
+					360.0 * r[4], 360.0 * r[5],
+					365.25 * pow(a / 5.0, 1.5) / sqrt(parentMass));
+			if (p >= 0)
+				rotateOrbit(table.beltOrbits, first - count + n, table.frame[p]);
+		}
+	}
+}
+
+void createBodyMeshes(BodyTable &table) {
+	for (int i = 0; i < table.count; i++) {
+		if (table.shape[i] == SHAPE_BELT)
+			continue;
+		if (table.shape[i] == SHAPE_RING)
+			table.mesh[i] = ringMeshLod(table.innerRadius[i] / table.radius[i],
+					table.slices[i], table.stacks[i]);
+		else
+			table.mesh[i] = sphereMeshLod(table.slices[i], table.stacks[i]);
+	}
+}
+
+int attachEphemeris(BodyTable &table, const Ephemeris &ephemeris) {
+	table.ephemeris = &ephemeris;
+	table.ephemerisBody.assign(table.count, -1);
+	table.ephemerisScale.assign(table.count, 0.0);
+	int covered = 0;
+	for (int i = 0; i < table.count; i++) {
+		int body = findEphemerisBody(ephemeris, table.name[i].c_str());
+		if (body < 0 || table.shape[i] == SHAPE_BELT)
+			continue;
+		table.ephemerisBody[i] = body;
+		// the mean distance becomes the distance in the table
+		const double mean = ephemeris.bodies[body].meanDistance;
+		table.ephemerisScale[i] = mean > 0.0 ? table.distance[i] / mean : 0.0;
+		covered++;
+	}
+	return covered;
+}
+
+void resizeBodyState(BodyState &state, int count) {
+	state.yearAngle.resize(count, 0.0f);
+	state.dayAngle.resize(count, 0.0f);
+	state.x.resize(count, 0.0f);
+	state.y.resize(count, 0.0f);
+	state.z.resize(count, 0.0f);
+}
+
+void updateBodies(const BodyTable &table, double days, BodyState &state) {
+	const int n = table.count;
+	resizeBodyState(state, n);
+	float *yearAngle = &state.yearAngle[0];
+	float *dayAngle = &state.dayAngle[0];
+	float *x = &state.x[0], *y = &state.y[0], *z = &state.z[0];
+
+	// Earth years since the epoch; the angles are reduced in double so they
+	// stay exact however far the clock runs. The orbit angle is the mean
+	// longitude, which turns the body as it goes round.
+	double years = days / 365.25;
+	for (int i = 0; i < n; i++) {
+		double longitude = table.node[i] + table.periapsis[i]
+				+ table.meanAnomaly[i];
+		yearAngle[i] = (float) fmod(longitude + table.yearRate[i] * years * 360.0,
+				360.0);
+		dayAngle[i] = (float) fmod(table.dayRate[i] * years * 180.0, 360.0);
+	}
+
+	// positions around the parents, solved in batches across the pool
+	parallelFor(n, 4096, [&](int begin, int end) {
+		if (table.ephemeris == NULL) {
+			solveKeplerOrbits(table.orbits, days, begin, end, x + begin,
+					y + begin, z + begin);
+			return;
+		}
+		// the bodies the ephemeris covers break the batch into runs
+		int run = begin;
+		for (int i = begin; i <= end; i++) {
+			double xyz[3];
+			if (i < end && (table.ephemerisBody[i] < 0
+					|| !ephemerisPosition(*table.ephemeris,
+							table.ephemerisBody[i], days, xyz)))
+				continue;
+			if (i > run)
+				solveKeplerOrbits(table.orbits, days, run, i, x + run,
+						y + run, z + run);
+			run = i + 1;
+			if (i == end)
+				break;
+			// ecliptic x, y and z (north) become scene x, -z and y
+			const double scale = table.ephemerisScale[i];
+			x[i] = (float) (xyz[0] * scale);
+			y[i] = (float) (xyz[2] * scale);
+			z[i] = (float) (-xyz[1] * scale);
+		}
+	});
+
+	// parents come first, so their world positions are already final
+	for (int i = 0; i < n; i++) {
+		int p = table.parent[i];
+		if (p >= 0) {
+			x[i] += x[p];
+			y[i] += y[p];
+			z[i] += z[p];
+		}
+	}
+}
+
+// Belt bodies solved per batch; small enough to keep on the stack.
+static const int beltBatch = 1024;
+
+void updateBelts(const BodyTable &table, double days, BodyState &state) {
+	state.belt.resize(3 * table.beltOrbits.eccentricity.size());
+	for (int i = 0; i < (int) table.beltCount.size(); i++) {
+		if (table.beltCount[i] == 0)
+			continue;
+		const int first = table.beltFirst[i];
+		const float cx = state.x[i], cy = state.y[i], cz = state.z[i];
+		float *belt = &state.belt[0];
+		// solved in batches across the pool, then interleaved for drawing
+		parallelFor(table.beltCount[i], 4 * beltBatch, [&](int begin, int end) {
+			float x[beltBatch], y[beltBatch], z[beltBatch];
+			for (int b = first + begin; b < first + end; b += beltBatch) {
+				int n = first + end - b < beltBatch ? first + end - b : beltBatch;
+				solveKeplerOrbits(table.beltOrbits, days, b, b + n, x, y, z);
+				float *out = belt + 3 * b;
+				for (int k = 0; k < n; k++) {
+					out[3 * k] = cx + x[k];
+					out[3 * k + 1] = cy + y[k];
+					out[3 * k + 2] = cz + z[k];
+				}
+			}
+		});
+	}
+}
+
+// Angle a + (b - a) * t, going the shorter way from a to b.
+static inline float blendAngle(float a, float b, float t) {
+	float d = b - a;
+	d -= 360.0f * floorf(d / 360.0f + 0.5f);
+	return a + d * t;
+}
+
+// Blends two sets of points, or takes to's if they differ in size.
+static void blendPoints(const std::vector<float> &from,
+		const std::vector<float> &to, float t, std::vector<float> &out) {
+	out.resize(to.size());
+	if (from.size() == to.size())
+		for (size_t i = 0; i < to.size(); i++)
+			out[i] = from[i] + (to[i] - from[i]) * t;
+	else
+		out = to;
+}
+
+void interpolateBodies(const BodyState &from, const BodyState &to, float t,
+		BodyState &out) {
+	const int n = (int) to.x.size();
+	resizeBodyState(out, n);
+	for (int i = 0; i < n; i++) {
+		out.yearAngle[i] = blendAngle(from.yearAngle[i], to.yearAngle[i], t);
+		out.dayAngle[i] = blendAngle(from.dayAngle[i], to.dayAngle[i], t);
+		out.x[i] = from.x[i] + (to.x[i] - from.x[i]) * t;
+		out.y[i] = from.y[i] + (to.y[i] - from.y[i]) * t;
+		out.z[i] = from.z[i] + (to.z[i] - from.z[i]) * t;
+	}
+	blendPoints(from.points, to.points, t, out.points);
+	blendPoints(from.belt, to.belt, t, out.belt);
+}
@@ -0,0 +1,140 @@
+/* Table of every body in the scene, loaded from a text file.
+ *
+ * The table is stored as a structure of arrays: row i of every array
+ * describes body i. It doubles as a flat scene graph: parents always come
+ * before their children, so a single forward pass can resolve positions
+ * and orientations relative to a parent.
+ */
+
+#ifndef BODIES_H
+#define BODIES_H
+
+#include <GL/gl.h>
+#include <string>
+#include <vector>
+
+#include "atlas.h"
+#include "ephemeris.h"
+#include "kepler.h"
+#include "matrix.h"
+#include "mesh.h"
+
+enum BodyShape {
+	SHAPE_SPHERE, SHAPE_RING, SHAPE_BELT
+};
+
+struct BodyTable {
+	int count;
+
+	// static description, one entry per body
+	std::vector<std::string> name;
+	std::vector<int> shape;
+	std::vector<int> parent;        // index of the parent body, or -1
+	std::vector<float> distance;    // semi-major axis of the orbit
+	std::vector<float> radius;      // body radius (outer radius for rings)
+	std::vector<float> innerRadius; // inner radius of rings, 0 for spheres
+	std::vector<float> yearRate;    // orbits per Earth year
+	std::vector<float> dayRate;     // half turns of spin per Earth year
+	// shape of the orbit, angles in degrees at J2000
+	std::vector<float> eccentricity;
+	std::vector<float> inclination; // to the parent's equator
+	std::vector<float> node;        // longitude of the ascending node
+	std::vector<float> periapsis;   // argument of periapsis
+	std::vector<float> meanAnomaly;
+	std::vector<float> mass;        // in solar masses, for the gravity mode
+	std::vector<float> tilt;        // of the equator to the orbit, degrees
+	std::vector<int> slices;
+	std::vector<int> stacks;        // loops for rings
+	std::vector<std::string> textureFile;
+
+	// the orientation of every body's equator in the scene, its parent's
+	// turned by its tilt about x; orbits lie in the parent's frame
+	std::vector<Quaternion> frame;
+
+	// the orbits in the form the solver takes, built from the above and
+	// turned into the parents' frames
+	KeplerOrbits orbits;
+
+	// where an ephemeris covers a body, its positions come from there
+	// instead of its orbit: its index in the ephemeris, or -1, and the
+	// scale from the ephemeris's unit to the scene
+	const Ephemeris *ephemeris;  // or NULL
+	std::vector<int> ephemerisBody;
+	std::vector<double> ephemerisScale;
+
+	// the small bodies of every belt, one belt after another; row i owns
+	// beltCount[i] of them from beltFirst[i] on
+	KeplerOrbits beltOrbits;
+	std::vector<int> beltFirst, beltCount;
+
+	// GL resources, filled in once a context exists
+	std::vector<GLuint> texture;
+	std::vector<AtlasRect> textureRect; // the body's part of its texture
+	// shown until texture is complete, with the same rectangle
+	std::vector<GLuint> placeholderTexture;
+	std::vector<unsigned char> textureReady;
+	std::vector<MeshLod> mesh;      // unused for belts
+	std::vector<GLfloat> color;     // r, g and b seen from afar
+};
+
+// Where every body is at one moment, indexed like the table. Kept apart
+// from the table so that several moments can be held at once.
+struct BodyState {
+	std::vector<float> yearAngle;
+	std::vector<float> dayAngle;
+	std::vector<float> x, y, z;
+	// free particles that are drawn as points, x, y and z of each in turn
+	std::vector<float> points;
+	// the belt bodies, likewise
+	std::vector<float> belt;
+};
+
+// Reads the body table from filename. Each non-comment line holds
+//   name shape parent distance radius inner year day slices stacks texture
+// optionally followed by the orbital elements, the mass and the tilt
+//   eccentricity inclination node periapsis anomaly [mass [tilt]]
+// where shape is "sphere", "ring" or "belt" and parent is "-" or the name of
+// an earlier body. The elements are relative to the parent's equator, and
+// without them the orbit is a circle in it.
+// A belt is a ring of slices small bodies orbiting its parent between inner
+// and radius, with eccentricities and inclinations up to its elements'.
+// Returns false and prints the reason on a malformed file.
+bool loadBodyTable(const char *filename, BodyTable *table);
+
+// Appends generated planets, and moons of the planets, until the table
+// holds total bodies, for load testing. Orbits, sizes and textures are
+// drawn from seed, so equal seeds give equal tables.
+void addSyntheticBodies(BodyTable &table, int total, unsigned seed);
+
+// Generates the bodies of every belt, total of them shared among the belts
+// in proportion to their sizes in the table, or as many as the table says
+// when total is negative. Equal seeds give equal belts.
+void generateBelts(BodyTable &table, int total, unsigned seed);
+
+// Takes the positions of the bodies named in ephemeris from it, where it
+// covers them, instead of from their orbits. The ephemeris must outlive
+// the table, and the table gain no bodies after. Returns how many bodies
+// it covers.
+int attachEphemeris(BodyTable &table, const Ephemeris &ephemeris);
+
+// Builds the meshes of every body; needs a current GL context.
+void createBodyMeshes(BodyTable &table);
+
+// Sizes state for count bodies.
+void resizeBodyState(BodyState &state, int count);
+
+// Computes every body's angles and world position at days since J2000,
+// directly from the time, from its orbit or the ephemeris. Only reads the
+// table, so it may run on any thread.
+void updateBodies(const BodyTable &table, double days, BodyState &state);
+
+// Computes the positions of the belt bodies at days since J2000, around
+// where state already has their belts.
+void updateBelts(const BodyTable &table, double days, BodyState &state);
+
+// Blends two states of the same table: t = 0 gives from, t = 1 gives to.
+// Angles turn the shorter way round.
+void interpolateBodies(const BodyState &from, const BodyState &to, float t,
+		BodyState &out);
+
+#endif
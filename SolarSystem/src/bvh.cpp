@@ -0,0 +1,427 @@
+/* Bounding-volume hierarchy over the bodies. */
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <utility>
+
+#include "threadpool.h"
+
+// Nodes with this many objects or fewer are not split.
+static const int leafSize = 4;
+// Bits of Morton code per axis.
+static const int mortonBits = 10;
+// The tree is built again once its boxes have grown this much in all.
+static const double rebuildGrowth = 2.0;
+// Deeper than the tree can be: a level for every bit of the codes and
+// one for every halving of the most objects that can share a code.
+static const int maxDepth = 3 * mortonBits + 34;
+
+// Spreads the low 10 bits of v out to every third bit.
+static uint32_t spreadBits(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+Bvh::Bvh() : table(NULL), beltBodies(0), builtSize(0.0), nextReady(false) {
+}
+
+Bvh::~Bvh() {
+	stopBuilder();
+}
+
+void Bvh::build(const BodyTable &table, const BodyState &state) {
+	stopBuilder();
+	this->table = &table;
+	tree.order.clear();
+	for (int i = 0; i < table.count; i++)
+		if (table.shape[i] == SHAPE_SPHERE)
+			tree.order.push_back(i);
+	beltBodies = (int) state.belt.size() / 3;
+	for (int b = 0; b < beltBodies; b++)
+		tree.order.push_back(table.count + b);
+	const int n = (int) tree.order.size();
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+	fitPositions(state, 0, n);
+	sortTree(tree, x, y, z);
+	builtSize = fitBoxes(state);
+}
+
+int Bvh::buildNode(std::vector<uint32_t> &keys, std::vector<Node> &nodes,
+		int begin, int end, int bit) {
+	const int index = (int) nodes.size();
+	nodes.push_back(Node());
+	if (end - begin <= leafSize) {
+		nodes[index].next = begin;
+		nodes[index].count = end - begin;
+		return index;
+	}
+
+	// split where the highest bit in which the codes differ turns on, or
+	// in the middle of objects that share a code
+	int split = begin + (end - begin) / 2;
+	for (; bit >= 0; bit--) {
+		uint32_t mask = 1u << bit;
+		if ((keys[begin] & mask) == (keys[end - 1] & mask))
+			continue;
+		split = std::partition_point(keys.begin() + begin, keys.begin() + end,
+				[mask](uint32_t key) { return !(key & mask); })
+				- keys.begin();
+		break;
+	}
+	buildNode(keys, nodes, begin, split, bit - 1);
+	const int second = buildNode(keys, nodes, split, end, bit - 1);
+	nodes[index].next = second;
+	nodes[index].count = 0;
+	return index;
+}
+
+void Bvh::sortTree(Tree &tree, const std::vector<float> &x,
+		const std::vector<float> &y, const std::vector<float> &z) const {
+	const int n = (int) tree.order.size();
+	tree.nodes.clear();
+	tree.radius.resize(n);
+	if (n == 0)
+		return;
+
+	double minX = x[0], minY = y[0], minZ = z[0];
+	double maxX = minX, maxY = minY, maxZ = minZ;
+	for (int s = 1; s < n; s++) {
+		minX = fmin(minX, x[s]);
+		minY = fmin(minY, y[s]);
+		minZ = fmin(minZ, z[s]);
+		maxX = fmax(maxX, x[s]);
+		maxY = fmax(maxY, y[s]);
+		maxZ = fmax(maxZ, z[s]);
+	}
+	double size = fmax(fmax(maxX - minX, maxY - minY), maxZ - minZ);
+	size = size > 0.0 ? size * (1.0 + 1e-6) : 1.0;
+
+	// on the builder this runs beside the frames, so on this thread alone
+	std::vector<uint32_t> keys(n);
+	const double scale = (1 << mortonBits) / size;
+	for (int s = 0; s < n; s++) {
+		uint32_t cx = (uint32_t) ((x[s] - minX) * scale);
+		uint32_t cy = (uint32_t) ((y[s] - minY) * scale);
+		uint32_t cz = (uint32_t) ((z[s] - minZ) * scale);
+		keys[s] = spreadBits(cx) << 2 | spreadBits(cy) << 1 | spreadBits(cz);
+	}
+
+	// least significant digit radix sort, a byte at a time
+	std::vector<uint32_t> keyScratch(n);
+	std::vector<int> indexScratch(n);
+	for (int shift = 0; shift < 3 * mortonBits; shift += 8) {
+		int offsets[257] = { 0 };
+		for (int s = 0; s < n; s++)
+			offsets[((keys[s] >> shift) & 0xff) + 1]++;
+		for (int d = 0; d < 256; d++)
+			offsets[d + 1] += offsets[d];
+		for (int s = 0; s < n; s++) {
+			int to = offsets[(keys[s] >> shift) & 0xff]++;
+			keyScratch[to] = keys[s];
+			indexScratch[to] = tree.order[s];
+		}
+		keys.swap(keyScratch);
+		tree.order.swap(indexScratch);
+	}
+
+	for (int s = 0; s < n; s++) {
+		int k = tree.order[s];
+		tree.radius[s] = k < table->count ? table->radius[k] : 0.0f;
+	}
+	tree.nodes.reserve(2 * (n / leafSize) + 1);
+	buildNode(keys, tree.nodes, 0, n, 3 * mortonBits - 1);
+}
+
+void Bvh::buildNext() {
+	sortTree(nextTree, nextX, nextY, nextZ);
+	nextReady = true;
+}
+
+void Bvh::stopBuilder() {
+	if (builder.joinable())
+		builder.join();
+	nextReady = false;
+}
+
+void Bvh::fitPositions(const BodyState &state, int begin, int end) {
+	const int bodies = table->count;
+	for (int s = begin; s < end; s++) {
+		int k = tree.order[s];
+		if (k < bodies) {
+			x[s] = state.x[k];
+			y[s] = state.y[k];
+			z[s] = state.z[k];
+		} else {
+			const float *p = &state.belt[3 * (k - bodies)];
+			x[s] = p[0];
+			y[s] = p[1];
+			z[s] = p[2];
+		}
+	}
+}
+
+double Bvh::fitBoxes(const BodyState &state) {
+	std::vector<Node> &nodes = tree.nodes;
+	// the leaves and their objects first, in parallel
+	parallelFor((int) nodes.size(), 4096, [&](int begin, int end) {
+		for (int index = begin; index < end; index++) {
+			Node &node = nodes[index];
+			if (node.count == 0)
+				continue;
+			const int last = node.next + node.count;
+			fitPositions(state, node.next, last);
+			float minX = x[node.next], minY = y[node.next], minZ = z[node.next];
+			float maxX = minX, maxY = minY, maxZ = minZ;
+			for (int s = node.next; s < last; s++) {
+				const float r = tree.radius[s];
+				minX = std::min(minX, x[s] - r);
+				minY = std::min(minY, y[s] - r);
+				minZ = std::min(minZ, z[s] - r);
+				maxX = std::max(maxX, x[s] + r);
+				maxY = std::max(maxY, y[s] + r);
+				maxZ = std::max(maxZ, z[s] + r);
+			}
+			node.min[0] = minX;
+			node.min[1] = minY;
+			node.min[2] = minZ;
+			node.max[0] = maxX;
+			node.max[1] = maxY;
+			node.max[2] = maxZ;
+		}
+	});
+
+	// then the inner nodes, whose children come after them
+	double total = 0.0;
+	for (int index = (int) nodes.size() - 1; index >= 0; index--) {
+		Node &node = nodes[index];
+		if (node.count == 0) {
+			const Node &first = nodes[index + 1], &second = nodes[node.next];
+			for (int a = 0; a < 3; a++) {
+				node.min[a] = std::min(first.min[a], second.min[a]);
+				node.max[a] = std::max(first.max[a], second.max[a]);
+			}
+		}
+		total += (double) node.max[0] - node.min[0] + node.max[1] - node.min[1]
+				+ node.max[2] - node.min[2];
+	}
+	return total;
+}
+
+void Bvh::refit(const BodyState &state) {
+	if (table == NULL)
+		return;
+	if ((int) state.belt.size() / 3 != beltBodies) {
+		build(*table, state);
+		return;
+	}
+	if (nextReady) {
+		builder.join();
+		nextReady = false;
+		std::swap(tree, nextTree);
+		builtSize = fitBoxes(state);
+		return;
+	}
+	if (fitBoxes(state) > rebuildGrowth * builtSize && !builder.joinable()) {
+		nextTree.order = tree.order;
+		nextX = x;
+		nextY = y;
+		nextZ = z;
+		builder = std::thread(&Bvh::buildNext, this);
+	}
+}
+
+// Squared distance from p to the box from min to max, 0 inside it.
+static double boxDistance2(const float min[3], const float max[3],
+		const double p[3]) {
+	double d2 = 0.0;
+	for (int a = 0; a < 3; a++) {
+		double d = p[a] < min[a] ? min[a] - p[a]
+				: p[a] > max[a] ? p[a] - max[a] : 0.0;
+		d2 += d * d;
+	}
+	return d2;
+}
+
+// Whether the ray from origin, with the given inverse direction, meets the
+// box from min to max widened by reach somewhere before distance leave.
+static bool rayMeetsBox(const float min[3], const float max[3],
+		const double origin[3], const double inverse[3], double reach,
+		double leave) {
+	double enter = 0.0;
+	for (int a = 0; a < 3 && enter <= leave; a++) {
+		double t0 = (min[a] - reach - origin[a]) * inverse[a];
+		double t1 = (max[a] + reach - origin[a]) * inverse[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		enter = fmax(enter, t0);
+		leave = fmin(leave, t1);
+	}
+	return enter <= leave;
+}
+
+int Bvh::pick(const double origin[3], const double direction[3],
+		double slope, double *distance) const {
+	const std::vector<Node> &nodes = tree.nodes;
+	const std::vector<int> &order = tree.order;
+	int found = -1;
+	double best = HUGE_VAL;
+	// a sphere the ray goes through beats anything it only passes near,
+	// however much nearer
+	bool through = false;
+	if (nodes.empty())
+		return found;
+	double inverse[3];
+	for (int a = 0; a < 3; a++)
+		inverse[a] = 1.0 / direction[a];
+
+	int stack[maxDepth];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		const int index = stack[--depth];
+		const Node &node = nodes[index];
+		// spheres can be gone through anywhere in the box, and objects
+		// nearer than the nearest yet passed near anywhere in it widened by
+		// the reach at the furthest along the ray it goes
+		if (!rayMeetsBox(node.min, node.max, origin, inverse, 0.0,
+				through ? best : HUGE_VAL)) {
+			if (through)
+				continue;
+			double along = 0.0, half = 0.0;
+			for (int a = 0; a < 3; a++) {
+				along += (0.5 * (node.min[a] + node.max[a]) - origin[a])
+						* direction[a];
+				half += 0.25 * ((double) node.max[a] - node.min[a])
+						* ((double) node.max[a] - node.min[a]);
+			}
+			along += sqrt(half);
+			if (along < 0.0 || !rayMeetsBox(node.min, node.max, origin,
+					inverse, slope * along, best))
+				continue;
+		}
+
+		if (node.count == 0) {
+			// the nearer child first, for the nearest hits to come early
+			const Node &first = nodes[index + 1], &second = nodes[node.next];
+			double nearer = 0.0;
+			for (int a = 0; a < 3; a++)
+				nearer += (first.min[a] + first.max[a] - second.min[a]
+						- second.max[a]) * direction[a];
+			stack[depth++] = nearer < 0.0 ? node.next : index + 1;
+			stack[depth++] = nearer < 0.0 ? index + 1 : node.next;
+			continue;
+		}
+		for (int s = node.next; s < node.next + node.count; s++) {
+			double dx = x[s] - origin[0], dy = y[s] - origin[1],
+					dz = z[s] - origin[2];
+			double t = dx * direction[0] + dy * direction[1]
+					+ dz * direction[2];
+			double miss2 = fmax(dx * dx + dy * dy + dz * dz - t * t, 0.0);
+			double r = tree.radius[s], within = r + slope * t;
+			if (miss2 < r * r) {
+				// the near side of the sphere
+				double hit = t - sqrt(r * r - miss2);
+				if (hit >= 0.0 && (!through || hit < best)) {
+					best = hit;
+					found = order[s];
+					through = true;
+				}
+			} else if (!through && t >= 0.0 && miss2 <= within * within
+					&& t < best) {
+				best = t;
+				found = order[s];
+			}
+		}
+	}
+	if (distance != NULL)
+		*distance = best;
+	return found;
+}
+
+void Bvh::withinRadius(const double point[3], double radius,
+		std::vector<int> &found) const {
+	const std::vector<Node> &nodes = tree.nodes;
+	const std::vector<int> &order = tree.order;
+	if (nodes.empty())
+		return;
+	const double radius2 = radius * radius;
+	int stack[maxDepth];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		const int index = stack[--depth];
+		const Node &node = nodes[index];
+		if (boxDistance2(node.min, node.max, point) > radius2)
+			continue;
+		if (node.count == 0) {
+			stack[depth++] = node.next;
+			stack[depth++] = index + 1;
+			continue;
+		}
+		for (int s = node.next; s < node.next + node.count; s++) {
+			double dx = x[s] - point[0], dy = y[s] - point[1],
+					dz = z[s] - point[2];
+			double reach = radius + tree.radius[s];
+			if (dx * dx + dy * dy + dz * dz <= reach * reach)
+				found.push_back(order[s]);
+		}
+	}
+}
+
+void Bvh::nearest(const double point[3], int count,
+		std::vector<int> &found) const {
+	const std::vector<Node> &nodes = tree.nodes;
+	const std::vector<int> &order = tree.order;
+	found.clear();
+	if (nodes.empty() || count <= 0)
+		return;
+
+	// nodes by the distance to their boxes, nearest on top, and the best
+	// objects so far by theirs, furthest on top
+	typedef std::pair<double, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	std::priority_queue<Entry> best;
+	open.push(Entry(0.0, 0));
+	while (!open.empty()) {
+		const Entry next = open.top();
+		open.pop();
+		// boxes hold whole spheres, so nothing in them is nearer than they
+		if ((int) best.size() == count
+				&& next.first >= best.top().first * best.top().first)
+			break;
+		const Node &node = nodes[next.second];
+		if (node.count == 0) {
+			open.push(Entry(boxDistance2(nodes[next.second + 1].min,
+					nodes[next.second + 1].max, point), next.second + 1));
+			open.push(Entry(boxDistance2(nodes[node.next].min,
+					nodes[node.next].max, point), node.next));
+			continue;
+		}
+		for (int s = node.next; s < node.next + node.count; s++) {
+			double dx = x[s] - point[0], dy = y[s] - point[1],
+					dz = z[s] - point[2];
+			double d = fmax(sqrt(dx * dx + dy * dy + dz * dz) - tree.radius[s], 0.0);
+			if ((int) best.size() < count) {
+				best.push(Entry(d, order[s]));
+			} else if (d < best.top().first) {
+				best.pop();
+				best.push(Entry(d, order[s]));
+			}
+		}
+	}
+	found.resize(best.size());
+	for (int k = (int) best.size() - 1; k >= 0; k--) {
+		found[k] = best.top().second;
+		best.pop();
+	}
+}
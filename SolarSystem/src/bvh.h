@@ -0,0 +1,124 @@
+/* Bounding-volume hierarchy over the bodies, for picking and spatial
+ * queries.
+ *
+ * The objects are the spheres of the body table and the small bodies of
+ * the belts, as points. They are sorted by the Morton code of where they
+ * are when the tree is built, and the tree is cut from the sorted order
+ * as the gravity's octree is, into boxes down to leaves of a few objects.
+ * The positions are copied into the leaves' order, so a query only reads
+ * the tree.
+ *
+ * The bodies move every frame, and rather than being built again the tree
+ * is refit: the leaves' boxes are set around their objects' new positions
+ * and every box around its children's, in one pass from the leaves up.
+ * Neighbours on different orbits drift apart, though, belt bodies within
+ * a leaf in a few dozen frames, and the boxes grow and the queries slow
+ * down. Once the boxes have doubled, a new tree is sorted from the latest
+ * positions on a thread of its own while the old one goes on being refit,
+ * and takes its place when it is ready, so no frame waits for a build.
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "bodies.h"
+
+class Bvh {
+public:
+	Bvh();
+	~Bvh();
+
+	// Builds the hierarchy over the spheres of table, which must outlive
+	// it, and the belt bodies, where state has them. A state without belt
+	// bodies, as the shader renderer leaves it, builds over the spheres
+	// only.
+	void build(const BodyTable &table, const BodyState &state);
+
+	bool isBuilt() const {
+		return table != NULL;
+	}
+
+	// Moves the tree to where state has the objects, or builds it again if
+	// the belts have come or gone.
+	void refit(const BodyState &state);
+
+	// The object a ray from origin along the unit vector direction meets
+	// first, or -1. Where it goes through no sphere, the nearest object it
+	// passes within slope times the distance along it of, so that bodies
+	// and points too small to hit stay within some pixels of reach. The
+	// distance along the ray goes into distance.
+	int pick(const double origin[3], const double direction[3], double slope,
+			double *distance) const;
+
+	// Appends every object whose surface lies within radius of point to
+	// found.
+	void withinRadius(const double point[3], double radius,
+			std::vector<int> &found) const;
+
+	// The count objects whose surfaces lie nearest to point, nearest first,
+	// into found.
+	void nearest(const double point[3], int count,
+			std::vector<int> &found) const;
+
+	// Objects below the table's count are its rows; the rest are belt
+	// bodies, from the table's count on.
+	int objectCount() const {
+		return (int) tree.order.size();
+	}
+
+private:
+	// A box around its objects. Inner nodes have their first child right
+	// after them and the second at next; leaves hold the count sorted
+	// objects from next on.
+	struct Node {
+		float min[3], max[3];
+		int next;   // the second child, or the first object of a leaf
+		int count;  // 0 for inner nodes
+	};
+
+	// The nodes over the objects, in the order they were sorted into.
+	struct Tree {
+		std::vector<Node> nodes;
+		std::vector<int> order;     // object at each sorted position
+		std::vector<float> radius;  // of each sorted object
+	};
+
+	// Appends the node over the sorted objects begin to end - 1, whose
+	// Morton codes agree above bit, and the nodes under it, to nodes.
+	// Returns its index.
+	static int buildNode(std::vector<uint32_t> &keys, std::vector<Node> &nodes,
+			int begin, int end, int bit);
+	// Sorts the objects of tree, which are at x, y and z in its current
+	// order, and cuts its nodes from the sorted order.
+	void sortTree(Tree &tree, const std::vector<float> &x,
+			const std::vector<float> &y, const std::vector<float> &z) const;
+	// Sorts nextTree from nextX, nextY and nextZ, on builder.
+	void buildNext();
+	// Waits for builder and drops what it built.
+	void stopBuilder();
+	// Copies the positions of the objects at sorted positions begin to
+	// end - 1 from state.
+	void fitPositions(const BodyState &state, int begin, int end);
+	// Gathers the positions and refits every box, returning the sum of
+	// the boxes' half perimeters.
+	double fitBoxes(const BodyState &state);
+
+	const BodyTable *table;
+	int beltBodies;
+	Tree tree;
+	std::vector<float> x, y, z;  // of each sorted object
+	double builtSize;            // the sum of half perimeters when built
+
+	// the tree that replaces this one, and the positions it is sorted from
+	Tree nextTree;
+	std::vector<float> nextX, nextY, nextZ;
+	std::thread builder;
+	std::atomic<bool> nextReady;
+};
+
+#endif
@@ -0,0 +1,33 @@
+/* Camera placement and the preset views. */
+
+#include "camera.h"
+
+#include <ctype.h>
+#include <string.h>
+
+const CameraPreset cameraPresets[] = {
+	//parallel front view
+	{ "front", 'a', { 0, 0, 20, 0, 0, 0, 0, 1, 0 } },
+	//parallel side view
+	{ "side", 'd', { 20, 0, 0, 0, 0, 0, 0, 1, 0 } },
+	//top view
+	{ "top", 'w', { 0, 20, 0, 0, 0, 0, 0, 1, 1 } },
+	//perspective
+	{ "perspective", 's', { 10, 12, 13, 0, 0, 0, 0, 1, 0 } },
+};
+
+const int cameraPresetCount = sizeof(cameraPresets) / sizeof(cameraPresets[0]);
+
+const CameraPreset *findCameraPreset(const char *name) {
+	for (int i = 0; i < cameraPresetCount; i++)
+		if (strcmp(cameraPresets[i].name, name) == 0)
+			return &cameraPresets[i];
+	return NULL;
+}
+
+const CameraPreset *cameraPresetForKey(unsigned char key) {
+	for (int i = 0; i < cameraPresetCount; i++)
+		if (cameraPresets[i].key == tolower(key))
+			return &cameraPresets[i];
+	return NULL;
+}
@@ -0,0 +1,28 @@
+/* Camera placement and the preset views. */
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+struct Camera {
+	float eyeX, eyeY, eyeZ;
+	float centerX, centerY, centerZ;
+	float upX, upY, upZ;
+};
+
+// A fixed view, selected with its key or by name on the command line.
+struct CameraPreset {
+	const char *name;
+	char key;
+	Camera camera;
+};
+
+extern const CameraPreset cameraPresets[];
+extern const int cameraPresetCount;
+
+// Returns the preset with the given name, or NULL.
+const CameraPreset *findCameraPreset(const char *name);
+
+// Returns the preset selected by key in either case, or NULL.
+const CameraPreset *cameraPresetForKey(unsigned char key);
+
+#endif
@@ -0,0 +1,218 @@
+/* Frame capture for clips rendered offscreen. */
+
+#include "capture.h"
+
+#include <signal.h>
+#include <string.h>
+
+#include "glinfo.h"
+
+// Frames the writer may fall behind by before capture waits for it.
+static const int writerFrames = 4;
+
+FrameCapture::FrameCapture() :
+		pipe(NULL), width(0), height(0), captured(0), written(0),
+		fenced(false), next(0), inFlight(0), stopping(false), failed(false) {
+	for (int k = 0; k < ringSize; k++) {
+		buffers[k] = 0;
+		fences[k] = 0;
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	if (isOpen())
+		close();
+}
+
+bool FrameCapture::open(const char *targetName, int frameWidth,
+		int frameHeight) {
+	target = targetName;
+	if (target[0] == '|') {
+		// a closed encoder fails the write rather than ending the program
+		signal(SIGPIPE, SIG_IGN);
+		if ((pipe = popen(target.c_str() + 1, "w")) == NULL) {
+			printf("Cannot run %s\n", target.c_str() + 1);
+			return false;
+		}
+	} else if (strchr(target.c_str(), '%') == NULL) {
+		printf("%s has no place for the frame number, such as %%05d\n",
+				target.c_str());
+		return false;
+	}
+	width = frameWidth;
+	height = frameHeight;
+	captured = written = 0;
+	next = inFlight = 0;
+	stopping = failed = false;
+
+	const size_t size = (size_t) width * height * 3;
+	if (glVersionAtLeast(2, 1) || hasGLExtension("GL_ARB_pixel_buffer_object")) {
+		glGenBuffers(ringSize, buffers);
+		for (int k = 0; k < ringSize; k++) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[k]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	} else
+		rows.resize(size);
+	fenced = glVersionAtLeast(3, 2) || hasGLExtension("GL_ARB_sync");
+
+	frames.resize(writerFrames);
+	for (int k = 0; k < writerFrames; k++) {
+		frames[k].pixels.resize(size);
+		empty.push_back(&frames[k]);
+	}
+	writer = std::thread(&FrameCapture::write, this);
+	return true;
+}
+
+// Maps the oldest readback, in slot, and hands it to the writer, turned
+// top row first.
+void FrameCapture::readBack(int slot) {
+	Frame *frame;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (empty.empty() && !failed)
+			changed.wait(lock);
+		if (failed)
+			return;
+		frame = empty.front();
+		empty.pop_front();
+	}
+
+	const unsigned char *pixels = rows.empty() ? NULL : &rows[0];
+	if (buffers[slot] != 0) {
+		if (fences[slot] != 0) {
+			while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+					1000000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fences[slot]);
+			fences[slot] = 0;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+		pixels = (const unsigned char *) glMapBuffer(GL_PIXEL_PACK_BUFFER,
+				GL_READ_ONLY);
+	}
+	// OpenGL returns the bottom row first
+	const size_t stride = (size_t) width * 3;
+	if (pixels != NULL)
+		for (int y = 0; y < height; y++)
+			memcpy(&frame->pixels[(size_t) (height - 1 - y) * stride],
+					pixels + y * stride, stride);
+	if (buffers[slot] != 0) {
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	frame->number = captured - inFlight;
+	full.push_back(frame);
+	changed.notify_all();
+}
+
+bool FrameCapture::capture() {
+	// the slot about to be reused holds the oldest frame
+	if (inFlight == ringSize) {
+		readBack(next);
+		inFlight--;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[next]);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+			buffers[next] != 0 ? NULL : &rows[0]);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	if (fenced && buffers[next] != 0)
+		fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	captured++;
+	inFlight++;
+	// without buffers the pixels are already here
+	if (buffers[next] == 0) {
+		readBack(next);
+		inFlight--;
+	}
+	next = (next + 1) % ringSize;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return !failed;
+}
+
+void FrameCapture::write() {
+	const size_t size = (size_t) width * height * 3;
+	for (;;) {
+		Frame *frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (full.empty() && !stopping)
+				changed.wait(lock);
+			if (full.empty())
+				return;
+			frame = full.front();
+			full.pop_front();
+		}
+
+		bool ok;
+		if (pipe != NULL) {
+			ok = fwrite(&frame->pixels[0], 1, size, pipe) == size;
+			if (!ok)
+				printf("Cannot write to %s\n", target.c_str() + 1);
+		} else {
+			char path[1024];
+			snprintf(path, sizeof(path), target.c_str(), frame->number);
+			FILE *file = fopen(path, "wb");
+			ok = file != NULL
+					&& fprintf(file, "P6\n%d %d\n255\n", width, height) > 0
+					&& fwrite(&frame->pixels[0], 1, size, file) == size;
+			if (file != NULL && fclose(file) != 0)
+				ok = false;
+			if (!ok)
+				printf("Cannot write %s\n", path);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ok)
+			written++;
+		else
+			failed = true;
+		empty.push_back(frame);
+		changed.notify_all();
+	}
+}
+
+bool FrameCapture::close() {
+	// the frames still being read, oldest first
+	for (; inFlight > 0; inFlight--)
+		readBack((next - inFlight + ringSize) % ringSize);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		changed.notify_all();
+	}
+	writer.join();
+
+	for (int k = 0; k < ringSize; k++) {
+		if (fences[k] != 0)
+			glDeleteSync(fences[k]);
+		fences[k] = 0;
+	}
+	if (buffers[0] != 0)
+		glDeleteBuffers(ringSize, buffers);
+	for (int k = 0; k < ringSize; k++)
+		buffers[k] = 0;
+	if (pipe != NULL) {
+		int status = pclose(pipe);
+		if (status != 0) {
+			printf("%s exited with status %d\n", target.c_str() + 1, status);
+			failed = true;
+		}
+		pipe = NULL;
+	}
+	printf("Captured %ld of %ld frames to %s\n", written, captured,
+			target.c_str());
+	frames.clear();
+	full.clear();
+	empty.clear();
+	std::vector<unsigned char>().swap(rows);
+	width = height = 0;
+	return !failed;
+}
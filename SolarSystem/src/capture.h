@@ -0,0 +1,85 @@
+/* Frame capture for clips rendered offscreen.
+ *
+ * Each frame is read back into the next of a small ring of pixel buffer
+ * objects, which returns at once, and only mapped ringSize frames later,
+ * by when the GPU has long finished with it, so the renderer never waits
+ * on glReadPixels. A thread of its own then writes the frames, either as
+ * raw RGB into a pipe, such as an encoder's standard input, or as numbered
+ * PPM files, so a slow disk or encoder holds the renderer up only once the
+ * frames waiting for it fill every buffer.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameCapture {
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	// Starts capturing width x height frames to target. "|command" pipes
+	// raw RGB frames, 3 bytes a pixel and top row first, into the standard
+	// input of command, run by the shell; anything else is a printf pattern
+	// for numbered PPM files, such as frames/frame%05d.ppm. Needs a current
+	// GL context. Prints the problem and returns false if target cannot be
+	// opened.
+	bool open(const char *target, int width, int height);
+
+	// Starts reading back the frame just drawn, and passes the oldest frame
+	// still being read on to the writer. Returns false once a write has
+	// failed.
+	bool capture();
+
+	// Writes the frames still on their way and closes the target. Returns
+	// false if any write failed.
+	bool close();
+
+	bool isOpen() const {
+		return width > 0;
+	}
+
+private:
+	static const int ringSize = 3;
+
+	// A frame read back, waiting for the writer.
+	struct Frame {
+		long number;
+		std::vector<unsigned char> pixels;  // top row first
+	};
+
+	void readBack(int slot);
+	void write();
+
+	std::string target;  // "|command", or the pattern of the files
+	FILE *pipe;
+	int width, height;
+	long captured, written;
+
+	// the readbacks in flight, oldest first
+	GLuint buffers[ringSize];
+	GLsync fences[ringSize];
+	bool fenced;     // whether the context has sync objects
+	int next, inFlight;
+	std::vector<unsigned char> rows;  // for contexts without buffers
+
+	// frames for the writer, and empty ones for the readbacks
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Frame *> full, empty;
+	std::vector<Frame> frames;
+	bool stopping, failed;
+	std::thread writer;
+};
+
+#endif
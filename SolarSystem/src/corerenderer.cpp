@@ -0,0 +1,882 @@
+/* A shader renderer for OpenGL 3.3 core profile contexts. */
+
+#include "corerenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+#include "frustum.h"
+#include "glstate.h"
+
+// The clock may drift this many days from the epoch of the elements before
+// they are restated; the spin of a fast rotator then still turns by well
+// under a hundredth of a degree per float step.
+static const double rebaseDays = 64.0;
+
+// Texels of the element buffer per body, each four floats:
+//   p.xyz and the mean anomaly at the epoch in radians
+//   q.xyz and the mean motion in radians per day
+//   eccentricity, parent, radius and flags
+//   the body's rectangle of its texture
+//   turn about y at the epoch and its rate, in degrees and per day
+//   the quaternion of its frame, x, y, z and w
+static const int elementTexels = 6;
+static const int bodyRing = 1, bodyEmissive = 2, bodyTextured = 4,
+		bodyPlaceholder = 8;
+
+// The fraction of light every surface gets, lit side or not.
+static const float ambientLight = 0.2f;
+
+// Shared by every shader: the per-frame block and the orbits. The views
+// are as many as maxViews.
+static const char *const commonSource = "#version 330 core\n\
+layout(std140) uniform Frame {\n\
+	// each view's camera and projection, and its tile of the window, xy\n\
+	// the scale and zw the offset from the whole window's clip space\n\
+	mat4 viewProjection[16];\n\
+	vec4 tile[16];\n\
+	vec4 light;  // xyz where it comes from, w the ambient part\n\
+	// x days since the epoch of the elements, y days since J2000 for the\n\
+	// belts, w the number of views\n\
+	vec4 clock;\n\
+};\n\
+uniform samplerBuffer elements;\n\
+uniform samplerBuffer positions;\n\
+const int texels = 6;  // per body in elements\n\
+\n\
+// Kepler's equation by Halley's method from Danby's guess, as on the CPU.\n\
+vec3 orbitPosition(vec4 p, vec4 q, float e, float days) {\n\
+	const float twoPi = 6.28318531;\n\
+	float m = p.w + q.w * days;\n\
+	m -= twoPi * floor(m / twoPi + 0.5);\n\
+	float E = m + (m < 0.0 ? -0.85 : 0.85) * e;\n\
+	for (int i = 0; i < 8; i++) {\n\
+		float f = E - e * sin(E) - m;\n\
+		float slope = 1.0 - e * cos(E);\n\
+		float delta = f * slope / (slope * slope - 0.5 * f * e * sin(E));\n\
+		E -= delta;\n\
+		if (abs(delta) < 1e-6)\n\
+			break;\n\
+	}\n\
+	return (cos(E) - e) * p.xyz + sin(E) * q.xyz;\n\
+}\n\
+\n\
+// where the solve pass, or the state, put the body this frame\n\
+vec3 bodyPosition(int body) {\n\
+	return texelFetch(positions, body).xyz;\n\
+}\n";
+
+// For the vertex shaders, which draw every view as instances of their own.
+static const char *const viewSource = "\
+out float gl_ClipDistance[4];\n\
+\n\
+// position as view sees it, moved into the view's tile; the clip distances\n\
+// cut it off at the edges of the tile\n\
+vec4 viewPosition(int view, vec4 position) {\n\
+	vec4 clip = viewProjection[view] * position;\n\
+	gl_ClipDistance[0] = clip.w + clip.x;\n\
+	gl_ClipDistance[1] = clip.w - clip.x;\n\
+	gl_ClipDistance[2] = clip.w + clip.y;\n\
+	gl_ClipDistance[3] = clip.w - clip.y;\n\
+	return vec4(clip.xy * tile[view].xy + clip.w * tile[view].zw, clip.zw);\n\
+}\n";
+
+// Solves the orbit of every body, and those of its parents, once a frame
+// into the positions, one body per vertex, captured by transform feedback.
+static const char *const solveVertexSource = "\
+out vec4 solved;\n\
+\n\
+void main() {\n\
+	vec3 position = vec3(0.0);\n\
+	int body = gl_VertexID;\n\
+	for (int depth = 0; depth < 8 && body >= 0; depth++) {\n\
+		vec4 shape = texelFetch(elements, texels * body + 2);\n\
+		position += orbitPosition(texelFetch(elements, texels * body),\n\
+				texelFetch(elements, texels * body + 1), shape.x, clock.x);\n\
+		body = int(shape.y);\n\
+	}\n\
+	solved = vec4(position, 1.0);\n\
+}\n";
+
+static const char *const bodyVertexSource = "\
+layout(location = 0) in vec3 vertex;\n\
+layout(location = 1) in vec3 normal;\n\
+layout(location = 2) in vec2 texCoord;\n\
+layout(location = 3) in ivec2 instance;  // the body and the view\n\
+out vec2 surfaceCoord;\n\
+out float lit;\n\
+flat out int textured;\n\
+\n\
+// v turned by the unit quaternion q\n\
+vec3 rotate(vec4 q, vec3 v) {\n\
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);\n\
+}\n\
+\n\
+void main() {\n\
+	int body = instance.x;\n\
+	vec4 shape = texelFetch(elements, texels * body + 2);\n\
+	vec4 rect = texelFetch(elements, texels * body + 3);\n\
+	vec4 turn = texelFetch(elements, texels * body + 4);\n\
+	vec4 frame = texelFetch(elements, texels * body + 5);\n\
+	int flags = int(shape.w);\n\
+	vec3 v = vertex * shape.z, n = normal;\n\
+	// rings lie flat in their frame\n\
+	if ((flags & 1) != 0) {\n\
+		v = vec3(v.x, -v.z, v.y);\n\
+		n = vec3(n.x, -n.z, n.y);\n\
+	}\n\
+	float angle = radians(mod(turn.x + turn.y * clock.x, 360.0));\n\
+	mat3 spin = mat3(cos(angle), 0.0, -sin(angle), 0.0, 1.0, 0.0,\n\
+			sin(angle), 0.0, cos(angle));\n\
+	v = rotate(frame, spin * v);\n\
+	n = rotate(frame, spin * n);\n\
+	vec3 position = bodyPosition(body) + v;\n\
+	gl_Position = viewPosition(instance.y, vec4(position, 1.0));\n\
+	surfaceCoord = rect.xy + texCoord * rect.zw;\n\
+	textured = flags & 12;\n\
+\n\
+	// per vertex, as the fixed-function pipeline lights\n\
+	lit = 1.0;\n\
+	if ((flags & 2) == 0) {\n\
+		float facing = dot(n, normalize(light.xyz - position));\n\
+		// rings show the same face lit from either side\n\
+		if ((flags & 1) != 0)\n\
+			facing = abs(facing);\n\
+		lit = light.w + (1.0 - light.w) * max(facing, 0.0);\n\
+	}\n\
+}\n";
+
+static const char *const bodyFragmentSource = "\
+in vec2 surfaceCoord;\n\
+in float lit;\n\
+flat in int textured;\n\
+uniform sampler2D surface;\n\
+uniform sampler2D placeholder;\n\
+uniform bool wireframe;\n\
+out vec4 fragment;\n\
+\n\
+void main() {\n\
+	if (wireframe)\n\
+		fragment = vec4(1.0);\n\
+	else if ((textured & 8) != 0)\n\
+		fragment = vec4(texture(placeholder, surfaceCoord).rgb * lit, 1.0);\n\
+	else if (textured != 0)\n\
+		fragment = vec4(texture(surface, surfaceCoord).rgb * lit, 1.0);\n\
+	else\n\
+		fragment = vec4(vec3(lit), 1.0);\n\
+}\n";
+
+// Solves the orbit of every belt body once a frame, relative to its row,
+// into the belt's positions, captured by transform feedback.
+static const char *const beltVertexSource = "\
+layout(location = 0) in vec4 perifocal;  // p.xyz and the mean anomaly\n\
+layout(location = 1) in vec4 quarter;  // q.xyz and the mean motion\n\
+layout(location = 2) in float eccentricity;\n\
+out vec3 solvedPoint;\n\
+\n\
+void main() {\n\
+	solvedPoint = orbitPosition(perifocal, quarter, eccentricity, clock.y);\n\
+}\n";
+
+static const char *const pointVertexSource = "\
+layout(location = 0) in vec3 point;\n\
+uniform vec3 center;\n\
+\n\
+void main() {\n\
+	gl_Position = viewPosition(gl_InstanceID, vec4(center + point, 1.0));\n\
+}\n";
+
+static const char *const pointFragmentSource = "\
+uniform vec3 color;\n\
+out vec4 fragment;\n\
+\n\
+void main() {\n\
+	fragment = vec4(color, 1.0);\n\
+}\n";
+
+// Stars are directions: w = 0 drops the camera's position.
+static const char *const starVertexSource = "\
+layout(location = 0) in vec4 direction;\n\
+layout(location = 1) in vec4 starColor;\n\
+out vec4 color;\n\
+\n\
+void main() {\n\
+	gl_Position = viewPosition(gl_InstanceID, direction);\n\
+	color = starColor;\n\
+}\n";
+
+static const char *const starFragmentSource = "\
+in vec4 color;\n\
+out vec4 fragment;\n\
+\n\
+void main() {\n\
+	fragment = color;\n\
+}\n";
+
+// Trails are in the scene, and orbits relative to their parents.
+static const char *const lineVertexSource = "\
+// the parent's index in w, for orbits\n\
+layout(location = 0) in vec4 vertex;\n\
+layout(location = 1) in vec4 lineColor;\n\
+uniform bool relative;\n\
+out vec4 color;\n\
+\n\
+void main() {\n\
+	vec3 position = vertex.xyz;\n\
+	if (relative)\n\
+		position += bodyPosition(int(vertex.w));\n\
+	gl_Position = viewPosition(gl_InstanceID, vec4(position, 1.0));\n\
+	color = lineColor;\n\
+}\n";
+
+// The per-frame uniform block, laid out as std140 has it.
+struct FrameBlock {
+	GLfloat viewProjection[maxViews][16];
+	GLfloat tile[maxViews][4];
+	GLfloat light[4];
+	GLfloat clock[4];
+};
+
+static GLuint compileShader(GLenum type, const char *source, const char *name) {
+	const char *sources[] = { commonSource,
+			type == GL_VERTEX_SHADER ? viewSource : "", source };
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 3, sources, NULL);
+	glCompileShader(shader);
+	GLint ok = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[4096];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("Cannot compile the %s shader:\n%s\n", name, log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+// Links the two shaders and binds the samplers and the frame block, or
+// prints the problem and returns 0. Without a fragment shader the program
+// only captures the output feedback of the vertex shader.
+static GLuint linkProgram(const char *vertexSource,
+		const char *fragmentSource, const char *name,
+		const char *feedback = NULL) {
+	GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource, name);
+	GLuint fragment = fragmentSource == NULL ? 0
+			: compileShader(GL_FRAGMENT_SHADER, fragmentSource, name);
+	if (vertex == 0 || (fragment == 0 && fragmentSource != NULL)) {
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	if (fragment != 0)
+		glAttachShader(program, fragment);
+	if (feedback != NULL)
+		glTransformFeedbackVaryings(program, 1, &feedback,
+				GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	GLint ok = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if (!ok) {
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		printf("Cannot link the %s shaders:\n%s\n", name, log);
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "surface"), 0);
+	glUniform1i(glGetUniformLocation(program, "elements"), 1);
+	glUniform1i(glGetUniformLocation(program, "positions"), 2);
+	glUniform1i(glGetUniformLocation(program, "placeholder"), 3);
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), 0);
+	glUseProgram(0);
+	return program;
+}
+
+// A buffer texture of four floats per texel over a new buffer.
+static void createBufferTexture(GLuint *buffer, GLuint *texture) {
+	glGenBuffers(1, buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 4 * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+	glGenTextures(1, texture);
+	glBindTexture(GL_TEXTURE_BUFFER, *texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, *buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+CoreRenderer::CoreRenderer() :
+		table(NULL), stars(NULL), epochDays(0.0), sun(-1), solveProgram(0),
+		beltProgram(0), bodyProgram(0), pointProgram(0), starProgram(0),
+		lineProgram(0), wireframeLocation(-1), colorLocation(-1),
+		centerLocation(-1), relativeLocation(-1),
+		frameBuffer(0), elementBuffer(0), elementTexture(0), positionBuffer(0),
+		positionTexture(0), instanceBuffer(0), beltBuffer(0), beltArray(0),
+		beltPointBuffer(0), beltPointArray(0), particleBuffer(0),
+		particleArray(0), starArray(0), solveArray(0), lineArray(0) {
+}
+
+bool CoreRenderer::compile() {
+	solveProgram = linkProgram(solveVertexSource, NULL, "solve", "solved");
+	beltProgram = linkProgram(beltVertexSource, NULL, "belt", "solvedPoint");
+	bodyProgram = linkProgram(bodyVertexSource, bodyFragmentSource, "body");
+	pointProgram = linkProgram(pointVertexSource, pointFragmentSource, "point");
+	starProgram = linkProgram(starVertexSource, starFragmentSource, "star");
+	// coloured per vertex, as the stars are
+	lineProgram = linkProgram(lineVertexSource, starFragmentSource, "line");
+	if (solveProgram == 0 || beltProgram == 0 || bodyProgram == 0
+			|| pointProgram == 0 || starProgram == 0 || lineProgram == 0) {
+		release();
+		return false;
+	}
+	wireframeLocation = glGetUniformLocation(bodyProgram, "wireframe");
+	colorLocation = glGetUniformLocation(pointProgram, "color");
+	centerLocation = glGetUniformLocation(pointProgram, "center");
+	relativeLocation = glGetUniformLocation(lineProgram, "relative");
+	return true;
+}
+
+void CoreRenderer::upload(const BodyTable &bodyTable,
+		const std::vector<FrameStage> &stages, const StarField &starField) {
+	table = &bodyTable;
+	stars = &starField;
+	const int n = table->count;
+
+	glGenBuffers(1, &frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, frameBuffer);
+
+	createBufferTexture(&elementBuffer, &elementTexture);
+	createBufferTexture(&positionBuffer, &positionTexture);
+	// written by the solve pass, or from the state under gravity
+	glBindBuffer(GL_TEXTURE_BUFFER, positionBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, 4 * std::max(n, 1) * sizeof(GLfloat), NULL,
+			GL_DYNAMIC_COPY);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	sun = -1;
+	flags.assign(n, 0);
+	for (int i = 0; i < n; i++) {
+		if (stages[i] == STAGE_SUN && sun < 0)
+			sun = i;
+		if (stages[i] == STAGE_STARS || stages[i] == STAGE_SUN)
+			flags[i] |= bodyEmissive;
+		if (table->shape[i] == SHAPE_RING)
+			flags[i] |= bodyRing;
+		if (table->texture[i] != 0)
+			flags[i] |= bodyTextured;
+		if (!table->textureReady[i])
+			flags[i] |= bodyPlaceholder;
+	}
+	uploadElements(0.0);
+
+	// bodies that share stage, texture and mesh make a group, and the
+	// groups follow the order of the render queue's keys
+	std::vector<std::pair<uint64_t, int> > order;
+	for (int i = 0; i < n; i++)
+		if (table->shape[i] != SHAPE_BELT)
+			order.push_back(std::make_pair((uint64_t) stages[i] << 56
+					| (uint64_t) (table->texture[i] & 0xffffff) << 32
+					| table->mesh[i].level[0]->vertexBuffer, i));
+	std::sort(order.begin(), order.end());
+	for (size_t i = 0; i < order.size(); i++) {
+		const int body = order[i].second;
+		if (i == 0 || order[i].first != order[i - 1].first) {
+			InstanceGroup group;
+			group.stage = stages[body];
+			group.texture = table->texture[body];
+			group.placeholder = table->placeholderTexture[body];
+			group.lod = table->mesh[body];
+			for (int l = 0; l < meshLodCount; l++) {
+				group.first[l] = group.count[l] = 0;
+				group.vertexArray[l] = 0;
+			}
+			groups.push_back(group);
+		}
+		groups.back().bodies.push_back(body);
+	}
+	// refilled every frame with the bodies each view shows
+	glGenBuffers(1, &instanceBuffer);
+
+	// each level of each group reads its mesh, and the instances from
+	// wherever the frame puts them
+	for (size_t g = 0; g < groups.size(); g++) {
+		InstanceGroup &group = groups[g];
+		glGenVertexArrays(meshLodCount, group.vertexArray);
+		for (int l = 0; l < meshLodCount; l++) {
+			const Mesh &mesh = *group.lod.level[l];
+			glBindVertexArray(group.vertexArray[l]);
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+					(const GLvoid *) offsetof(MeshVertex, x));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+					(const GLvoid *) offsetof(MeshVertex, nx));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+					(const GLvoid *) offsetof(MeshVertex, s));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+			glEnableVertexAttribArray(3);
+			glVertexAttribDivisor(3, 1);
+		}
+	}
+
+	// the belt buffer never changes: the shader solves each orbit from J2000,
+	// and belt mean motions are slow enough for float days over centuries
+	const KeplerOrbits &belt = table->beltOrbits;
+	const int beltBodies = (int) belt.eccentricity.size();
+	std::vector<GLfloat> beltData(9 * std::max(beltBodies, 1), 0.0f);
+	for (int b = 0; b < beltBodies; b++) {
+		GLfloat *out = &beltData[9 * b];
+		out[0] = (GLfloat) belt.px[b];
+		out[1] = (GLfloat) belt.py[b];
+		out[2] = (GLfloat) belt.pz[b];
+		out[3] = (GLfloat) remainder(belt.meanAnomaly[b], 2.0 * M_PI);
+		out[4] = (GLfloat) belt.qx[b];
+		out[5] = (GLfloat) belt.qy[b];
+		out[6] = (GLfloat) belt.qz[b];
+		out[7] = (GLfloat) belt.meanMotion[b];
+		out[8] = (GLfloat) belt.eccentricity[b];
+	}
+	glGenBuffers(1, &beltBuffer);
+	glGenVertexArrays(1, &beltArray);
+	glBindVertexArray(beltArray);
+	glBindBuffer(GL_ARRAY_BUFFER, beltBuffer);
+	glBufferData(GL_ARRAY_BUFFER, beltData.size() * sizeof(GLfloat),
+			&beltData[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat),
+			(const GLvoid *) 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat),
+			(const GLvoid *) (4 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat),
+			(const GLvoid *) (8 * sizeof(GLfloat)));
+	// where the belt pass puts them each frame, for every view to draw
+	glGenBuffers(1, &beltPointBuffer);
+	glGenVertexArrays(1, &beltPointArray);
+	glBindVertexArray(beltPointArray);
+	glBindBuffer(GL_ARRAY_BUFFER, beltPointBuffer);
+	glBufferData(GL_ARRAY_BUFFER, 3 * std::max(beltBodies, 1)
+			* sizeof(GLfloat), NULL, GL_DYNAMIC_COPY);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *) 0);
+
+	// free particles are streamed as bare positions
+	glGenBuffers(1, &particleBuffer);
+	glGenVertexArrays(1, &particleArray);
+	glBindVertexArray(particleArray);
+	glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *) 0);
+
+	// the solve pass reads no attributes, but core contexts draw with an
+	// array bound
+	glGenVertexArrays(1, &solveArray);
+
+	glGenVertexArrays(1, &lineArray);
+	glBindVertexArray(lineArray);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	glGenVertexArrays(1, &starArray);
+	glBindVertexArray(starArray);
+	if (stars->buffer != 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, stars->buffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(StarVertex),
+				(const GLvoid *) offsetof(StarVertex, x));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+				sizeof(StarVertex), (const GLvoid *) offsetof(StarVertex, r));
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CoreRenderer::uploadElements(double epoch) {
+	const BodyTable &t = *table;
+	const KeplerOrbits &orbits = t.orbits;
+	const double years = epoch / 365.25;
+	elements.resize(elementTexels * 4 * std::max(t.count, 1), 0.0f);
+	for (int i = 0; i < t.count; i++) {
+		GLfloat *out = &elements[elementTexels * 4 * i];
+		out[0] = (GLfloat) orbits.px[i];
+		out[1] = (GLfloat) orbits.py[i];
+		out[2] = (GLfloat) orbits.pz[i];
+		out[3] = (GLfloat) remainder(orbits.meanAnomaly[i]
+				+ orbits.meanMotion[i] * epoch, 2.0 * M_PI);
+		out[4] = (GLfloat) orbits.qx[i];
+		out[5] = (GLfloat) orbits.qy[i];
+		out[6] = (GLfloat) orbits.qz[i];
+		out[7] = (GLfloat) orbits.meanMotion[i];
+		out[8] = t.eccentricity[i];
+		out[9] = (GLfloat) t.parent[i];
+		out[10] = t.radius[i];
+		out[11] = (GLfloat) flags[i];
+		out[12] = t.textureRect[i].s;
+		out[13] = t.textureRect[i].t;
+		out[14] = t.textureRect[i].width;
+		out[15] = t.textureRect[i].height;
+		// the mean longitude turns the body as it goes round, as in
+		// updateBodies, and the spin on top
+		double longitude = t.node[i] + t.periapsis[i] + t.meanAnomaly[i];
+		out[16] = (GLfloat) fmod(longitude + t.yearRate[i] * years * 360.0
+				+ t.dayRate[i] * years * 180.0, 360.0);
+		out[17] = (GLfloat) ((t.yearRate[i] * 360.0 + t.dayRate[i] * 180.0)
+				/ 365.25);
+		out[18] = out[19] = 0.0f;
+		out[20] = t.frame[i].x;
+		out[21] = t.frame[i].y;
+		out[22] = t.frame[i].z;
+		out[23] = t.frame[i].w;
+	}
+	epochDays = epoch;
+	glBindBuffer(GL_TEXTURE_BUFFER, elementBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, elements.size() * sizeof(GLfloat),
+			&elements[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void CoreRenderer::draw(const View *views, int viewCount, double days,
+		const BodyState &state, bool statePositions, bool lod, bool wireframe,
+		const TrailBuffer *trails, const OrbitPaths *orbits) {
+	// the bodies whose textures have streamed in leave their placeholders
+	bool streamed = false;
+	for (int i = 0; i < table->count; i++) {
+		if ((flags[i] & bodyPlaceholder) != 0 && table->textureReady[i]) {
+			flags[i] &= ~bodyPlaceholder;
+			streamed = true;
+		}
+	}
+	if (fabs(days - epochDays) > rebaseDays)
+		uploadElements(floor(days + 0.5));
+	else if (streamed)
+		uploadElements(epochDays);
+	if (statePositions) {
+		positions.resize(4 * std::max(table->count, 1));
+		for (int i = 0; i < table->count; i++) {
+			positions[4 * i] = state.x[i];
+			positions[4 * i + 1] = state.y[i];
+			positions[4 * i + 2] = state.z[i];
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, positionBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, positions.size() * sizeof(GLfloat),
+				&positions[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// the views are drawn over the window they tile, each as an instance
+	int left = views[0].x, bottom = views[0].y;
+	int right = left + views[0].width, top = bottom + views[0].height;
+	for (int v = 1; v < viewCount; v++) {
+		left = std::min(left, views[v].x);
+		bottom = std::min(bottom, views[v].y);
+		right = std::max(right, views[v].x + views[v].width);
+		top = std::max(top, views[v].y + views[v].height);
+	}
+	glViewport(left, bottom, right - left, top - bottom);
+
+	FrameBlock frame;
+	memset(&frame, 0, sizeof(frame));
+	Frustum frustums[maxViews];
+	for (int v = 0; v < viewCount; v++) {
+		const View &view = views[v];
+		Matrix4 camera = matrixLookAt(view.camera);
+		matrixFrustum(view.projection.m, camera.m, view.height, &frustums[v]);
+		Matrix4 viewProjection = matrixMultiply(view.projection, camera);
+		std::copy(viewProjection.m, viewProjection.m + 16,
+				frame.viewProjection[v]);
+		frame.tile[v][0] = (GLfloat) view.width / (right - left);
+		frame.tile[v][1] = (GLfloat) view.height / (top - bottom);
+		frame.tile[v][2] = (GLfloat) (2 * (view.x - left) + view.width)
+				/ (right - left) - 1.0f;
+		frame.tile[v][3] = (GLfloat) (2 * (view.y - bottom) + view.height)
+				/ (top - bottom) - 1.0f;
+	}
+	frame.light[0] = sun >= 0 ? state.x[sun] : 0.0f;
+	frame.light[1] = sun >= 0 ? state.y[sun] : 0.0f;
+	frame.light[2] = sun >= 0 ? state.z[sun] : 0.0f;
+	frame.light[3] = ambientLight;
+	frame.clock[0] = (GLfloat) (days - epochDays);
+	frame.clock[1] = (GLfloat) days;
+	frame.clock[2] = 0.0f;
+	frame.clock[3] = (GLfloat) viewCount;
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// every body in every view that shows it, at the level of detail it
+	// appears at there; each group's instances by level
+	instances.clear();
+	for (size_t g = 0; g < groups.size(); g++) {
+		InstanceGroup &group = groups[g];
+		for (int l = 0; l < meshLodCount; l++)
+			levelInstances[l].clear();
+		for (size_t b = 0; b < group.bodies.size(); b++) {
+			const int i = group.bodies[b];
+			const float x = state.x[i], y = state.y[i], z = state.z[i];
+			for (int v = 0; v < viewCount; v++) {
+				int level = 0;
+				if (lod) {
+					if (!sphereInFrustum(frustums[v], x, y, z,
+							table->radius[i])) {
+						meshStats.culled++;
+						continue;
+					}
+					level = selectMeshLodLevel(group.lod, projectedRadius(
+							frustums[v], x, y, z, table->radius[i]));
+				}
+				levelInstances[level].push_back(i);
+				levelInstances[level].push_back(v);
+			}
+		}
+		for (int l = 0; l < meshLodCount; l++) {
+			group.first[l] = (int) instances.size() / 2;
+			group.count[l] = (int) levelInstances[l].size() / 2;
+			instances.insert(instances.end(), levelInstances[l].begin(),
+					levelInstances[l].end());
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GLint),
+			instances.empty() ? NULL : &instances[0], GL_STREAM_DRAW);
+
+	// every body's position, once for all its vertices in every view
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, elementTexture);
+	if (!statePositions && table->count > 0) {
+		glEnable(GL_RASTERIZER_DISCARD);
+		glUseProgram(solveProgram);
+		glBindVertexArray(solveArray);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, positionBuffer);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, table->count);
+		glEndTransformFeedback();
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+		meshStats.drawCalls++;
+		meshStats.indices += table->count;
+	}
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_BUFFER, positionTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	// a point up to its size from the edge of a tile may spill over it, as
+	// only its centre is clipped
+	for (int k = 0; viewCount > 1 && k < 4; k++)
+		glEnable(GL_CLIP_DISTANCE0 + k);
+
+	// the stars first, behind everything and unclipped by the far plane
+	if (stars->buffer != 0) {
+		profileStage(STAGE_STARS);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_DEPTH_CLAMP);
+		glUseProgram(starProgram);
+		glBindVertexArray(starArray);
+		for (int k = 0; k < starSizeCount; k++) {
+			if (stars->count[k] == 0)
+				continue;
+			glPointSize(starPointSizes[k]);
+			glDrawArraysInstanced(GL_POINTS, stars->first[k],
+					stars->count[k], viewCount);
+			meshStats.drawCalls++;
+			meshStats.indices += (unsigned long) stars->count[k] * viewCount;
+		}
+		glDisable(GL_DEPTH_CLAMP);
+		glPointSize(1.0f);
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	glUseProgram(bodyProgram);
+	glUniform1i(wireframeLocation, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	GLuint boundTexture = 0, boundPlaceholder = 0;
+	glBindTexture(GL_TEXTURE_2D, 0);
+	for (size_t g = 0; g < groups.size(); g++) {
+		const InstanceGroup &group = groups[g];
+		profileStage(group.stage);
+		if (group.texture != boundTexture) {
+			glBindTexture(GL_TEXTURE_2D, group.texture);
+			boundTexture = group.texture;
+		}
+		if (group.placeholder != boundPlaceholder) {
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, group.placeholder);
+			glActiveTexture(GL_TEXTURE0);
+			boundPlaceholder = group.placeholder;
+		}
+		for (int l = 0; l < meshLodCount; l++) {
+			if (group.count[l] == 0)
+				continue;
+			const Mesh &mesh = *group.lod.level[l];
+			glBindVertexArray(group.vertexArray[l]);
+			glVertexAttribIPointer(3, 2, GL_INT, 0,
+					(const GLvoid *) (group.first[l] * 2 * sizeof(GLint)));
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount,
+					GL_UNSIGNED_INT, 0, group.count[l]);
+			meshStats.drawCalls++;
+			meshStats.indices += (unsigned long) mesh.indexCount
+					* group.count[l];
+		}
+	}
+	if (wireframe) {
+		glUniform1i(wireframeLocation, 1);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		glEnable(GL_POLYGON_OFFSET_LINE);
+		glPolygonOffset(-1.0f, -1.0f);
+		for (size_t g = 0; g < groups.size(); g++) {
+			const InstanceGroup &group = groups[g];
+			profileStage(group.stage);
+			for (int l = 0; l < meshLodCount; l++) {
+				if (group.count[l] == 0)
+					continue;
+				// the pointers are still those of the filled draw
+				glBindVertexArray(group.vertexArray[l]);
+				glDrawElementsInstanced(GL_TRIANGLES,
+						group.lod.level[l]->indexCount, GL_UNSIGNED_INT, 0,
+						group.count[l]);
+				meshStats.drawCalls++;
+			}
+		}
+		glDisable(GL_POLYGON_OFFSET_LINE);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	}
+
+	profileStage(STAGE_POINTS);
+	// the belt bodies' orbits, solved once for all the views
+	const int beltBodies = (int) table->beltOrbits.eccentricity.size();
+	if (beltBodies > 0) {
+		glEnable(GL_RASTERIZER_DISCARD);
+		glUseProgram(beltProgram);
+		glBindVertexArray(beltArray);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, beltPointBuffer);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, 0, beltBodies);
+		glEndTransformFeedback();
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+		meshStats.drawCalls++;
+		meshStats.indices += beltBodies;
+	}
+	glUseProgram(pointProgram);
+	// each belt around where its row is this frame
+	glUniform3f(colorLocation, 0.6f, 0.55f, 0.5f);
+	glBindVertexArray(beltPointArray);
+	for (int row = 0; row < (int) table->beltCount.size(); row++) {
+		if (table->beltCount[row] == 0)
+			continue;
+		glUniform3f(centerLocation, state.x[row], state.y[row], state.z[row]);
+		glDrawArraysInstanced(GL_POINTS, table->beltFirst[row],
+				table->beltCount[row], viewCount);
+		meshStats.drawCalls++;
+		meshStats.indices += (unsigned long) table->beltCount[row]
+				* viewCount;
+	}
+	if (!state.points.empty()) {
+		GLsizei count = (GLsizei) (state.points.size() / 3);
+		glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+		glBufferData(GL_ARRAY_BUFFER, state.points.size() * sizeof(GLfloat),
+				&state.points[0], GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUniform3f(centerLocation, 0.0f, 0.0f, 0.0f);
+		glUniform3f(colorLocation, 0.8f, 0.8f, 0.7f);
+		glBindVertexArray(particleArray);
+		glDrawArraysInstanced(GL_POINTS, 0, count, viewCount);
+		meshStats.drawCalls++;
+		meshStats.indices += (unsigned long) count * viewCount;
+	}
+
+	// the lines are hidden by the bodies, but do not hide each other
+	profileStage(STAGE_TRAILS);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	glUseProgram(lineProgram);
+	glBindVertexArray(lineArray);
+	if (orbits != NULL && orbits->indexCount > 0) {
+		// every orbit in one draw, each around where its parent is
+		glUniform1i(relativeLocation, 1);
+		glBindBuffer(GL_ARRAY_BUFFER, orbits->buffer);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(OrbitVertex),
+				(const GLvoid *) 0);
+		glBindBuffer(GL_ARRAY_BUFFER, orbits->colorBuffer);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+				(const GLvoid *) 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, orbits->indexBuffer);
+		glDrawElementsInstanced(GL_LINES, orbits->indexCount, GL_UNSIGNED_INT,
+				0, viewCount);
+		meshStats.drawCalls++;
+		meshStats.indices += (unsigned long) orbits->indexCount * viewCount;
+	}
+	if (trails != NULL && trails->indexCount > 0 && !trails->empty) {
+		glUniform1i(relativeLocation, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, trails->buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0,
+				(const GLvoid *) trailWindowOffset(*trails));
+		glBindBuffer(GL_ARRAY_BUFFER, trails->colorBuffer);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+				(const GLvoid *) 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, trails->indexBuffer);
+		glDrawElementsInstanced(GL_LINES, trails->indexCount, GL_UNSIGNED_INT,
+				0, viewCount);
+		meshStats.drawCalls++;
+		meshStats.indices += (unsigned long) trails->indexCount * viewCount;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	for (int k = 0; k < 4; k++)
+		glDisable(GL_CLIP_DISTANCE0 + k);
+	// the buffers were bound behind the cache's back, and the trails write
+	// theirs through it
+	glState.invalidate();
+}
+
+void CoreRenderer::release() {
+	for (size_t g = 0; g < groups.size(); g++)
+		glDeleteVertexArrays(meshLodCount, groups[g].vertexArray);
+	groups.clear();
+	GLuint arrays[] = { beltArray, beltPointArray, particleArray, starArray,
+			solveArray, lineArray };
+	glDeleteVertexArrays(6, arrays);
+	GLuint buffers[] = { frameBuffer, elementBuffer, positionBuffer,
+			instanceBuffer, beltBuffer, beltPointBuffer, particleBuffer };
+	glDeleteBuffers(7, buffers);
+	GLuint textures[] = { elementTexture, positionTexture };
+	glDeleteTextures(2, textures);
+	glDeleteProgram(bodyProgram);
+	glDeleteProgram(pointProgram);
+	glDeleteProgram(starProgram);
+	glDeleteProgram(solveProgram);
+	glDeleteProgram(beltProgram);
+	glDeleteProgram(lineProgram);
+	beltArray = beltPointArray = particleArray = starArray = solveArray = 0;
+	lineArray = 0;
+	frameBuffer = elementBuffer = positionBuffer = instanceBuffer = 0;
+	beltBuffer = beltPointBuffer = particleBuffer = 0;
+	elementTexture = positionTexture = 0;
+	solveProgram = beltProgram = bodyProgram = pointProgram = 0;
+	starProgram = lineProgram = 0;
+	elements.clear();
+	flags.clear();
+}
@@ -0,0 +1,113 @@
+/* A shader renderer for OpenGL 3.3 core profile contexts.
+ *
+ * Everything that only depends on time is worked out on the GPU: the
+ * orbital elements, spin, tilt and surface of every body are uploaded once
+ * into a buffer texture, and a first pass solves Kepler's equation for
+ * every body and each of its parents, once a frame at the time held in a
+ * uniform block with the cameras and the light, into a buffer of positions
+ * that every vertex then reads; a second pass does the same for the belts
+ * from one static buffer of their orbits. The bodies that share a mesh
+ * and a texture are drawn together as instances, so a frame sends little
+ * more than the clock and the instances. Each instance is a body as one
+ * view sees it: the bodies are culled against every view on the CPU, from
+ * where the simulation has them, and each that shows is given the level
+ * of detail it appears at there. Split-screen views thus multiply the
+ * instances rather than the calls, and each instance is moved into its
+ * view's tile and clipped to it.
+ *
+ * The shader works in single precision, so the elements are restated at a
+ * recent epoch whenever the clock moves far from the last one. Under
+ * gravity the positions are no longer closed form and are streamed from
+ * the state instead.
+ */
+
+#ifndef CORERENDERER_H
+#define CORERENDERER_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <vector>
+
+#include "bodies.h"
+#include "mesh.h"
+#include "profile.h"
+#include "starfield.h"
+#include "trails.h"
+#include "views.h"
+
+class CoreRenderer {
+public:
+	CoreRenderer();
+
+	// Builds the shaders in the current context, which must be a 3.3 core
+	// profile one. Prints the problem and returns false if it cannot.
+	bool compile();
+
+	// Uploads what the shaders need of table, whose bodies are charged to
+	// stages; after compile, and once the meshes, the texture atlas and the
+	// star field exist. Bodies draw their placeholders until the table marks
+	// their textures ready. The table and the stars must outlive the renderer.
+	void upload(const BodyTable &table, const std::vector<FrameStage> &stages,
+			const StarField &stars);
+
+	// Draws every body at days since J2000, as seen from each of the
+	// viewCount views, over the window they tile, charging each draw to its
+	// stage. With statePositions the bodies are where state has them rather
+	// than on their orbits; the culling goes by state either way. With lod
+	// the bodies outside a view are skipped and the others drawn with fewer
+	// triangles the smaller they appear. The free particles of state are
+	// drawn as points either way, and the trails and orbits unless they are
+	// NULL.
+	void draw(const View *views, int viewCount, double days,
+			const BodyState &state, bool statePositions, bool lod,
+			bool wireframe, const TrailBuffer *trails = NULL,
+			const OrbitPaths *orbits = NULL);
+
+	// Deletes the GL objects; the meshes and textures belong to others.
+	void release();
+
+private:
+	// Bodies that share a mesh and a texture, drawn in one call for each
+	// level of detail.
+	struct InstanceGroup {
+		FrameStage stage;
+		GLuint texture;
+		GLuint placeholder;  // sampled by bodies not yet streamed in
+		MeshLod lod;
+		std::vector<int> bodies;
+		// this frame's instances of each level, into the instance buffer
+		int first[meshLodCount], count[meshLodCount];
+		GLuint vertexArray[meshLodCount];
+	};
+
+	// Restates the elements at epoch and uploads them.
+	void uploadElements(double epoch);
+
+	const BodyTable *table;
+	const StarField *stars;
+	double epochDays;
+	int sun;  // the body the light comes from, or -1
+
+	GLuint solveProgram, beltProgram, bodyProgram, pointProgram, starProgram,
+			lineProgram;
+	GLint wireframeLocation, colorLocation, centerLocation;
+	GLint relativeLocation;
+	GLuint frameBuffer;                  // the per-frame uniform block
+	GLuint elementBuffer, elementTexture;
+	GLuint positionBuffer, positionTexture;
+	GLuint instanceBuffer;
+	GLuint beltBuffer, beltArray;  // the orbits, for the belt pass
+	GLuint beltPointBuffer, beltPointArray;  // and the positions it solves
+	GLuint particleBuffer, particleArray;
+	GLuint starArray;  // over the star field's buffer
+	GLuint solveArray;
+	GLuint lineArray;  // pointed at the trails or the orbits as they draw
+	std::vector<InstanceGroup> groups;
+	std::vector<int> flags;  // of every body, see elementTexels
+	std::vector<GLfloat> elements, positions;
+	// a body and a view for every instance, and those of one group by level
+	std::vector<GLint> instances, levelInstances[meshLodCount];
+};
+
+#endif
@@ -0,0 +1,124 @@
+/* Ephemeris: body positions fitted to Chebyshev polynomials. */
+
+#include "ephemeris.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// the entries are read in place from the mapped file
+static_assert(sizeof(EphemerisHeader) == 16, "EphemerisHeader layout");
+static_assert(sizeof(EphemerisBody) == 72, "EphemerisBody layout");
+
+bool openEphemeris(const char *filename, Ephemeris *ephemeris) {
+	FILE *probe = fopen(filename, "rb");
+	if (probe == NULL)
+		return false;
+	fclose(probe);
+	if (!mapFile(filename, &ephemeris->file, true)) {
+		printf("Cannot read %s\n", filename);
+		return false;
+	}
+
+	const char *base = (const char *) ephemeris->file.data;
+	const size_t size = ephemeris->file.size;
+	ephemeris->header = (const EphemerisHeader *) base;
+	if (size < sizeof(EphemerisHeader)
+			|| memcmp(ephemeris->header->magic, EPHEMERIS_MAGIC, 4) != 0
+			|| ephemeris->header->version != EPHEMERIS_VERSION) {
+		printf("%s is not a version %d ephemeris\n", filename,
+				EPHEMERIS_VERSION);
+		closeEphemeris(ephemeris);
+		return false;
+	}
+	const uint32_t count = ephemeris->header->bodyCount;
+	bool ok = (size - sizeof(EphemerisHeader)) / sizeof(EphemerisBody)
+			>= count;
+	ephemeris->bodies = (const EphemerisBody *) (base
+			+ sizeof(EphemerisHeader));
+	for (uint32_t i = 0; ok && i < count; i++) {
+		const EphemerisBody &body = ephemeris->bodies[i];
+		uint64_t bytes = (uint64_t) body.segmentCount * 3
+				* (body.degree + 1) * sizeof(double);
+		ok = memchr(body.name, '\0', sizeof(body.name)) != NULL
+				&& body.span > 0.0 && body.segmentCount > 0
+				&& body.degree <= (uint32_t) maxChebyshevDegree
+				&& body.offset % sizeof(double) == 0
+				&& body.offset <= size && bytes <= size - body.offset;
+	}
+	if (!ok) {
+		printf("%s is truncated or damaged\n", filename);
+		closeEphemeris(ephemeris);
+		return false;
+	}
+	return true;
+}
+
+void closeEphemeris(Ephemeris *ephemeris) {
+	unmapFile(&ephemeris->file);
+	ephemeris->header = NULL;
+	ephemeris->bodies = NULL;
+}
+
+int findEphemerisBody(const Ephemeris &ephemeris, const char *name) {
+	for (uint32_t i = 0; i < ephemeris.header->bodyCount; i++)
+		if (strcasecmp(ephemeris.bodies[i].name, name) == 0)
+			return (int) i;
+	return -1;
+}
+
+void fitChebyshev(const double *times, const double *values, int count,
+		double start, double span, int degree, double *coefficients) {
+	for (int k = 0; k <= degree; k++)
+		coefficients[k] = 0.0;
+	const int terms = count < degree + 1 ? count : degree + 1;
+	if (terms <= 0)
+		return;
+
+	// the normal equations of the least squares fit, with the right-hand
+	// side as their last column
+	double normal[maxChebyshevDegree + 1][maxChebyshevDegree + 2];
+	memset(normal, 0, sizeof(normal));
+	for (int i = 0; i < count; i++) {
+		const double s = 2.0 * (times[i] - start) / span - 1.0;
+		double t[maxChebyshevDegree + 1];
+		t[0] = 1.0;
+		if (terms > 1)
+			t[1] = s;
+		for (int k = 2; k < terms; k++)
+			t[k] = 2.0 * s * t[k - 1] - t[k - 2];
+		for (int r = 0; r < terms; r++) {
+			for (int c = 0; c < terms; c++)
+				normal[r][c] += t[r] * t[c];
+			normal[r][terms] += t[r] * values[i];
+		}
+	}
+
+	// Gaussian elimination with partial pivoting
+	for (int col = 0; col < terms; col++) {
+		int pivot = col;
+		for (int r = col + 1; r < terms; r++)
+			if (fabs(normal[r][col]) > fabs(normal[pivot][col]))
+				pivot = r;
+		if (normal[pivot][col] == 0.0)
+			continue;
+		if (pivot != col)
+			for (int c = col; c <= terms; c++) {
+				double swap = normal[col][c];
+				normal[col][c] = normal[pivot][c];
+				normal[pivot][c] = swap;
+			}
+		for (int r = col + 1; r < terms; r++) {
+			double factor = normal[r][col] / normal[col][col];
+			for (int c = col; c <= terms; c++)
+				normal[r][c] -= factor * normal[col][c];
+		}
+	}
+	for (int r = terms - 1; r >= 0; r--) {
+		double sum = normal[r][terms];
+		for (int c = r + 1; c < terms; c++)
+			sum -= normal[r][c] * coefficients[c];
+		coefficients[r] = normal[r][r] != 0.0 ? sum / normal[r][r] : 0.0;
+	}
+}
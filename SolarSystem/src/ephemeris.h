@@ -0,0 +1,106 @@
+/* Ephemeris: body positions fitted to Chebyshev polynomials.
+ *
+ * Layout, little endian:
+ *   EphemerisHeader
+ *   EphemerisBody[bodyCount]
+ *   the coefficients, as doubles: for every body, segmentCount segments of
+ *   x, y and z, each degree + 1 coefficients, lowest order first
+ *
+ * Each body's time is cut into segments of equal span, and in each the
+ * position relative to the body's parent is a Chebyshev series in the time
+ * mapped onto [-1, 1], as in JPL's ephemerides. A position at any time is
+ * then found by picking its segment, which takes a division, and summing
+ * the series by Clenshaw's recurrence, two multiply-adds a coefficient.
+ * The coefficients are read in place from the mapped file; see
+ * tools/ephem.cpp for the writer, which fits them to tables of positions.
+ *
+ * Times are days since J2000 (TDB) and positions are ecliptic, in whatever
+ * unit the tables had: the table of bodies fixes the scale of the scene, so
+ * each body's positions are scaled so that their mean distance becomes its
+ * distance there.
+ */
+
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "mappedfile.h"
+
+#define EPHEMERIS_MAGIC "EPHM"
+#define EPHEMERIS_VERSION 1
+
+// The most coefficients a series may have.
+const int maxChebyshevDegree = 31;
+
+struct EphemerisHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t bodyCount;
+	uint32_t reserved;
+};
+
+struct EphemerisBody {
+	char name[32];          // NUL terminated
+	double start;           // days since J2000 where the first segment starts
+	double span;            // days each segment covers
+	uint32_t segmentCount;
+	uint32_t degree;        // of the series
+	uint64_t offset;        // of the first coefficient, in bytes from the start
+	double meanDistance;    // from the parent, over the fitted positions
+};
+
+struct Ephemeris {
+	MappedFile file;
+	const EphemerisHeader *header;
+	const EphemerisBody *bodies;
+};
+
+// Maps an ephemeris and checks that its coefficients lie inside the file.
+// Returns false, printing the reason unless the file is missing, if they
+// do not.
+bool openEphemeris(const char *filename, Ephemeris *ephemeris);
+
+void closeEphemeris(Ephemeris *ephemeris);
+
+// The body with the given name, in any case, or -1.
+int findEphemerisBody(const Ephemeris &ephemeris, const char *name);
+
+// Writes the position of body at days since J2000 into xyz, in the axes and
+// unit of the file. Returns false, leaving xyz alone, outside the segments.
+inline bool ephemerisPosition(const Ephemeris &ephemeris, int body,
+		double days, double xyz[3]) {
+	const EphemerisBody &entry = ephemeris.bodies[body];
+	double segment = (days - entry.start) / entry.span;
+	if (!(segment >= 0.0 && segment <= entry.segmentCount))
+		return false;
+	uint32_t index = (uint32_t) segment;
+	if (index == entry.segmentCount)
+		index--;
+	const int terms = entry.degree + 1;
+	const double *c = (const double *) ((const char *) ephemeris.file.data
+			+ entry.offset) + (size_t) index * 3 * terms;
+	// Clenshaw's recurrence, on s in [-1, 1] across the segment
+	const double s = 2.0 * (segment - index) - 1.0, twoS = 2.0 * s;
+	for (int axis = 0; axis < 3; axis++, c += terms) {
+		double b1 = 0.0, b2 = 0.0;
+		for (int k = terms - 1; k > 0; k--) {
+			double b = twoS * b1 - b2 + c[k];
+			b2 = b1;
+			b1 = b;
+		}
+		xyz[axis] = s * b1 - b2 + c[0];
+	}
+	return true;
+}
+
+// Fits a Chebyshev series of degree to the count values sampled at times,
+// by least squares over the segment from start to start + span, and writes
+// its degree + 1 coefficients. Needs more samples than degree; with fewer
+// the series is fitted to as high a degree as they allow and the rest of
+// the coefficients are 0.
+void fitChebyshev(const double *times, const double *values, int count,
+		double start, double span, int degree, double *coefficients);
+
+#endif
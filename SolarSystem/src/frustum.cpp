@@ -0,0 +1,57 @@
+/* View-frustum culling and projected sizes. */
+
+#include "frustum.h"
+
+#include <cfloat>
+#include <cmath>
+
+void matrixFrustum(const float projection[16], const float modelview[16],
+		int viewportHeight, Frustum *frustum) {
+	// clip = projection * modelview, both column major
+	float clip[16];
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += projection[k * 4 + r] * modelview[c * 4 + k];
+			clip[c * 4 + r] = sum;
+		}
+
+	// each plane is the last row of clip plus or minus one of the others
+	// (Gribb and Hartmann)
+	for (int p = 0; p < 6; p++) {
+		int row = p / 2;
+		float sign = p % 2 == 0 ? 1.0f : -1.0f;
+		float *plane = frustum->planes[p];
+		for (int c = 0; c < 4; c++)
+			plane[c] = clip[c * 4 + 3] + sign * clip[c * 4 + row];
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1]
+				+ plane[2] * plane[2]);
+		for (int c = 0; c < 4; c++)
+			plane[c] /= length;
+	}
+
+	// the eye looks down -z
+	for (int c = 0; c < 4; c++)
+		frustum->depth[c] = -modelview[c * 4 + 2];
+	frustum->pixelScale = projection[5] * viewportHeight * 0.5f;
+}
+
+bool sphereInFrustum(const Frustum &frustum, float x, float y, float z,
+		float radius) {
+	for (int p = 0; p < 6; p++) {
+		const float *plane = frustum.planes[p];
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+			return false;
+	}
+	return true;
+}
+
+float projectedRadius(const Frustum &frustum, float x, float y, float z,
+		float radius) {
+	float depth = frustum.depth[0] * x + frustum.depth[1] * y
+			+ frustum.depth[2] * z + frustum.depth[3];
+	if (depth <= radius)
+		return FLT_MAX;
+	return radius * frustum.pixelScale / depth;
+}
@@ -0,0 +1,35 @@
+/* View-frustum culling and projected sizes.
+ *
+ * The frustum is taken from the projection and view matrices a view is
+ * drawn with, so it always matches its camera and its tile of the window.
+ * Bodies are tested as bounding spheres against its six planes, and their
+ * projected radius in pixels picks the level of detail they are drawn at.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+struct Frustum {
+	// a x + b y + c z + d >= 0 inside each plane, with (a, b, c) unit length
+	float planes[6][4];
+	// view-space depth is depth[0] x + depth[1] y + depth[2] z + depth[3]
+	float depth[4];
+	// pixels covered by a unit length at unit depth
+	float pixelScale;
+};
+
+// The frustum of the given column-major matrices, seen through a viewport
+// viewportHeight pixels high.
+void matrixFrustum(const float projection[16], const float modelview[16],
+		int viewportHeight, Frustum *frustum);
+
+// Whether a sphere around (x, y, z) may show.
+bool sphereInFrustum(const Frustum &frustum, float x, float y, float z,
+		float radius);
+
+// Radius in pixels that a sphere around (x, y, z) appears with; a very large
+// value when the eye is inside it.
+float projectedRadius(const Frustum &frustum, float x, float y, float z,
+		float radius);
+
+#endif
@@ -0,0 +1,41 @@
+/* Queries about the current OpenGL context. */
+
+#define GL_GLEXT_PROTOTYPES
+#include "glinfo.h"
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <stdio.h>
+#include <string.h>
+
+bool glVersionAtLeast(int major, int minor) {
+	const char *version = (const char *) glGetString(GL_VERSION);
+	int haveMajor = 0, haveMinor = 0;
+	if (version == NULL || sscanf(version, "%d.%d", &haveMajor, &haveMinor) != 2)
+		return false;
+	return haveMajor > major || (haveMajor == major && haveMinor >= minor);
+}
+
+bool hasGLExtension(const char *name) {
+	// core profiles only list extensions one at a time
+	if (glVersionAtLeast(3, 0)) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+			if (extension != NULL && strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	const char *extensions = (const char *) glGetString(GL_EXTENSIONS);
+	size_t length = strlen(name);
+	for (const char *p = extensions; p != NULL && (p = strstr(p, name)) != NULL;
+			p += length) {
+		if ((p == extensions || p[-1] == ' ')
+				&& (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	}
+	return false;
+}
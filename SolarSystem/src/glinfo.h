@@ -0,0 +1,12 @@
+/* Queries about the current OpenGL context. */
+
+#ifndef GLINFO_H
+#define GLINFO_H
+
+// True when the context is at least OpenGL major.minor.
+bool glVersionAtLeast(int major, int minor);
+
+// True when the context advertises the named extension.
+bool hasGLExtension(const char *name);
+
+#endif
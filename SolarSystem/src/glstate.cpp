@@ -0,0 +1,116 @@
+/* A thin cache over the GL state the renderer sets per frame. */
+
+#include "glstate.h"
+
+#include <cstring>
+
+GLStateStats glStateStats;
+GLStateCache glState;
+
+void resetGLStateStats() {
+	glStateStats.issued = 0;
+	glStateStats.elided = 0;
+}
+
+GLStateCache::GLStateCache() {
+	invalidate();
+}
+
+void GLStateCache::invalidate() {
+	enabled.clear();
+	clientArrays.clear();
+	buffers.clear();
+	lights.clear();
+	haveDepthFunc = false;
+	haveTexture = false;
+	haveTextureRect = false;
+}
+
+bool GLStateCache::changes(std::map<unsigned, unsigned> &known, unsigned key,
+		unsigned value) {
+	std::map<unsigned, unsigned>::iterator it = known.find(key);
+	if (it != known.end() && it->second == value) {
+		glStateStats.elided++;
+		return false;
+	}
+	known[key] = value;
+	glStateStats.issued++;
+	return true;
+}
+
+void GLStateCache::enable(GLenum capability, bool on) {
+	if (!changes(enabled, capability, on))
+		return;
+	if (on)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GLStateCache::depthFunc(GLenum func) {
+	if (haveDepthFunc && currentDepthFunc == func) {
+		glStateStats.elided++;
+		return;
+	}
+	haveDepthFunc = true;
+	currentDepthFunc = func;
+	glStateStats.issued++;
+	glDepthFunc(func);
+}
+
+void GLStateCache::bindTexture(GLuint texture) {
+	if (haveTexture && currentTexture == texture) {
+		glStateStats.elided++;
+		return;
+	}
+	haveTexture = true;
+	currentTexture = texture;
+	glStateStats.issued++;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLStateCache::textureRect(const AtlasRect &rect) {
+	if (haveTextureRect
+			&& memcmp(&currentTextureRect, &rect, sizeof(rect)) == 0) {
+		glStateStats.elided++;
+		return;
+	}
+	haveTextureRect = true;
+	currentTextureRect = rect;
+	glStateStats.issued++;
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glTranslatef(rect.s, rect.t, 0.0f);
+	glScalef(rect.width, rect.height, 1.0f);
+	glMatrixMode(GL_MODELVIEW);
+}
+
+bool GLStateCache::bindBuffer(GLenum target, GLuint buffer) {
+	if (!changes(buffers, target, buffer))
+		return false;
+	glBindBuffer(target, buffer);
+	return true;
+}
+
+void GLStateCache::clientState(GLenum array, bool on) {
+	if (!changes(clientArrays, array, on))
+		return;
+	if (on)
+		glEnableClientState(array);
+	else
+		glDisableClientState(array);
+}
+
+void GLStateCache::lightfv(GLenum light, GLenum name, const GLfloat *values) {
+	std::pair<GLenum, GLenum> key(light, name);
+	std::map<std::pair<GLenum, GLenum>, LightValue>::iterator it =
+			lights.find(key);
+	if (it != lights.end()
+			&& memcmp(it->second.values, values, sizeof(LightValue)) == 0) {
+		glStateStats.elided++;
+		return;
+	}
+	memcpy(lights[key].values, values, sizeof(LightValue));
+	glStateStats.issued++;
+	glLightfv(light, name, values);
+}
@@ -0,0 +1,74 @@
+/* A thin cache over the GL state the renderer sets per frame.
+ *
+ * Every setter compares against the value it last set and only calls the
+ * GL when it differs, counting both outcomes. The cache only knows about
+ * calls made through it: code that changes the same state directly must
+ * either restore it (glPushAttrib) or call invalidate afterwards.
+ */
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <map>
+#include <utility>
+
+#include "atlas.h"
+
+// State changes since the last resetGLStateStats.
+struct GLStateStats {
+	unsigned long issued;
+	unsigned long elided;
+};
+
+extern GLStateStats glStateStats;
+
+void resetGLStateStats();
+
+class GLStateCache {
+public:
+	GLStateCache();
+
+	// Forgets everything, so that the next call of each kind is issued.
+	void invalidate();
+
+	void enable(GLenum capability, bool on);
+	void depthFunc(GLenum func);
+	// on GL_TEXTURE_2D
+	void bindTexture(GLuint texture);
+	// Returns whether the binding changed, in which case array pointers
+	// into the buffer need setting again.
+	bool bindBuffer(GLenum target, GLuint buffer);
+	void clientState(GLenum array, bool on);
+	// Maps texture coordinates into rect with the texture matrix. Leaves
+	// the modelview matrix mode selected.
+	void textureRect(const AtlasRect &rect);
+	// Four values; not for GL_POSITION or GL_SPOT_DIRECTION, which depend
+	// on the modelview matrix at the time of the call.
+	void lightfv(GLenum light, GLenum name, const GLfloat *values);
+
+private:
+	// Whether a setting with this key differs from value; if so remembers
+	// value and counts the change as issued, otherwise as elided.
+	bool changes(std::map<unsigned, unsigned> &known, unsigned key,
+			unsigned value);
+
+	struct LightValue {
+		GLfloat values[4];
+	};
+
+	// capability, array or buffer target to what it was set to
+	std::map<unsigned, unsigned> enabled, clientArrays, buffers;
+	bool haveDepthFunc, haveTexture, haveTextureRect;
+	GLenum currentDepthFunc;
+	GLuint currentTexture;
+	AtlasRect currentTextureRect;
+	std::map<std::pair<GLenum, GLenum>, LightValue> lights;
+};
+
+// The cache of the one context the renderer draws with.
+extern GLStateCache glState;
+
+#endif
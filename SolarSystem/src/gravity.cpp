@@ -0,0 +1,448 @@
+/* Optional N-body gravity. */
+
+#include "gravity.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "kepler.h"
+#include "threadpool.h"
+
+// The Sun's gravitational parameter in scene units^3 / day^2: the Earth, at
+// distance 5, goes round in a year.
+static const double sunGM = 4.0 * M_PI * M_PI * 125.0 / (365.25 * 365.25);
+// Each swarm particle weighs this many solar masses.
+static const double swarmMass = 1e-12;
+// Plummer softening length squared, so that close passes stay finite.
+static const double softening2 = 1e-6;
+// Tree cells with this many particles or fewer are not split.
+static const int leafSize = 8;
+// Bits of Morton code per axis, which bounds the depth of the tree.
+static const int mortonBits = 10;
+
+// Position and velocity on an orbit around a body with gravitational
+// parameter mu, relative to it. Angles are in degrees except for the mean
+// anomaly m, in radians.
+static void orbitState(double a, double e, double inclination, double node,
+		double periapsis, double m, double mu, double pos[3], double vel[3]) {
+	double p[3], q[3];
+	orbitAxes(inclination, node, periapsis, p, q);
+	double E = solveKepler(m, e);
+	double cosE = cos(E), sinE = sin(E);
+	double b = a * sqrt(1.0 - e * e);
+	double rate = sqrt(mu / (a * a * a)) / (1.0 - e * cosE);  // dE/dt
+	for (int k = 0; k < 3; k++) {
+		pos[k] = a * (cosE - e) * p[k] + b * sinE * q[k];
+		vel[k] = (-a * sinE * p[k] + b * cosE * q[k]) * rate;
+	}
+}
+
+Gravity::Gravity(const BodyTable &table, int swarm, unsigned seed,
+		double theta, double maxStep) :
+		table(table), theta(theta), maxStep(maxStep), time(0.0), count(0),
+		root(-1) {
+	particleOf.assign(table.count, -1);
+	for (int i = 0; i < table.count; i++) {
+		bool orbiting = table.parent[i] >= 0 && table.distance[i] > 0.0f;
+		// the scene's distances are not to scale, so moons start far
+		// outside the reach of their planets' real masses; they keep to
+		// their orbits around wherever their planets go instead
+		bool moon = table.parent[i] >= 0
+				&& table.parent[table.parent[i]] >= 0;
+		if (moon || (table.mass[i] <= 0.0f && !orbiting))
+			continue;
+		particleOf[i] = count++;
+		bodyOf.push_back(i);
+		gm.push_back(table.mass[i] * sunGM);
+		if (root < 0 || gm.back() > gm[root])
+			root = particleOf[i];
+	}
+	if (swarm > 0 && (root < 0 || gm[root] <= 0.0)) {
+		printf("No body has a mass for the swarm to orbit\n");
+		swarm = 0;
+	}
+
+	// the same generator as the synthetic bodies: nine in ten are main
+	// belt asteroids between Mars and Jupiter, the rest comets on long,
+	// steep ellipses
+	for (int n = 0; n < swarm; n++) {
+		double r[7];
+		for (int k = 0; k < 7; k++) {
+			seed = seed * 1664525u + 1013904223u;
+			r[k] = (double) (seed >> 8) / (double) (1 << 24);
+		}
+		bool comet = r[0] < 0.1;
+		swarmA.push_back(comet ? 6.0 + 24.0 * r[1] : 7.0 + 1.5 * r[1]);
+		swarmE.push_back(comet ? 0.5 + 0.45 * r[2] : 0.2 * r[2]);
+		swarmI.push_back(comet ? 40.0 * r[3] : 15.0 * r[3]);
+		swarmNode.push_back(360.0 * r[4]);
+		swarmPeri.push_back(360.0 * r[5]);
+		swarmAnomaly.push_back(360.0 * r[6]);
+		bodyOf.push_back(-1);
+		gm.push_back(swarmMass * sunGM);
+		count++;
+	}
+
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	vx.resize(count);
+	vy.resize(count);
+	vz.resize(count);
+	ax.resize(count);
+	ay.resize(count);
+	az.resize(count);
+	sortedAt.resize(count);
+	reset(0.0);
+}
+
+void Gravity::reset(double days) {
+	time = days;
+
+	// parents come first, so their state is known before their children's
+	std::vector<float> kx(table.count), ky(table.count), kz(table.count);
+	solveKeplerOrbits(table.orbits, days, 0, table.count, &kx[0], &ky[0],
+			&kz[0]);
+	for (int k = 0; k < count && bodyOf[k] >= 0; k++) {
+		int i = bodyOf[k];
+		int parent = table.parent[i] >= 0 ? particleOf[table.parent[i]] : -1;
+		double pos[3] = { kx[i], ky[i], kz[i] }, vel[3] = { 0, 0, 0 };
+		if (parent >= 0) {
+			// where the table puts the body, moving as the masses require
+			double m = table.orbits.meanAnomaly[i]
+					+ table.orbits.meanMotion[i] * days;
+			orbitState(table.distance[i], table.eccentricity[i],
+					table.inclination[i], table.node[i], table.periapsis[i], m,
+					gm[parent] + gm[k], pos, vel);
+			// in the parent's frame, as the table's orbits are
+			quaternionRotate(table.frame[table.parent[i]], pos);
+			quaternionRotate(table.frame[table.parent[i]], vel);
+		}
+		x[k] = pos[0];
+		y[k] = pos[1];
+		z[k] = pos[2];
+		vx[k] = vel[0];
+		vy[k] = vel[1];
+		vz[k] = vel[2];
+		if (parent >= 0) {
+			x[k] += x[parent];
+			y[k] += y[parent];
+			z[k] += z[parent];
+			vx[k] += vx[parent];
+			vy[k] += vy[parent];
+			vz[k] += vz[parent];
+		}
+	}
+
+	const int first = count - (int) swarmA.size();
+	parallelFor(count - first, 1024, [&](int begin, int end) {
+		for (int s = begin; s < end; s++) {
+			int k = first + s;
+			double mu = gm[root] + gm[k];
+			double a = swarmA[s];
+			double m = swarmAnomaly[s] * M_PI / 180.0
+					+ sqrt(mu / (a * a * a)) * days;
+			double pos[3], vel[3];
+			orbitState(a, swarmE[s], swarmI[s], swarmNode[s], swarmPeri[s], m,
+					mu, pos, vel);
+			x[k] = x[root] + pos[0];
+			y[k] = y[root] + pos[1];
+			z[k] = z[root] + pos[2];
+			vx[k] = vx[root] + vel[0];
+			vy[k] = vy[root] + vel[1];
+			vz[k] = vz[root] + vel[2];
+		}
+	});
+
+	// take out the drift of the centre of mass
+	double total = 0.0, px = 0.0, py = 0.0, pz = 0.0;
+	for (int k = 0; k < count; k++) {
+		total += gm[k];
+		px += gm[k] * vx[k];
+		py += gm[k] * vy[k];
+		pz += gm[k] * vz[k];
+	}
+	if (total > 0.0) {
+		for (int k = 0; k < count; k++) {
+			vx[k] -= px / total;
+			vy[k] -= py / total;
+			vz[k] -= pz / total;
+		}
+	}
+
+	computeAccelerations();
+}
+
+// Spreads the low 10 bits of v out to every third bit.
+static uint32_t spreadBits(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+void Gravity::buildTree() {
+	sorted.clear();
+	massless.clear();
+	for (int k = 0; k < count; k++) {
+		if (gm[k] > 0.0)
+			sorted.push_back(k);
+		else
+			massless.push_back(k);
+	}
+	const int n = (int) sorted.size();
+	cells.clear();
+	sortedAt.assign(count, -1);
+	if (n == 0)
+		return;
+
+	// the bounding cube of everything with mass
+	double minX = x[sorted[0]], minY = y[sorted[0]], minZ = z[sorted[0]];
+	double maxX = minX, maxY = minY, maxZ = minZ;
+	for (int s = 1; s < n; s++) {
+		int k = sorted[s];
+		minX = fmin(minX, x[k]);
+		minY = fmin(minY, y[k]);
+		minZ = fmin(minZ, z[k]);
+		maxX = fmax(maxX, x[k]);
+		maxY = fmax(maxY, y[k]);
+		maxZ = fmax(maxZ, z[k]);
+	}
+	double size = fmax(fmax(maxX - minX, maxY - minY), maxZ - minZ);
+	size = size > 0.0 ? size * (1.0 + 1e-9) : 1.0;
+
+	std::vector<uint32_t> keys(n);
+	const double scale = (1 << mortonBits) / size;
+	parallelFor(n, 4096, [&](int begin, int end) {
+		for (int s = begin; s < end; s++) {
+			int k = sorted[s];
+			uint32_t cx = (uint32_t) ((x[k] - minX) * scale);
+			uint32_t cy = (uint32_t) ((y[k] - minY) * scale);
+			uint32_t cz = (uint32_t) ((z[k] - minZ) * scale);
+			keys[s] = spreadBits(cx) << 2 | spreadBits(cy) << 1 | spreadBits(cz);
+		}
+	});
+
+	// least significant digit radix sort, a byte at a time
+	std::vector<uint32_t> keyScratch(n);
+	std::vector<int> indexScratch(n);
+	for (int shift = 0; shift < 3 * mortonBits; shift += 8) {
+		int offsets[257] = { 0 };
+		for (int s = 0; s < n; s++)
+			offsets[((keys[s] >> shift) & 0xff) + 1]++;
+		for (int d = 0; d < 256; d++)
+			offsets[d + 1] += offsets[d];
+		for (int s = 0; s < n; s++) {
+			int to = offsets[(keys[s] >> shift) & 0xff]++;
+			keyScratch[to] = keys[s];
+			indexScratch[to] = sorted[s];
+		}
+		keys.swap(keyScratch);
+		sorted.swap(indexScratch);
+	}
+	mortonKeys.swap(keys);
+
+	tx.resize(n);
+	ty.resize(n);
+	tz.resize(n);
+	tgm.resize(n);
+	for (int s = 0; s < n; s++) {
+		int k = sorted[s];
+		sortedAt[k] = s;
+		tx[s] = x[k];
+		ty[s] = y[k];
+		tz[s] = z[k];
+		tgm[s] = gm[k];
+	}
+
+	cells.resize(1);
+	buildCell(0, 0, n, 0, minX, minY, minZ, size);
+}
+
+// Fills in cells[index] for the sorted particles begin to end - 1, which
+// share the first level digits of their Morton codes.
+void Gravity::buildCell(int index, int begin, int end, int level,
+		double minX, double minY, double minZ, double size) {
+	Cell cell;
+	cell.minX = minX;
+	cell.minY = minY;
+	cell.minZ = minZ;
+	cell.size = size;
+	cell.begin = begin;
+	cell.end = end;
+	cell.firstChild = -1;
+	cell.childCount = 0;
+	cell.cx = cell.cy = cell.cz = cell.gm = 0.0;
+
+	if (end - begin <= leafSize || level == mortonBits) {
+		for (int s = begin; s < end; s++) {
+			cell.gm += tgm[s];
+			cell.cx += tgm[s] * tx[s];
+			cell.cy += tgm[s] * ty[s];
+			cell.cz += tgm[s] * tz[s];
+		}
+	} else {
+		// the children are the runs of equal digits at this level
+		const int shift = 3 * (mortonBits - 1 - level);
+		int starts[9], digits[8];
+		for (int s = begin; s < end; s++) {
+			int digit = (mortonKeys[s] >> shift) & 7;
+			if (cell.childCount == 0 || digit != digits[cell.childCount - 1]) {
+				starts[cell.childCount] = s;
+				digits[cell.childCount++] = digit;
+			}
+		}
+		starts[cell.childCount] = end;
+
+		cell.firstChild = (int) cells.size();
+		cells.resize(cells.size() + cell.childCount);
+		const double half = size * 0.5;
+		for (int c = 0; c < cell.childCount; c++) {
+			int child = cell.firstChild + c;
+			buildCell(child, starts[c], starts[c + 1], level + 1,
+					minX + (digits[c] & 4 ? half : 0.0),
+					minY + (digits[c] & 2 ? half : 0.0),
+					minZ + (digits[c] & 1 ? half : 0.0), half);
+			const Cell &built = cells[child];
+			cell.gm += built.gm;
+			cell.cx += built.gm * built.cx;
+			cell.cy += built.gm * built.cy;
+			cell.cz += built.gm * built.cz;
+		}
+	}
+	if (cell.gm > 0.0) {
+		cell.cx /= cell.gm;
+		cell.cy /= cell.gm;
+		cell.cz /= cell.gm;
+	}
+	cells[index] = cell;
+}
+
+void Gravity::accelerationAt(double px, double py, double pz, int self,
+		double *accX, double *accY, double *accZ) const {
+	const double theta2 = theta * theta;
+	double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+	// at most 8 children for each of the mortonBits + 1 levels
+	int stack[8 * (mortonBits + 1)];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Cell &cell = cells[stack[--top]];
+		double dx = cell.cx - px, dy = cell.cy - py, dz = cell.cz - pz;
+		double d2 = dx * dx + dy * dy + dz * dz;
+		bool inside = px >= cell.minX && px < cell.minX + cell.size
+				&& py >= cell.minY && py < cell.minY + cell.size
+				&& pz >= cell.minZ && pz < cell.minZ + cell.size;
+		if (!inside && cell.size * cell.size < theta2 * d2) {
+			// far enough to count as one mass at its centre
+			double r2 = d2 + softening2;
+			double f = cell.gm / (r2 * sqrt(r2));
+			sumX += f * dx;
+			sumY += f * dy;
+			sumZ += f * dz;
+		} else if (cell.childCount == 0) {
+			for (int s = cell.begin; s < cell.end; s++) {
+				if (s == self)
+					continue;
+				double ex = tx[s] - px, ey = ty[s] - py, ez = tz[s] - pz;
+				double r2 = ex * ex + ey * ey + ez * ez + softening2;
+				double f = tgm[s] / (r2 * sqrt(r2));
+				sumX += f * ex;
+				sumY += f * ey;
+				sumZ += f * ez;
+			}
+		} else {
+			for (int c = 0; c < cell.childCount; c++)
+				stack[top++] = cell.firstChild + c;
+		}
+	}
+	*accX = sumX;
+	*accY = sumY;
+	*accZ = sumZ;
+}
+
+void Gravity::computeAccelerations() {
+	buildTree();
+	if (cells.empty()) {
+		ax.assign(count, 0.0);
+		ay.assign(count, 0.0);
+		az.assign(count, 0.0);
+		return;
+	}
+	// walks differ in length, which the work stealing evens out; the
+	// particles in the tree go in Morton order, so that neighbouring walks
+	// touch the same cells
+	const int n = (int) sorted.size();
+	parallelFor(count, 256, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int k = i < n ? sorted[i] : massless[i - n];
+			accelerationAt(x[k], y[k], z[k], sortedAt[k], &ax[k], &ay[k],
+					&az[k]);
+		}
+	});
+}
+
+void Gravity::advanceTo(double days) {
+	double total = days - time;
+	if (total == 0.0)
+		return;
+	int steps = (int) ceil(fabs(total) / maxStep);
+	double h = total / steps;
+	for (int step = 0; step < steps; step++) {
+		// kick, drift, kick
+		for (int k = 0; k < count; k++) {
+			vx[k] += 0.5 * h * ax[k];
+			vy[k] += 0.5 * h * ay[k];
+			vz[k] += 0.5 * h * az[k];
+			x[k] += h * vx[k];
+			y[k] += h * vy[k];
+			z[k] += h * vz[k];
+		}
+		computeAccelerations();
+		for (int k = 0; k < count; k++) {
+			vx[k] += 0.5 * h * ax[k];
+			vy[k] += 0.5 * h * ay[k];
+			vz[k] += 0.5 * h * az[k];
+		}
+	}
+	time = days;
+}
+
+void Gravity::writeState(const BodyTable &table, BodyState &state) const {
+	// the bodies left to their orbits, such as moons and Saturn's ring,
+	// keep their place around their parents: children come after their
+	// parents, so going backwards the parents are still where the orbits
+	// put them
+	for (int i = table.count - 1; i >= 0; i--) {
+		int p = table.parent[i];
+		if (particleOf[i] < 0 && p >= 0) {
+			state.x[i] -= state.x[p];
+			state.y[i] -= state.y[p];
+			state.z[i] -= state.z[p];
+		}
+	}
+	for (int i = 0; i < table.count; i++) {
+		int k = particleOf[i];
+		if (k >= 0) {
+			state.x[i] = (float) x[k];
+			state.y[i] = (float) y[k];
+			state.z[i] = (float) z[k];
+		} else if (table.parent[i] >= 0) {
+			int p = table.parent[i];
+			state.x[i] += state.x[p];
+			state.y[i] += state.y[p];
+			state.z[i] += state.z[p];
+		}
+	}
+
+	const int first = count - (int) swarmA.size();
+	state.points.resize(3 * swarmA.size());
+	for (int k = first; k < count; k++) {
+		state.points[3 * (k - first)] = (float) x[k];
+		state.points[3 * (k - first) + 1] = (float) y[k];
+		state.points[3 * (k - first) + 2] = (float) z[k];
+	}
+}
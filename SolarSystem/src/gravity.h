@@ -0,0 +1,91 @@
+/* Optional N-body gravity.
+ *
+ * With gravity on, the orbits of the body table only give the starting
+ * positions and velocities. From there the bodies with mass, the bodies on
+ * an orbit and an optional swarm of asteroids and comets all move under
+ * their mutual attraction, bar the moons: the scene's distances are not to
+ * scale, so the masses could not hold them, and they keep to their orbits
+ * around wherever their planets go. The motion is integrated with
+ * kick-drift-kick leapfrog, which is symplectic and time-reversible: the
+ * energy error stays bounded, and running the clock backwards retraces the
+ * motion.
+ *
+ * Accelerations come from a Barnes-Hut octree over the particles with
+ * mass, rebuilt every step: the particles are sorted by Morton code, the
+ * tree is cut from the sorted order, and each particle walks it, opening
+ * the cells that look larger than theta from where it is. The walks run in
+ * parallel on the worker pool.
+ *
+ * Units are scene units and days. The Sun's gravitational parameter
+ * follows from the Earth going round once a year at distance 5.
+ */
+
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+class Gravity {
+public:
+	// Simulates the table's bodies, which must outlive this, plus swarm
+	// small bodies generated from seed. theta is the opening angle of the
+	// tree walk; steps are at most maxStep days long.
+	Gravity(const BodyTable &table, int swarm, unsigned seed, double theta,
+			double maxStep);
+
+	// Puts every particle back on its orbit at days since J2000.
+	void reset(double days);
+
+	// Integrates from the current time to days, which may be earlier.
+	void advanceTo(double days);
+
+	// Overwrites the positions of the simulated bodies in state, moves the
+	// moons and other bodies on them along, and writes the swarm as points.
+	void writeState(const BodyTable &table, BodyState &state) const;
+
+private:
+	// One octree cell. Inner cells hold childCount children from
+	// firstChild on; leaves hold the sorted particles begin to end - 1.
+	struct Cell {
+		double cx, cy, cz, gm;        // centre of mass and total mass
+		double minX, minY, minZ, size; // the cube the cell covers
+		int firstChild, childCount;
+		int begin, end;
+	};
+
+	void buildTree();
+	void buildCell(int index, int begin, int end, int level, double minX,
+			double minY, double minZ, double size);
+	void computeAccelerations();
+	void accelerationAt(double px, double py, double pz, int self,
+			double *ax, double *ay, double *az) const;
+
+	const BodyTable &table;
+	const double theta, maxStep;
+	double time;
+
+	// Particles: the simulated table bodies first, then the swarm.
+	int count;
+	std::vector<int> bodyOf;     // table row of each particle, -1 in the swarm
+	std::vector<int> particleOf; // particle of each table row, or -1
+	std::vector<double> x, y, z, vx, vy, vz, ax, ay, az;
+	std::vector<double> gm;      // gravitational parameter, units^3 / day^2
+	int root;                    // particle the swarm orbits
+
+	// the swarm's orbits, in degrees as in the table
+	std::vector<double> swarmA, swarmE, swarmI, swarmNode, swarmPeri,
+			swarmAnomaly;
+
+	// the tree, over the particles with mass sorted by Morton code
+	std::vector<Cell> cells;
+	std::vector<int> sorted;     // particle at each sorted position
+	std::vector<int> sortedAt;   // sorted position of each particle, or -1
+	std::vector<int> massless;   // the particles left out of the tree
+	std::vector<uint32_t> mortonKeys;
+	std::vector<double> tx, ty, tz, tgm;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/* Offscreen OpenGL contexts for machines without a display server. */
+
+#include "headless.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <stdio.h>
+#include <string.h>
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLSurface eglSurface = EGL_NO_SURFACE;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+
+static EGLDisplay openDisplay() {
+	const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions != NULL
+			&& strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+				(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+						"eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != NULL) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+					EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool createHeadlessContext(int width, int height, bool core) {
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	const EGLint surfaceAttribs[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+	const EGLint coreAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+		EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+
+	eglDisplay = openDisplay();
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL)) {
+		printf("Cannot open an EGL display\n");
+		return false;
+	}
+	if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configCount)
+			|| configCount == 0) {
+		printf("No EGL config with an OpenGL pbuffer\n");
+		destroyHeadlessContext();
+		return false;
+	}
+	eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttribs);
+	if (eglSurface == EGL_NO_SURFACE) {
+		printf("Cannot create a %d x %d pbuffer\n", width, height);
+		destroyHeadlessContext();
+		return false;
+	}
+	// the fixed-function renderer needs the compatibility profile
+	eglBindAPI(EGL_OPENGL_API);
+	eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT,
+			core ? coreAttribs : NULL);
+	if (eglContext == EGL_NO_CONTEXT
+			|| !eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+		printf("Cannot create an OpenGL %scontext\n",
+				core ? "3.3 core profile " : "");
+		destroyHeadlessContext();
+		return false;
+	}
+	printf("Rendering headless on %s\n", glGetString(GL_RENDERER));
+	return true;
+}
+
+void destroyHeadlessContext() {
+	if (eglDisplay == EGL_NO_DISPLAY)
+		return;
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (eglContext != EGL_NO_CONTEXT)
+		eglDestroyContext(eglDisplay, eglContext);
+	if (eglSurface != EGL_NO_SURFACE)
+		eglDestroySurface(eglDisplay, eglSurface);
+	eglTerminate(eglDisplay);
+	eglDisplay = EGL_NO_DISPLAY;
+	eglSurface = EGL_NO_SURFACE;
+	eglContext = EGL_NO_CONTEXT;
+}
+
+void presentHeadlessFrame(bool finish) {
+	eglSwapBuffers(eglDisplay, eglSurface);
+	if (finish)
+		glFinish();
+}
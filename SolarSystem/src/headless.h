@@ -0,0 +1,17 @@
+/* Offscreen OpenGL contexts for machines without a display server. */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Creates a context drawing into a width x height pbuffer and makes it
+// current: an OpenGL 3.3 core profile one if core is set, otherwise a
+// compatibility one. Uses Mesa's surfaceless EGL platform when available,
+// so it works on render nodes without X or a GPU (llvmpipe).
+bool createHeadlessContext(int width, int height, bool core = false);
+
+void destroyHeadlessContext();
+
+// Swaps the pbuffer, and with finish waits until the frame is finished.
+void presentHeadlessFrame(bool finish = true);
+
+#endif
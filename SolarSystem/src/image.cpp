@@ -0,0 +1,186 @@
+/* 24-bit BMP loading. */
+
+#include "image.h"
+
+#include <stdio.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// BMP files are designed for Little Endian CPUs like the Intel x86 series,
+// so multi-byte header fields are assembled byte by byte to read correctly
+// on Big Endian CPUs as well.
+static unsigned int readInt(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned short readShort(const unsigned char *p) {
+	return (unsigned short) (p[0] | (p[1] << 8));
+}
+
+void ImageFree(Image *image) {
+	unmapFile(&image->file);
+	image->data = NULL;
+}
+
+static void swizzleScalar(GLubyte *p, size_t count) {
+	for (size_t i = 0; i < count; i++, p += 3) {
+		GLubyte temp = p[0];
+		p[0] = p[2];
+		p[2] = temp;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+// Swaps the outer bytes of the five pixels in each 16-byte lane and
+// leaves byte 15 alone.
+#define SWIZZLE_LANE 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15
+
+// 5 pixels per 16-byte load. Each store rewrites byte 15 unchanged, and
+// the next load starts on it.
+__attribute__((target("ssse3")))
+static size_t swizzleSSSE3(GLubyte *p, size_t count) {
+	const __m128i mask = _mm_setr_epi8(SWIZZLE_LANE);
+	size_t done = 0;
+	for (; (count - done) * 3 >= 16; done += 5, p += 15) {
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		_mm_storeu_si128((__m128i *) p, _mm_shuffle_epi8(v, mask));
+	}
+	return done;
+}
+
+// 9 pixels per 32-byte load. vpshufb cannot cross the 128-bit lanes, so
+// the upper lane is first moved to start at byte 12 (pixel 4), shuffled
+// like the lower one and moved back; the bytes past pixel 8 are restored
+// from the load.
+__attribute__((target("avx2")))
+static size_t swizzleAVX2(GLubyte *p, size_t count) {
+	const __m256i mask = _mm256_setr_epi8(SWIZZLE_LANE, SWIZZLE_LANE);
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	size_t done = 0;
+	for (; (count - done) * 3 >= 32; done += 9, p += 27) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		__m256i s = _mm256_permutevar8x32_epi32(v, spread);
+		s = _mm256_shuffle_epi8(s, mask);
+		s = _mm256_permutevar8x32_epi32(s, gather);
+		s = _mm256_blend_epi32(s, v, 0x80);
+		_mm256_storeu_si256((__m256i *) p, s);
+	}
+	return done;
+}
+#endif
+
+void swizzleBGR(GLubyte *pixels, size_t count) {
+	size_t done = 0;
+#ifdef HAVE_X86_SIMD
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	static const bool ssse3 = __builtin_cpu_supports("ssse3");
+	if (avx2)
+		done = swizzleAVX2(pixels, count);
+	if (ssse3)
+		done += swizzleSSSE3(pixels + done * 3, count - done);
+#endif
+	swizzleScalar(pixels + done * 3, count - done);
+}
+
+// Checks the headers of a mapped bitmap and finds its size and where its
+// pixels start.
+static bool readHeader(const char *filename, const MappedFile &file,
+		int *width, int *height, unsigned int *offset) {
+	const unsigned char *header = (const unsigned char *) file.data;
+	size_t size = file.size;   // size of the file
+	unsigned short planes;     // number of planes in image (must be 1)
+	unsigned short bpp;        // number of bits per pixel (must be 24)
+	unsigned int compression;  // must be 0 (uncompressed)
+	size_t stride;             // bytes per row, padded to 4
+
+	// file header (14 bytes) and the start of the info header (40 bytes)
+	if (size < 54 || header[0] != 'B' || header[1] != 'M') {
+		printf("%s is not a bitmap\n", filename);
+		return false;
+	}
+	*offset = readInt(header + 10);
+	*width = (int) readInt(header + 18);
+	*height = (int) readInt(header + 22);
+	planes = readShort(header + 26);
+	bpp = readShort(header + 28);
+	compression = readInt(header + 30);
+
+	if (planes != 1) {
+		printf("Planes from %s is not 1: %u\n", filename, planes);
+		return false;
+	}
+	if (bpp != 24 || compression != 0) {
+		printf("Bpp from %s is not 24: %u\n", filename, bpp);
+		return false;
+	}
+	// a negative height marks a top-down bitmap, which would have to be
+	// flipped for OpenGL
+	if (*width <= 0 || *height <= 0 || *width > 65536 || *height > 65536) {
+		printf("Unsupported size of %s: %d x %d\n", filename, *width, *height);
+		return false;
+	}
+
+	// BMP lines are padded to the nearest double word boundary, which
+	// matches GL_UNPACK_ALIGNMENT 4.
+	stride = ((size_t) *width * 3 + 3) & ~(size_t) 3;
+	if (*offset < 54 || *offset > size
+			|| (size - *offset) / stride < (size_t) *height) {
+		printf("Error reading image data from %s.\n", filename);
+		return false;
+	}
+	return true;
+}
+
+bool ImageReadSize(const char *filename, unsigned long *sizeX,
+		unsigned long *sizeY) {
+	MappedFile file;
+	int width, height;
+	unsigned int offset;
+
+	// mapped without reading ahead, so only the header pages are read
+	if (!mapFile(filename, &file, false)) {
+		printf("File Not Found : %s\n", filename);
+		return false;
+	}
+	bool ok = readHeader(filename, file, &width, &height, &offset);
+	unmapFile(&file);
+	*sizeX = ok ? width : 0;
+	*sizeY = ok ? height : 0;
+	return ok;
+}
+
+bool ImageLoad(const char *filename, Image *image, bool keepBGR) {
+	int width, height;
+	unsigned int offset;         // start of the pixel array
+
+	image->data = NULL;
+
+	// make sure the file is there. Read it in now, on the loading thread,
+	// rather than during the upload on the GL thread.
+	if (!mapFile(filename, &image->file, true, !keepBGR)) {
+		printf("File Not Found : %s\n", filename);
+		return false;
+	}
+	if (!readHeader(filename, image->file, &width, &height, &offset)) {
+		ImageFree(image);
+		return false;
+	}
+
+	size_t stride = ((size_t) width * 3 + 3) & ~(size_t) 3;
+	image->sizeX = width;
+	image->sizeY = height;
+	image->data = (GLubyte *) image->file.data + offset;
+	image->format = GL_BGR;
+	if (!keepBGR) {
+		// reverse all of the colors (bgr -> rgb), one line at a time so
+		// the padding at the end of each line is left alone
+		for (int j = 0; j < height; j++)
+			swizzleBGR(image->data + j * stride, width);
+		image->format = GL_RGB;
+	}
+	return true;
+}
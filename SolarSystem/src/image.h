@@ -0,0 +1,44 @@
+/* 24-bit BMP loading. */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <GL/gl.h>
+#include <stddef.h>
+
+#include "mappedfile.h"
+
+#ifndef GL_BGR
+#define GL_BGR 0x80E0
+#endif
+
+struct Image {
+	unsigned long sizeX;
+	unsigned long sizeY;
+	GLubyte *data;     // bottom row first, rows padded to 4 bytes
+	GLenum format;     // GL_RGB, or GL_BGR when the swizzle was skipped
+
+	// storage behind data, released by ImageFree
+	MappedFile file;
+};
+
+// quick and dirty bitmap loader...for 24 bit uncompressed bitmaps with 1
+// plane only. The file is mapped into memory and data points straight at
+// its pixel array. With keepBGR the pixels are left in file order and the
+// mapping read-only, so the file is never copied; otherwise every row is
+// swizzled to RGB in place.
+bool ImageLoad(const char *filename, Image *image, bool keepBGR = false);
+
+// Reads only the size of a bitmap that ImageLoad would accept, without
+// reading its pixels in.
+bool ImageReadSize(const char *filename, unsigned long *sizeX,
+		unsigned long *sizeY);
+
+// Releases the storage of an image filled in by ImageLoad.
+void ImageFree(Image *image);
+
+// Swaps the first and third byte of count 3-byte pixels in place, using
+// AVX2 or SSSE3 shuffles when the CPU has them.
+void swizzleBGR(GLubyte *pixels, size_t count);
+
+#endif
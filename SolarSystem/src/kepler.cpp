@@ -0,0 +1,205 @@
+/* Batch solver for Keplerian orbits. */
+
+#include "kepler.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#endif
+
+void orbitAxes(double inclination, double node, double periapsis, double p[3],
+		double q[3]) {
+	const double radians = M_PI / 180.0;
+	double ci = cos(inclination * radians), si = sin(inclination * radians);
+	double cn = cos(node * radians), sn = sin(node * radians);
+	double cw = cos(periapsis * radians), sw = sin(periapsis * radians);
+
+	// ecliptic (X, Y, Z) is stored as (X, Z, -Y)
+	p[0] = cw * cn - sw * sn * ci;
+	p[1] = sw * si;
+	p[2] = -(cw * sn + sw * cn * ci);
+	q[0] = -sw * cn - cw * sn * ci;
+	q[1] = cw * si;
+	q[2] = -(-sw * sn + cw * cn * ci);
+}
+
+void addKeplerOrbit(KeplerOrbits &orbits, double semiMajorAxis,
+		double eccentricity, double inclination, double node,
+		double periapsis, double meanAnomaly, double periodDays) {
+	double p[3], q[3];
+	orbitAxes(inclination, node, periapsis, p, q);
+	double a = semiMajorAxis;
+	double b = semiMajorAxis * sqrt(1.0 - eccentricity * eccentricity);
+	orbits.px.push_back(a * p[0]);
+	orbits.py.push_back(a * p[1]);
+	orbits.pz.push_back(a * p[2]);
+	orbits.qx.push_back(b * q[0]);
+	orbits.qy.push_back(b * q[1]);
+	orbits.qz.push_back(b * q[2]);
+
+	orbits.meanAnomaly.push_back(meanAnomaly * M_PI / 180.0);
+	orbits.meanMotion.push_back(periodDays > 0.0 ? 2.0 * M_PI / periodDays : 0.0);
+	orbits.eccentricity.push_back(eccentricity);
+}
+
+double solveKepler(double m, double e) {
+	m = remainder(m, 2.0 * M_PI);
+	double E = m + (m < 0.0 ? -0.85 * e : 0.85 * e);
+	for (int iteration = 0; iteration < 64; iteration++) {
+		double step = (E - e * sin(E) - m) / (1.0 - e * cos(E));
+		E -= step;
+		if (fabs(step) < 1e-15)
+			break;
+	}
+	return E;
+}
+
+typedef double double4 __attribute__((vector_size(32)));
+typedef long long long4 __attribute__((vector_size(32)));
+typedef unsigned long long bits4 __attribute__((vector_size(32)));
+typedef float float4 __attribute__((vector_size(16)));
+
+// Adding 1.5 * 2^52 rounds a double below 2^51 to an integer, which then
+// sits in the low bits of the sum.
+static const double roundMagic = 6755399441055744.0;
+
+// sin and cos of x, for |x| up to a few thousand. x is reduced to
+// [-pi/4, pi/4] by Cody and Waite's three-part pi/2, then the Cephes
+// polynomials are evaluated for both and swapped and negated by quadrant.
+static inline __attribute__((always_inline))
+void sincos4(const double4 *x, double4 *sinx, double4 *cosx) {
+	const double4 twoOverPi = *x * (2.0 / M_PI) + roundMagic;
+	const bits4 quadrant = (bits4) twoOverPi;
+	const double4 q = twoOverPi - roundMagic;
+	double4 r = *x - q * 1.57079625129699707031;
+	r = r - q * 7.54978941586159635335e-8;
+	r = r - q * 5.39030285815811905290e-15;
+
+	const double4 r2 = r * r;
+	double4 s = r2 * 1.58962301576546568060e-10 - 2.50507477628578072866e-8;
+	s = s * r2 + 2.75573136213857245213e-6;
+	s = s * r2 - 1.98412698295895385996e-4;
+	s = s * r2 + 8.33333333332211858878e-3;
+	s = s * r2 - 1.66666666666666307295e-1;
+	s = r + r * r2 * s;
+	double4 c = r2 * -1.13585365213876817300e-11 + 2.08757008419747316778e-9;
+	c = c * r2 - 2.75573141792967388112e-7;
+	c = c * r2 + 2.48015872888517045348e-5;
+	c = c * r2 - 1.38888888888730564116e-3;
+	c = c * r2 + 4.16666666666665929218e-2;
+	c = 1.0 - 0.5 * r2 + r2 * r2 * c;
+
+	// quadrants 1 and 3 swap sin and cos; sin is negative in 2 and 3 and
+	// cos in 1 and 2
+	const long4 swap = (quadrant & 1) != 0;
+	const bits4 sinSign = (quadrant & 2) << 62;
+	const bits4 cosSign = ((quadrant + 1) & 2) << 62;
+	*sinx = (double4) ((bits4) (swap ? c : s) ^ sinSign);
+	*cosx = (double4) ((bits4) (swap ? s : c) ^ cosSign);
+}
+
+// Loads lanes elements of values from index o into v; the rest stay as
+// they are.
+static inline __attribute__((always_inline))
+void load4(const std::vector<double> &values, int o, int lanes, double4 *v) {
+	if (lanes == 4)
+		memcpy(v, &values[o], sizeof(double4));
+	else
+		for (int l = 0; l < lanes; l++)
+			(*v)[l] = values[o + l];
+}
+
+// Stores the first lanes elements of v from index o of values.
+static inline __attribute__((always_inline))
+void store4(float *values, int o, int lanes, const float4 *v) {
+	if (lanes == 4)
+		memcpy(&values[o], v, sizeof(float4));
+	else
+		for (int l = 0; l < lanes; l++)
+			values[o + l] = (*v)[l];
+}
+
+// Newton steps stop once every lane moves less than this, in radians.
+static const double tolerance = 1e-7;
+// A bound that is only reached for eccentricities very close to 1.
+static const int maxIterations = 32;
+
+static inline __attribute__((always_inline))
+void solveRange(const KeplerOrbits &orbits, double days, int begin, int end,
+		float *x, float *y, float *z) {
+	const int count = end - begin;
+	for (int i = 0; i < count; i += 4) {
+		const int lanes = count - i < 4 ? count - i : 4;
+		const int o = begin + i;
+		// the missing lanes of the last block stay circular and at rest
+		double4 m0 = { 0, 0, 0, 0 }, n = m0, e = m0;
+		load4(orbits.meanAnomaly, o, lanes, &m0);
+		load4(orbits.meanMotion, o, lanes, &n);
+		load4(orbits.eccentricity, o, lanes, &e);
+
+		// mean anomaly in [-pi, pi], reduced by a two-part 2 pi
+		double4 m = m0 + n * days;
+		const double4 k = (m * (0.5 / M_PI) + roundMagic) - roundMagic;
+		m = m - k * 6.28318530717958623200;
+		m = m - k * 2.44929359829470635445e-16;
+
+		// Danby's starting guess converges for every e < 1
+		double4 E = m + (m < 0.0 ? -0.85 * e : 0.85 * e);
+		double4 sinE, cosE;
+		for (int iteration = 0; iteration < maxIterations; iteration++) {
+			sincos4(&E, &sinE, &cosE);
+			// Halley's correction to the Newton step, for cubic convergence
+			const double4 f = E - e * sinE - m;
+			const double4 slope = 1.0 - e * cosE;
+			const double4 step = f * slope / (slope * slope - 0.5 * f * e * sinE);
+			E = E - step;
+			const long4 moving = step > tolerance || step < -tolerance;
+			if ((moving[0] | moving[1] | moving[2] | moving[3]) == 0)
+				break;
+		}
+		sincos4(&E, &sinE, &cosE);
+
+		const double4 u = cosE - e, v = sinE;
+		double4 p = { 0, 0, 0, 0 }, q = p;
+		load4(orbits.px, o, lanes, &p);
+		load4(orbits.qx, o, lanes, &q);
+		float4 f = __builtin_convertvector(u * p + v * q, float4);
+		store4(x, i, lanes, &f);
+		load4(orbits.py, o, lanes, &p);
+		load4(orbits.qy, o, lanes, &q);
+		f = __builtin_convertvector(u * p + v * q, float4);
+		store4(y, i, lanes, &f);
+		load4(orbits.pz, o, lanes, &p);
+		load4(orbits.qz, o, lanes, &q);
+		f = __builtin_convertvector(u * p + v * q, float4);
+		store4(z, i, lanes, &f);
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2,fma")))
+static void solveAVX2(const KeplerOrbits &orbits, double days, int begin,
+		int end, float *x, float *y, float *z) {
+	solveRange(orbits, days, begin, end, x, y, z);
+}
+#endif
+
+static void solveGeneric(const KeplerOrbits &orbits, double days, int begin,
+		int end, float *x, float *y, float *z) {
+	solveRange(orbits, days, begin, end, x, y, z);
+}
+
+void solveKeplerOrbits(const KeplerOrbits &orbits, double days, int begin,
+		int end, float *x, float *y, float *z) {
+#ifdef HAVE_X86_SIMD
+	static const bool avx2 = __builtin_cpu_supports("avx2")
+			&& __builtin_cpu_supports("fma");
+	if (avx2) {
+		solveAVX2(orbits, days, begin, end, x, y, z);
+		return;
+	}
+#endif
+	solveGeneric(orbits, days, begin, end, x, y, z);
+}
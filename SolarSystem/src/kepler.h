@@ -0,0 +1,50 @@
+/* Batch solver for Keplerian orbits.
+ *
+ * Each orbit is an ellipse fixed in space, given by its classical elements
+ * at J2000. A position comes from solving Kepler's equation M = E - e sin E
+ * for the eccentric anomaly E by Newton's method. The solver works on four
+ * orbits at a time in double precision, with GCC vector extensions, and on
+ * AVX2 machines in 256-bit registers.
+ */
+
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <vector>
+
+// One array per element, indexed by orbit.
+struct KeplerOrbits {
+	std::vector<double> meanAnomaly;    // radians at J2000
+	std::vector<double> meanMotion;     // radians per day
+	std::vector<double> eccentricity;
+	// The perifocal axes scaled by the semi-axes, in scene coordinates, so
+	// that the position is (cos E - e) p + sin E q.
+	std::vector<double> px, py, pz;
+	std::vector<double> qx, qy, qz;
+};
+
+// Appends an orbit. Angles are in degrees: inclination to the ecliptic,
+// longitude of the ascending node, argument of periapsis and mean anomaly
+// at J2000. A period of 0 keeps the body at its starting point.
+// Ecliptic x, y and z (north) become scene x, -z and y, so orbits run
+// anticlockwise seen from above as they always have.
+void addKeplerOrbit(KeplerOrbits &orbits, double semiMajorAxis,
+		double eccentricity, double inclination, double node,
+		double periapsis, double meanAnomaly, double periodDays);
+
+// Unit vectors from the focus towards periapsis (p) and towards the point a
+// quarter turn further on (q), in scene coordinates, for angles in degrees.
+void orbitAxes(double inclination, double node, double periapsis, double p[3],
+		double q[3]);
+
+// Solves Kepler's equation for one orbit: the eccentric anomaly for mean
+// anomaly m, in radians, and eccentricity e below 1.
+double solveKepler(double m, double e);
+
+// Writes the positions of orbits begin to end - 1 at days since J2000,
+// relative to the focus, into x, y and z from index 0 on. Eccentricities
+// must be below 1.
+void solveKeplerOrbits(const KeplerOrbits &orbits, double days, int begin,
+		int end, float *x, float *y, float *z);
+
+#endif
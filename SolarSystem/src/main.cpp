@@ -2,21 +2,108 @@
  * around the sun.
  */
 
-#include <GL/glut.h>
+#include <GL/freeglut.h>
 #include <GL/glu.h>
 #include <GL/gl.h>
-#include <windows.h>
+#include "bodies.h"
+#include "bvh.h"
+#include "camera.h"
+#include "capture.h"
+#include "corerenderer.h"
+#include "ephemeris.h"
+#include "frustum.h"
+#include "glstate.h"
+#include "gravity.h"
+#include "headless.h"
+#include "mesh.h"
+#include "options.h"
+#include "profile.h"
+#include "renderqueue.h"
+#include "scenegraph.h"
+#include "simulation.h"
+#include "starfield.h"
+#include "textures.h"
+#include "trails.h"
+#include "views.h"
+#include <cfloat>
+#include <chrono>
 #include <stdio.h>
 #include <cmath>
 #include <iostream>
 #include <stdlib.h>
-
-GLuint sunTex, starTex, mercuryTex, venusTex, earthTex, marsTex, jupiterTex,
-		ringOfSaturnTex, saturnTex, uranusTex, neptuneTex;
-
-float eyeX = 10, eyeY = 12, eyeZ = 13;
-float centerX = 0, centerY = 0, centerZ = 0;
-float upX = 0, upY = 7, upZ = 0;
+#include <string>
+#include <unistd.h>
+
+// Every body in the scene; see bodies.cfg.
+BodyTable bodies;
+// Body positions fitted to a table, used where they cover the time.
+static Ephemeris ephemeris;
+// Steps the bodies at a fixed rate, and the state the next frame draws.
+Simulation *simulation;
+BodyState frameState;
+// Days since J2000 that frameState stands for.
+double frameDays = 0.0;
+// Draws with shaders instead of the fixed-function pipeline, if the
+// context is a core profile one; see --renderer.
+static CoreRenderer coreRenderer;
+static bool useCore = false;
+
+// Debug overlay showing the tessellation of every body; toggled with 'f'.
+bool showWireframe = false;
+// Per-frame submission counts on stdout; toggled with 'i'.
+bool showFrameStats = false;
+// Culling and level of detail; toggled with 'l'.
+bool useLod = true;
+// Trails behind the bodies and their orbits, built when first shown;
+// toggled with 't' and 'o'.
+static TrailBuffer trails;
+static OrbitPaths orbitPaths;
+bool showTrails = false;
+bool showOrbits = false;
+// Bodies that appear smaller than this radius in pixels are drawn as points.
+static const float pointPixels = 1.0f;
+// What the fixed-function pipeline draws of a view this frame: its meshes,
+// sorted by state, and the positions and colours of the bodies it shows as
+// points.
+struct ViewPass {
+	Matrix4 view;
+	Frustum frustum;
+	RenderQueue queue;
+	std::vector<GLfloat> points, colors;
+};
+static std::vector<ViewPass> viewPasses;
+// Every body's model matrix, shared by the views.
+static std::vector<Matrix4> worldTransforms;
+// The belts and free particles, uploaded once a frame for every view.
+static PointBuffer beltPoints = { 0, 0, false },
+		particlePoints = { 0, 0, false };
+static unsigned long frameCount = 0;
+// The background stars.
+static StarField starField;
+// Fills the texture atlas a little every frame.
+static TextureStreamer textureStreamer;
+// Benchmark stage each body is charged to.
+static std::vector<FrameStage> bodyStage;
+
+Options options;
+
+Camera camera = { 10, 12, 13, 0, 0, 0, 0, 7, 0 };
+// The cameras of the split screen, shown instead of camera while
+// splitScreen is set; toggled with 'v'.
+static std::vector<Camera> viewCameras;
+static bool splitScreen = false;
+// The size of the window, and the views drawn into it this frame.
+static int windowWidth = 1, windowHeight = 1;
+static std::vector<View> frameViews;
+
+// The bodies and belt bodies of frameState, for picking them with the
+// mouse; refit every frame in the window.
+static Bvh bodyBvh;
+// How far from the pointer, in pixels, a body is still picked.
+static const double pickPixels = 4.0;
+// The bodies listed around a picked one, and the distance counted within.
+static const int pickNeighbours = 4;
+static const double pickRadius = 1.0;
 
 void usage() {
 	std::cout
@@ -24,884 +111,625 @@ void usage() {
 		a,A: Parallel Orthographic Front View\n\
 		d,D: Parallel Orthographic Side View\n\
 		w,W: Parallel Orthographic Top View\n\
-		s,S: Perspective Views\n";
+		s,S: Perspective Views\n\
+		f,F: Toggle Wireframe Overlay\n\
+		i,I: Toggle Per-Frame Draw Statistics\n\
+		l,L: Toggle Culling and Level of Detail\n\
+		v,V: Toggle the Split-Screen Views\n\
+		t,T: Toggle the Trails\n\
+		o,O: Toggle the Orbits\n\
+		space: Pause or Resume Time\n\
+		r,R: Reverse Time\n\
+		+,-: Speed Time Up or Down Tenfold\n\
+		j,J: Jump Back to the Start Date\n\
+		left click: Select a Body and List What Is Near It\n";
 	std::cout.flush();
 }
 
-struct Image {
-	unsigned long sizeX;
-	unsigned long sizeY;
-	GLubyte *data;
-};
-
-// getint and getshort are helper functions to load larger data types
-// in Big Endian CPUs such as those in older Mac (PowerPC) or Solaris
-// (SPARC) workstations. They are needed because BMP files are
-// designed for Little Endian CPUs like the Intel x86 series.
-//
-// Originally from the Xv bmp loader.
-
-// Ensure that Little Endian ints are read into memory correctly on Big Endian platforms
-static unsigned int getint(FILE *fp) {
-	unsigned int c, c1, c2, c3;
-	c = ((unsigned int) getc(fp));  // get 4 bytes
-	c1 = ((unsigned int) getc(fp)) << 8;
-	c2 = ((unsigned int) getc(fp)) << 16;
-	c3 = ((unsigned int) getc(fp)) << 24;
-	return c | c1 | c2 | c3;
-}
-
-// Ensure that Little Endian shorts are read into memory correctly on Big Endian platforms
-static unsigned short getshort(FILE* fp) {
-	unsigned short c, c1;
-	//get 2 bytes
-	c = ((unsigned short) getc(fp));
-	c1 = ((unsigned short) getc(fp)) << 8;
-	return c | c1;
-}
-
-// quick and dirty bitmap loader...for 24 bit bitmaps with 1 plane only.
-bool ImageLoad(char *filename, Image *image) {
-	FILE *file;
-	unsigned long size;          // size of the image in bytes.
-	size_t i, j, k, linediff;		// standard counter.
-	unsigned short int planes;   // number of planes in image (must be 1)
-	unsigned short int bpp;      // number of bits per pixel (must be 24)
-	char temp;                   // temporary storage for bgr-rgb conversion.
-
-	// make sure the file is there.
-	if ((file = fopen(filename, "rb")) == NULL) {
-		printf("File Not Found : %s\n", filename);
-		return false;
-	}
-
-	// seek through the bmp header, up to the width/height:
-	fseek(file, 18, SEEK_CUR);
-
-	// read the width
-	image->sizeX = getint(file);
-	printf("Width of %s: %lu\n", filename, image->sizeX);
-
-	// read the height
-	image->sizeY = getint(file);
-	printf("Height of %s: %lu\n", filename, image->sizeY);
-
-	// calculate the size (assuming 24 bits or 3 bytes per pixel).
-	// BMP lines are padded to the nearest double word boundary.
-	// fortunat
-	size = 4.0 * ceil(image->sizeX * 24.0 / 32.0) * image->sizeY;
-
-	// read the planes
-	planes = getshort(file);
-	if (planes != 1) {
-		printf("Planes from %s is not 1: %u\n", filename, planes);
-		return false;
-	}
-
-	// read the bpp
-	bpp = getshort(file);
-	if (bpp != 24) {
-		printf("Bpp from %s is not 24: %u\n", filename, bpp);
-		return 0;
-	}
-
-	// seek past the rest of the bitmap header.
-	fseek(file, 24, SEEK_CUR);
-
-	// allocate space for the data.
-	image->data = new GLubyte[size];
-	if (image->data == NULL) {
-		printf("Error allocating memory for color-corrected image data");
-		return false;
+// Sets initial parameters and assumes no defaults.
+void InitGL(int Width, int Height) {
+	// only the texture sizes are read here; update streams the rest in
+	textureStreamer.start(bodies, options.packFile,
+			(long) options.textureBudget * 1024);
+	// meshes are tessellated once here and reused by every frame
+	createBodyMeshes(bodies);
+	for (int i = 0; i < bodies.count; i++) {
+		if (bodies.shape[i] == SHAPE_RING)
+			bodyStage.push_back(STAGE_RINGS);
+		else if (bodies.shape[i] == SHAPE_BELT)
+			bodyStage.push_back(STAGE_POINTS);
+		else if (bodies.name[i] == "sun")
+			bodyStage.push_back(STAGE_SUN);
+		else
+			bodyStage.push_back(STAGE_PLANETS);
 	}
-
-	// read the data
-	i = fread(image->data, size, 1, file);
-	if (i != 1) {
-		printf("Error reading image data from %s.\n", filename);
-		return false;
+	createStarField(options.starFile, options.starCount, starField);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClearDepth(1.0);
+	if (useCore) {
+		coreRenderer.upload(bodies, bodyStage, starField);
+		return;
 	}
+	glEnable(GL_TEXTURE_2D);
+	// meshes are unit sized and scaled per body
+	glEnable(GL_RESCALE_NORMAL);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_DEPTH_TEST);
+	glShadeModel(GL_SMOOTH);
 
-	// reverse all of the colors (bgr -> rgb)
-	// calculate distance to 4 byte boundary for each line
-	// if this distance is not 0, then there will be a color reversal error
-	//  unless we correct for the distance on each line.
-	linediff = 4.0 * ceil(image->sizeX * 24.0 / 32.0) - image->sizeX * 3.0;
-	k = 0;
-	for (j = 0; j < image->sizeY; j++) {
-		for (i = 0; i < image->sizeX; i++) {
-			temp = image->data[k];
-			image->data[k] = image->data[k + 2];
-			image->data[k + 2] = temp;
-			k += 3;
-		}
-		k += linediff;
-	}
-	return true;
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glTranslatef(0.0f, 0.0f, -5.0f);
+	// the loaders bound textures and buffers directly
+	glState.invalidate();
 }
 
-// Load Bitmap for Stars and Convert To Textures
-void LoadGLTexturesStars() {
-	// Load Texture
-	Image *imageStars;
-
-	// allocate space for texture
-	imageStars = new Image();
-	if (imageStars == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
+// Draws the bodies of frameState with the fixed-function pipeline, from
+// every view. The bodies are culled against all the views in one pass, and
+// the belts uploaded once for all of them.
+void drawFixedFunction(const std::vector<View> &views) {
+	updateWorldTransforms(bodies, frameState, worldTransforms);
+	viewPasses.resize(views.size());
+	for (size_t v = 0; v < views.size(); v++) {
+		ViewPass &pass = viewPasses[v];
+		pass.view = matrixLookAt(views[v].camera);
+		matrixFrustum(views[v].projection.m, pass.view.m, views[v].height,
+				&pass.frustum);
+		pass.queue.clear();
+		pass.points.clear();
+		pass.colors.clear();
 	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\stars.bmp", imageStars)) {
-		exit(1);
+	for (int i = 0; i < bodies.count; i++) {
+		// belts are drawn with the points below
+		if (bodies.shape[i] == SHAPE_BELT)
+			continue;
+		const float x = frameState.x[i], y = frameState.y[i],
+				z = frameState.z[i];
+		const GLuint texture = bodies.textureReady[i]
+				? bodies.texture[i] : bodies.placeholderTexture[i];
+		for (size_t v = 0; v < viewPasses.size(); v++) {
+			ViewPass &pass = viewPasses[v];
+			float pixels = FLT_MAX;
+			if (useLod) {
+				if (!sphereInFrustum(pass.frustum, x, y, z, bodies.radius[i])) {
+					meshStats.culled++;
+					continue;
+				}
+				pixels = projectedRadius(pass.frustum, x, y, z,
+						bodies.radius[i]);
+				if (pixels < pointPixels) {
+					pass.points.push_back(x);
+					pass.points.push_back(y);
+					pass.points.push_back(z);
+					pass.colors.insert(pass.colors.end(),
+							&bodies.color[3 * i], &bodies.color[3 * i + 3]);
+					meshStats.points++;
+					continue;
+				}
+			}
+			pass.queue.add(bodyStage[i], texture, bodies.textureRect[i],
+					selectMeshLod(bodies.mesh[i], pixels), worldTransforms[i]);
+		}
 	}
+	profileStage(STAGE_POINTS);
+	uploadPoints(beltPoints, frameState.belt.empty() ? NULL
+			: &frameState.belt[0], frameState.belt.size() / 3);
+	uploadPoints(particlePoints, frameState.points.empty() ? NULL
+			: &frameState.points[0], frameState.points.size() / 3);
 
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &starTex);
-	glBindTexture(GL_TEXTURE_2D, starTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageStars->sizeX,      // x size from image
-			imageStars->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageStars->data        // image data itself
-			);
-}
+	GLfloat light_ambient[] = { 10.2, 10.2, 10.2, 11.0 };
+	GLfloat light_position[] = { 0.0, 0.0, 0.0, 0.0 };
 
-void LoadGLTexturesMercury() {
-	// Load Texture
-	Image *imageMercury;
+	glState.lightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
 
-	// allocate space for texture
-	imageMercury = new Image();
-	if (imageMercury == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
+	//enable lighting parameters
+	glState.enable(GL_LIGHT0, true);
+	glState.depthFunc(GL_LESS);
+	glState.enable(GL_DEPTH_TEST, true);
+	glState.enable(GL_LIGHTING, true);
+
+	for (size_t v = 0; v < views.size(); v++) {
+		const View &view = views[v];
+		ViewPass &pass = viewPasses[v];
+		glViewport(view.x, view.y, view.width, view.height);
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		gluPerspective(viewFieldOfView, (GLfloat) view.width
+				/ (GLfloat) view.height, viewNear, viewFar);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(pass.view.m);
+		// transformed by the camera, so set for every view
+		glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+
+		// the stars first, behind everything
+		profileStage(STAGE_STARS);
+		drawStarField(starField);
+		pass.queue.submit(pass.view, showWireframe);
+
+		profileStage(STAGE_POINTS);
+		if (!pass.points.empty())
+			drawPoints(&pass.points[0], pass.points.size() / 3,
+					&pass.colors[0], 2.0f * pointPixels);
+		// every belt in one draw
+		if (beltPoints.count > 0) {
+			glColor3f(0.6f, 0.55f, 0.5f);
+			drawPointBuffer(beltPoints);
+		}
+		if (particlePoints.count > 0) {
+			glColor3f(0.8f, 0.8f, 0.7f);
+			drawPointBuffer(particlePoints);
+		}
 
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\mercury.bmp", imageMercury)) {
-		exit(1);
+		profileStage(STAGE_TRAILS);
+		if (showOrbits)
+			drawOrbitPaths(orbitPaths, frameState, pass.view);
+		if (showTrails)
+			drawTrails(trails);
 	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &mercuryTex);
-	glBindTexture(GL_TEXTURE_2D, mercuryTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageMercury->sizeX,      // x size from image
-			imageMercury->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageMercury->data        // image data itself
-			);
 }
 
-void LoadGLTexturesVenus() {
-	// Load Texture
-	Image *imageVenus;
-
-	// allocate space for texture
-	imageVenus = new Image();
-	if (imageVenus == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\venus.bmp", imageVenus)) {
-		exit(1);
+// Draws the scene into the current buffer.
+void renderFrame() {
+	profileStage(STAGE_SETUP);
+	resetMeshStats();
+	resetGLStateStats();
+	textureStreamer.update(bodies);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (splitScreen)
+		layoutViews(viewCameras, windowWidth, windowHeight, frameViews);
+	else
+		layoutViews(std::vector<Camera>(1, camera), windowWidth, windowHeight,
+				frameViews);
+	if (showTrails) {
+		if (trails.buffer == 0)
+			createTrails(bodies, options.trailLength, trails);
+		recordTrails(trails, frameState, frameDays);
 	}
+	if (showOrbits)
+		updateOrbitPaths(bodies, orbitPaths);
+	if (useCore)
+		// the shaders only know the orbits
+		coreRenderer.draw(&frameViews[0], (int) frameViews.size(), frameDays,
+				frameState, options.gravity || bodies.ephemeris != NULL,
+				useLod, showWireframe, showTrails ? &trails : NULL,
+				showOrbits ? &orbitPaths : NULL);
+	else
+		drawFixedFunction(frameViews);
+
+	profileStage(STAGE_SWAP);
+	glFlush();
 
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &venusTex);
-	glBindTexture(GL_TEXTURE_2D, venusTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageVenus->sizeX,      // x size from image
-			imageVenus->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageVenus->data        // image data itself
-			);
+	frameCount++;
+	if (showFrameStats)
+		printf("frame %lu: %lu draw calls, %lu indices, %lu culled, "
+				"%lu as points, %lu state changes (%lu elided)\n", frameCount,
+				meshStats.drawCalls, meshStats.indices, meshStats.culled,
+				meshStats.points, glStateStats.issued, glStateStats.elided);
 }
 
-// Load Bitmap for Mars And Convert To Textures
-void LoadGLTexturesMars() {
-	// Load Texture
-	Image *imageMars;
-
-	// allocate space for texture
-	imageMars = new Image();
-	if (imageMars == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\mars.bmp", imageMars)) {
-		exit(1);
-	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &marsTex);
-	glBindTexture(GL_TEXTURE_2D, marsTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageMars->sizeX,      // x size from image
-			imageMars->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageMars->data        // image data itself
-			);
+// Draws the bodies where the simulation clock has them right now.
+void display() {
+	profileBeginFrame();
+	if (!options.simThread)
+		simulation->catchUp();
+	frameDays = simulation->interpolate(simulation->blendNow(), frameState);
+	if (bodyBvh.isBuilt())
+		bodyBvh.refit(frameState);
+	else
+		bodyBvh.build(bodies, frameState);
+	renderFrame();
+	glutSwapBuffers();
+	profileEndFrame();
 }
 
-void LoadGLTexturesEarth() {
-	// Load Texture
-	Image *imageEarth;
-
-	// allocate space for texture
-	imageEarth = new Image();
-	if (imageEarth == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\earth.bmp", imageEarth)) {
-		exit(1);
-	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &earthTex);
-	glBindTexture(GL_TEXTURE_2D, earthTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageEarth->sizeX,      // x size from image
-			imageEarth->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageEarth->data        // image data itself
-			);
+// Prints the simulated date and how fast it runs.
+void printClock() {
+	char date[32];
+	formatDate(simulation->time(), date, sizeof(date));
+	printf("%s, time x%g%s\n", date, simulation->timeScale(),
+			simulation->isPaused() ? " (paused)" : "");
 }
 
-void LoadGLTexturesJupiter() {
-	// Load Texture
-	Image *imageJupiter;
-
-	// allocate space for texture
-	imageJupiter = new Image();
-	if (imageJupiter == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\jupiter.bmp", imageJupiter)) {
-		exit(1);
-	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &jupiterTex);
-	glBindTexture(GL_TEXTURE_2D, jupiterTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageJupiter->sizeX,      // x size from image
-			imageJupiter->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageJupiter->data        // image data itself
-			);
+// Moves the time scale to the next power of ten up or down, keeping its
+// sign, within 1x to 1e9x real time.
+double stepTimeScale(double scale, bool faster) {
+	double size = fabs(scale);
+	double power = floor(log10(size) + 1e-9);
+	if (faster)
+		power++;
+	else if (size <= pow(10.0, power) * (1.0 + 1e-9))
+		power--;
+	power = power < 0 ? 0 : power > 9 ? 9 : power;
+	return copysign(pow(10.0, power), scale);
 }
 
-void LoadGLTexturesRingOfSaturn() {
-	// Load Texture
-	Image *imageRingOfSaturn;
-
-	// allocate space for texture
-	imageRingOfSaturn = new Image();
-	if (imageRingOfSaturn == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
+void KeyboardFunc(unsigned char key, int x, int y) {
+	const CameraPreset *preset = cameraPresetForKey(key);
+	if (preset != NULL) {
+		camera = preset->camera;
+		glutPostRedisplay();
+		return;
 	}
 
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\ringOfSaturn.bmp",
-			imageRingOfSaturn)) {
-		exit(1);
+	switch (key) {
+	case 'f':
+	case 'F':
+		showWireframe = !showWireframe;
+		glutPostRedisplay();
+		break;
+	case 'i':
+	case 'I':
+		showFrameStats = !showFrameStats;
+		break;
+	case 'l':
+	case 'L':
+		useLod = !useLod;
+		glutPostRedisplay();
+		break;
+	case 'v':
+	case 'V':
+		splitScreen = !splitScreen;
+		glutPostRedisplay();
+		break;
+	case 't':
+	case 'T':
+		showTrails = !showTrails;
+		// from where the bodies are when they show again
+		clearTrails(trails);
+		break;
+	case 'o':
+	case 'O':
+		showOrbits = !showOrbits;
+		break;
+	case ' ':
+		simulation->setPaused(!simulation->isPaused());
+		printClock();
+		break;
+	case 'r':
+	case 'R':
+		simulation->setTimeScale(-simulation->timeScale());
+		printClock();
+		break;
+	case '+':
+	case '=':
+	case '-':
+		simulation->setTimeScale(
+				stepTimeScale(simulation->timeScale(), key != '-'));
+		printClock();
+		break;
+	case 'j':
+	case 'J':
+		simulation->reset(options.startDays);
+		clearTrails(trails);
+		printClock();
+		break;
 	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &ringOfSaturnTex);
-	glBindTexture(GL_TEXTURE_2D, ringOfSaturnTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageRingOfSaturn->sizeX,      // x size from image
-			imageRingOfSaturn->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageRingOfSaturn->data        // image data itself
-			);
 }
 
-void LoadGLTexturesSaturn() {
-	// Load Texture
-	Image *imageSaturn;
-
-	// allocate space for texture
-	imageSaturn = new Image();
-	if (imageSaturn == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\saturn.bmp", imageSaturn)) {
-		exit(1);
-	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &saturnTex);
-	glBindTexture(GL_TEXTURE_2D, saturnTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageSaturn->sizeX,      // x size from image
-			imageSaturn->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageSaturn->data        // image data itself
-			);
+// The name of an object of bodyBvh: the body's, or the belt's and the
+// number of the belt body in it.
+static std::string objectName(int object) {
+	if (object < bodies.count)
+		return bodies.name[object];
+	const int b = object - bodies.count;
+	for (int i = 0; i < bodies.count; i++)
+		if (b >= bodies.beltFirst[i]
+				&& b < bodies.beltFirst[i] + bodies.beltCount[i])
+			return bodies.name[i] + " #"
+					+ std::to_string(b - bodies.beltFirst[i]);
+	return "?";
 }
 
-void LoadGLTexturesUranus() {
-	// Load Texture
-	Image *imageUranus;
-
-	// allocate space for texture
-	imageUranus = new Image();
-	if (imageUranus == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
+// Selects the body under the pointer and prints the nearest others and
+// how many lie around it.
+void mouse(int button, int state, int x, int y) {
+	if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN)
+		return;
+	// the pixel's centre, from the bottom as GL counts
+	const double px = x + 0.5, py = windowHeight - y - 0.5;
+	int view = viewAt(frameViews, px, py);
+	if (view < 0 || !bodyBvh.isBuilt())
+		return;
+	double origin[3], direction[3], slope;
+	viewRay(frameViews[view], px, py, origin, direction, &slope);
+	double distance;
+	int picked = bodyBvh.pick(origin, direction, pickPixels * slope, &distance);
+	if (picked < 0) {
+		printf("Nothing selected\n");
+		return;
 	}
 
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\uranus.bmp", imageUranus)) {
-		exit(1);
+	double center[3];
+	if (picked < bodies.count) {
+		center[0] = frameState.x[picked];
+		center[1] = frameState.y[picked];
+		center[2] = frameState.z[picked];
+	} else {
+		for (int a = 0; a < 3; a++)
+			center[a] = frameState.belt[3 * (picked - bodies.count) + a];
 	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &uranusTex);
-	glBindTexture(GL_TEXTURE_2D, uranusTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageUranus->sizeX,      // x size from image
-			imageUranus->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageUranus->data        // image data itself
-			);
-}
-
-void LoadGLTexturesNeptune() {
-	// Load Texture
-	Image *imageNeptune;
-
-	// allocate space for texture
-	imageNeptune = new Image();
-	if (imageNeptune == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
+	std::vector<int> found;
+	bodyBvh.nearest(center, pickNeighbours + 1, found);
+	std::string near;
+	for (size_t k = 0; k < found.size(); k++) {
+		if (found[k] == picked)
+			continue;
+		near += (near.empty() ? "" : ", ") + objectName(found[k]);
 	}
-
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\neptune.bmp", imageNeptune)) {
-		exit(1);
-	}
-
-	// Create Texture Name and Bind it as current
-
-	glGenTextures(2, &neptuneTex);
-	glBindTexture(GL_TEXTURE_2D, neptuneTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageNeptune->sizeX,      // x size from image
-			imageNeptune->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageNeptune->data        // image data itself
-			);
+	found.clear();
+	bodyBvh.withinRadius(center, pickRadius, found);
+	printf("Selected %s, %.3g away; nearest %s; %d within %g\n",
+			objectName(picked).c_str(), distance, near.c_str(),
+			(int) found.size() - 1, pickRadius);
 }
 
-// Load Bitmap for Sun And Convert To Textures
-void LoadGLTexturesSun() {
-	// Load Texture
-	Image *imageSun;
-
-	// allocate space for texture
-	imageSun = new Image();
-	if (imageSun == NULL) {
-		printf("Error allocating space for image");
-		exit(0);
-	}
+// Steps run since a batch run started, and the real seconds its frames
+// stand for, with --fps.
+static long batchSteps = 0;
+static double batchSeconds = 0.0;
+
+// Starts a batch run over from the start date.
+void restartBatch() {
+	simulation->reset(options.startDays);
+	clearTrails(trails);
+	batchSteps = 0;
+	batchSeconds = 0.0;
+}
 
-	/*load picture from file
-	 *You have to edit the path to lead to where your desired
-	 *texture is located on your device
-	 */
-	if (!ImageLoad("C:\\Users\\allir\\Desktop\\sun.bmp", imageSun)) {
-		exit(1);
+// Advances a batch run by options.stepsPerFrame steps, or by 1/options.fps
+// real seconds, regardless of the real time they take.
+void advanceFrame() {
+	if (options.fps <= 0.0) {
+		simulation->step(options.stepsPerFrame);
+		frameDays = simulation->interpolate(1.0f, frameState);
+		return;
 	}
-
-	// Create Texture Name and Bind it as current
-	glGenTextures(1, &sunTex);
-	glBindTexture(GL_TEXTURE_2D, sunTex);
-
-	//Set Texture Parameters
-	// scale linearly when image bigger than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// scale linearly when image smaller than texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
-	// Load texture into OpenGL RC
-	glTexImage2D(GL_TEXTURE_2D,     // 2D texture
-			0,                  // level of detail 0 (normal)
-			3,	                // 3 color components
-			imageSun->sizeX,      // x size from image
-			imageSun->sizeY,      // y size from image
-			0,	                // border 0 (normal)
-			GL_RGB,             // rgb color data order
-			GL_UNSIGNED_BYTE,   // color component types
-			imageSun->data        // image data itself
-			);
+	// the steps up to the frame's moment, which is blended between the
+	// last two
+	batchSeconds += 1.0 / options.fps;
+	double position = batchSeconds / simulation->stepSeconds();
+	long due = (long) ceil(position - 1e-6);
+	simulation->step(due - batchSteps);
+	batchSteps = due;
+	float blend = (float) (1.0 - (due - position));
+	frameDays = simulation->interpolate(blend < 0.0f ? 0.0f
+			: blend > 1.0f ? 1.0f : blend, frameState);
 }
 
-// Sets initial parameters and assumes no defaults.
-void InitGL(int Width, int Height) {
-	LoadGLTexturesSun();
-	LoadGLTexturesStars();
-	LoadGLTexturesMercury();
-	LoadGLTexturesVenus();
-	LoadGLTexturesEarth();
-	LoadGLTexturesMars();
-	LoadGLTexturesJupiter();
-	LoadGLTexturesRingOfSaturn();
-	LoadGLTexturesSaturn();
-	LoadGLTexturesUranus();
-	LoadGLTexturesNeptune();
-	glEnable(GL_TEXTURE_2D);
-	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-	glClearDepth(1.0);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_DEPTH_TEST);
-	glShadeModel(GL_SMOOTH);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	glTranslatef(0.0f, 0.0f, -5.0f);
+// Only paces the redraws; the bodies move with the simulation clock.
+void timer(int v) {
+	glutPostRedisplay();
+	glutTimerFunc(1000 / 60, timer, v);
 }
 
-// In the GLUT library someone put the polar regions on the z-axis - yech!!
-// We fixed it so that they are on the y-axis.  We do this by rotating -90
-// degrees about the x-axis which brings (0,0,1) to (0,1,0).
-void myWireSphere(GLfloat radius, int slices, int stacks) {
-	glPushMatrix();
-	glRotatef(-90.0, 1.0, 0.0, 0.0);
-	glutWireSphere(radius, slices, stacks);
+// The views and their projections are laid out again every frame, over the
+// window's size.
+void reshape(GLint w, GLint h) {
+	windowWidth = w > 0 ? w : 1;
+	windowHeight = h > 0 ? h : 1;
 }
 
-static int yearForPlanet = 0, dayForPlanet = 0;
-
-void createPlanet(GLuint texture, double distance, double radius, double year,
-		double day) {
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glRotatef((GLfloat) year, 0.0, 1.0, 0.0);
-	glTranslatef(distance, 0.0, 0.0);
-	glRotatef((GLfloat) day, 0.0, 1.0, 0.0);
-	//draw planet with radius of radius
-	myWireSphere(radius, 15, 15);
+// Whether the shader renderer can draw in the current context; if so
+// selects it.
+static bool startCoreRenderer() {
+	if (!coreRenderer.compile())
+		return false;
+	useCore = true;
+	// the shaders place the belt bodies themselves
+	simulation->setSolveBelts(false);
+	return true;
 }
 
-void display() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glPushMatrix();
-
-	GLfloat light_ambient[] = { 10.2, 10.2, 10.2, 11.0 };
-	GLfloat light_position[] = { 0.0, 0.0, 0.0, 0.0 };
-
-	glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-	glLightfv(GL_LIGHT0, GL_POSITION, light_position);
-
-	//enable lighting parameters
-	glEnable(GL_LIGHT0);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_LIGHTING);
-
-	glPushMatrix();
-	glBindTexture(GL_TEXTURE_2D, starTex);
-	//create a sphere and use it as a background to store the texture for the stars
-	myWireSphere(20, 30, 30);
-	GLUquadric *quadricStars = gluNewQuadric();
-	gluQuadricDrawStyle(quadricStars, GLU_FILL);
-	gluQuadricNormals(quadricStars, GLU_SMOOTH);
-	gluQuadricTexture(quadricStars, GL_TRUE);
-	gluSphere(quadricStars, 20.0, 20, 20);
-	gluDeleteQuadric(quadricStars);
-	glPopMatrix();
-
-	glBindTexture(GL_TEXTURE_2D, sunTex);
-//	//draw sun with radius of 1
-	myWireSphere(1, 15, 15);
-	GLUquadric *quadricSun = gluNewQuadric();
-	gluQuadricDrawStyle(quadricSun, GLU_FILL);
-	gluQuadricNormals(quadricSun, GLU_SMOOTH);
-	gluQuadricTexture(quadricSun, GL_TRUE);
-	gluSphere(quadricSun, 1.2, 20, 20);
-	gluDeleteQuadric(quadricSun);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(mercuryTex, 2.0, 0.05, 4.14 * yearForPlanet, dayForPlanet);
-	GLUquadric * quadricMercury = gluNewQuadric();
-	gluQuadricDrawStyle(quadricMercury, GLU_FILL);
-	gluQuadricNormals(quadricMercury, GLU_SMOOTH);
-	gluQuadricTexture(quadricMercury, GL_TRUE);
-	gluSphere(quadricMercury, .06, 20, 20);
-	gluDeleteQuadric(quadricMercury);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(venusTex, 3.5, 0.17, 1.62 * yearForPlanet, dayForPlanet);
-	GLUquadric * quadricVenus = gluNewQuadric();
-	gluQuadricDrawStyle(quadricVenus, GLU_FILL);
-	gluQuadricNormals(quadricVenus, GLU_SMOOTH);
-	gluQuadricTexture(quadricVenus, GL_TRUE);
-	gluSphere(quadricVenus, .18, 20, 20);
-	gluDeleteQuadric(quadricVenus);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(earthTex, 5.0, 0.19, yearForPlanet, dayForPlanet);
-	GLUquadric *quadricEarth = gluNewQuadric();
-	gluQuadricDrawStyle(quadricEarth, GLU_FILL);
-	gluQuadricNormals(quadricEarth, GLU_SMOOTH);
-	gluQuadricTexture(quadricEarth, GL_TRUE);
-	gluSphere(quadricEarth, 0.2, 20, 20);
-	gluDeleteQuadric(quadricEarth);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(marsTex, 6.5, 0.06, 0.53 * yearForPlanet, dayForPlanet);
-	GLUquadric *quadricMars = gluNewQuadric();
-	gluQuadricDrawStyle(quadricMars, GLU_FILL);
-	gluQuadricNormals(quadricMars, GLU_SMOOTH);
-	gluQuadricTexture(quadricMars, GL_TRUE);
-	gluSphere(quadricMars, .07, 20, 20);
-	gluDeleteQuadric(quadricMars);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(jupiterTex, 9.0, 0.9, 0.08 * yearForPlanet, dayForPlanet);
-	GLUquadric *quadricJupiter = gluNewQuadric();
-	gluQuadricDrawStyle(quadricJupiter, GLU_FILL);
-	gluQuadricNormals(quadricJupiter, GLU_SMOOTH);
-	gluQuadricTexture(quadricJupiter, GL_TRUE);
-	gluSphere(quadricJupiter, 1.0, 20, 20);
-	gluDeleteQuadric(quadricJupiter);
-	glPopMatrix();
-
-	glPushMatrix();
-	glColor3f(1.0, 0.0, 0.0);
-	glBindTexture(GL_TEXTURE_2D, ringOfSaturnTex);
-	glRotatef((GLfloat) 0.03 * yearForPlanet, 0.0, 1.0, 0.0);
-	glTranslatef(11.5, 0.0, 0.0);
-	glRotatef((GLfloat) dayForPlanet, 0.0, 1.0, 0.0);
-	glRotatef(90, 1, 0, 0);
-
-	GLUquadric *quadricRingOfSaturn = gluNewQuadric();
-	gluQuadricDrawStyle(quadricRingOfSaturn, GLU_FILL);
-	gluQuadricNormals(quadricRingOfSaturn, GLU_SMOOTH);
-	gluQuadricTexture(quadricRingOfSaturn, GL_TRUE);
-	gluDisk(quadricRingOfSaturn, 1, 1.5, 100.0, 1.0);
-	gluDeleteQuadric(quadricRingOfSaturn);
-
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(saturnTex, 11.5, 0.7, 0.03 * yearForPlanet, dayForPlanet);
-	GLUquadric *quadricSaturn = gluNewQuadric();
-	gluQuadricDrawStyle(quadricSaturn, GLU_FILL);
-	gluQuadricNormals(quadricSaturn, GLU_SMOOTH);
-	gluQuadricTexture(quadricSaturn, GL_TRUE);
-	gluSphere(quadricSaturn, 0.8, 20, 20);
-	gluDeleteQuadric(quadricSaturn);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(uranusTex, 14.0, 0.5, 0.01189 * yearForPlanet, dayForPlanet);
-	GLUquadric *quadricUranus = gluNewQuadric();
-	gluQuadricDrawStyle(quadricUranus, GLU_FILL);
-	gluQuadricNormals(quadricUranus, GLU_SMOOTH);
-	gluQuadricTexture(quadricUranus, GL_TRUE);
-	gluSphere(quadricUranus, 0.6, 20, 20);
-	gluDeleteQuadric(quadricUranus);
-	glPopMatrix();
-
-	glPushMatrix();
-	createPlanet(neptuneTex, 16.0, 0.5, 0.006 * yearForPlanet, dayForPlanet);
-	GLUquadric *quadricNeptune = gluNewQuadric();
-	gluQuadricDrawStyle(quadricNeptune, GLU_FILL);
-	gluQuadricNormals(quadricNeptune, GLU_SMOOTH);
-	gluQuadricTexture(quadricNeptune, GL_TRUE);
-	gluSphere(quadricNeptune, 0.6, 20, 20);
-	gluDeleteQuadric(quadricNeptune);
-	glPopMatrix();
-
-	glFlush();
-	glutSwapBuffers();
+// Creates the headless context for the renderer the options ask for,
+// falling back to the fixed-function pipeline where shaders cannot run.
+static bool openHeadlessContext() {
+	if (options.coreProfile) {
+		if (createHeadlessContext(options.width, options.height, true)) {
+			if (startCoreRenderer())
+				return true;
+			destroyHeadlessContext();
+		}
+		printf("Falling back to the fixed-function renderer\n");
+	}
+	return createHeadlessContext(options.width, options.height);
 }
 
-void KeyboardFunc(unsigned char key, int x, int y) {
-	switch (key) {
-		//parallel front view
-	case 'a':
-	case 'A':
-		eyeX = 0, eyeY = 0, eyeZ = 20;
-		centerX = 0, centerY = 0, centerZ = 0;
-		upX = 0, upY = 1, upZ = 0;
-		glutPostRedisplay();
-		break;
-		//top view
-	case 'w':
-	case 'W':
-		eyeX = 0, eyeY = 20, eyeZ = 0; //was 6
-		centerX = 0, centerY = 0, centerZ = 0;
-		upX = 0, upY = 1, upZ = 1; //both 1
-		glutPostRedisplay();
-		break;
-		//parallel side view
-	case 'd':
-	case 'D':
-		eyeX = 20, eyeY = 0, eyeZ = 0;
-		centerX = 0, centerY = 0, centerZ = 0;
-		upX = 0, upY = 1, upZ = 0;
-		glutPostRedisplay();
-		break;
-		//perspective
-	case 's':
-	case 'S':
-		eyeX = 10, eyeY = 12, eyeZ = 13;
-		centerX = 0, centerY = 0, centerZ = 0;
-		upX = 0, upY = 1, upZ = 0;
-		glutPostRedisplay();
-		break;
+// Renders options.frames frames offscreen, capturing them to
+// options.capture or options.outputDir when one is given.
+int runHeadless() {
+	if (!openHeadlessContext())
+		return 1;
+	camera = findCameraPreset(options.camera)->camera;
+	InitGL(options.width, options.height);
+	reshape(options.width, options.height);
+
+	FrameCapture capture;
+	std::string target = options.capture != NULL ? options.capture : "";
+	if (target.empty() && options.outputDir != NULL)
+		target = std::string(options.outputDir) + "/frame%05d.ppm";
+	if (!target.empty()
+			&& !capture.open(target.c_str(), options.width, options.height))
+		return 1;
+
+	std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+	bool ok = true;
+	int frames = 0;
+	for (; frames < options.frames && ok; frames++) {
+		profileBeginFrame();
+		advanceFrame();
+		renderFrame();
+		// read back while the next frames are drawn
+		if (capture.isOpen())
+			ok = capture.capture();
+		presentHeadlessFrame(false);
 	}
+	glFinish();
+	if (capture.isOpen() && !capture.close())
+		ok = false;
+	double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	printf("Rendered %d frames in %.2f s (%.2f ms per frame)\n",
+			frames, seconds, seconds * 1000.0 / frames);
+
+	coreRenderer.release();
+	deletePointBuffer(beltPoints);
+	deletePointBuffer(particlePoints);
+	deleteTrails(trails);
+	deleteOrbitPaths(orbitPaths);
+	textureStreamer.release();
+	deleteStarField(starField);
+	deleteMeshes();
+	destroyHeadlessContext();
+	return ok ? 0 : 1;
 }
 
-void timer(int v) {
-	dayForPlanet = (dayForPlanet + 1) % 365;
-	yearForPlanet = (yearForPlanet + 2) % 60190;
-	glLoadIdentity();
-	gluLookAt(eyeX, eyeY, eyeZ, centerX, centerY, centerZ, upX, upY, upZ);
-	glutPostRedisplay();
-	glutTimerFunc(1000 / 60, timer, v);
+// Where the benchmark JSON goes without --bench-output: the standard
+// output as it was at start, which everything else printed then leaves
+// for the standard error, so that the output stays valid JSON.
+static FILE *benchFile = stdout;
+
+static void divertStandardOutput() {
+	fflush(stdout);
+	int json = dup(STDOUT_FILENO);
+	if (json < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+		return;
+	benchFile = fdopen(json, "w");
+	if (benchFile == NULL)
+		benchFile = stdout;
 }
 
-void reshape(GLint w, GLint h) {
-	glViewport(0, 0, w, h);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(60.0, (GLfloat) w / (GLfloat) h, 1.0, 40.0);
-	glMatrixMode(GL_MODELVIEW);
+// Times options.frames frames from every camera preset, or with --views
+// from the split screen, after options.warmupFrames untimed ones, and
+// writes the statistics as JSON.
+int runBench() {
+	if (!openHeadlessContext())
+		return 1;
+	InitGL(options.width, options.height);
+	reshape(options.width, options.height);
+	// the frames are timed with every texture in place
+	textureStreamer.finish(bodies);
+
+	std::vector<BenchRun> runs;
+	for (int p = 0; p < (splitScreen ? 1 : cameraPresetCount); p++) {
+		BenchRun run;
+		if (splitScreen)
+			run.camera = options.views;
+		else {
+			run.camera = cameraPresets[p].name;
+			camera = cameraPresets[p].camera;
+		}
+		restartBatch();
+		for (int i = 0; i < options.warmupFrames + options.frames; i++) {
+			if (i == options.warmupFrames)
+				enableFrameProfile(options.benchSync);
+			profileBeginFrame();
+			advanceFrame();
+			renderFrame();
+			presentHeadlessFrame();
+			FrameTiming timing = profileEndFrame();
+			timing.stateIssued = glStateStats.issued;
+			timing.stateElided = glStateStats.elided;
+			if (i >= options.warmupFrames)
+				run.frames.push_back(timing);
+		}
+		disableFrameProfile();
+		runs.push_back(run);
+	}
+
+	BenchInfo info;
+	info.renderer = (const char *) glGetString(GL_RENDERER);
+	info.pipeline = useCore ? "core" : "fixed";
+	info.width = options.width;
+	info.height = options.height;
+	info.warmupFrames = options.warmupFrames;
+	info.bodyCount = bodies.count;
+	info.beltBodyCount = (int) bodies.beltOrbits.eccentricity.size();
+	info.sync = options.benchSync;
+	FILE *file = benchFile;
+	if (options.benchOutput != NULL
+			&& (file = fopen(options.benchOutput, "w")) == NULL) {
+		printf("Cannot write %s\n", options.benchOutput);
+		return 1;
+	}
+	writeBenchJSON(file, info, runs);
+	if (file != stdout)
+		fclose(file);
+
+	coreRenderer.release();
+	deletePointBuffer(beltPoints);
+	deletePointBuffer(particlePoints);
+	deleteTrails(trails);
+	deleteOrbitPaths(orbitPaths);
+	textureStreamer.release();
+	deleteStarField(starField);
+	deleteMeshes();
+	destroyHeadlessContext();
+	return 0;
 }
 
 int main(int argc, char** argv) {
+	if (!parseOptions(argc, argv, &options)) {
+		optionsUsage();
+		exit(1);
+	}
+	if (options.bench && options.benchOutput == NULL)
+		divertStandardOutput();
+	if (!loadBodyTable(options.bodyFile, &bodies))
+		exit(1);
+	useLod = options.lod;
+	showTrails = options.trails;
+	showOrbits = options.orbits;
+	// 'v' shows the four presets unless --views names others
+	parseViewCameras(options.views != NULL ? options.views : "all",
+			viewCameras);
+	splitScreen = options.views != NULL;
+	if (options.bodyCount > bodies.count)
+		addSyntheticBodies(bodies, options.bodyCount, 1);
+	generateBelts(bodies, options.beltCount, 1);
+	if (openEphemeris(options.ephemeris, &ephemeris))
+		printf("Positions of %d bodies from %s\n",
+				attachEphemeris(bodies, ephemeris), options.ephemeris);
+	simulation = new Simulation(bodies);
+	if (options.gravity)
+		simulation->setGravity(new Gravity(bodies, options.swarm, 1,
+				options.theta, options.gravityStep));
+	simulation->setTimeScale(options.timeScale);
+	simulation->reset(options.startDays);
+	if (options.bench)
+		return runBench();
+	if (options.headless)
+		return runHeadless();
+
 	usage();
-	glutInit(&argc, argv);
+	int glutArgc = (int) options.glutArgs.size() - 1;
+	glutInit(&glutArgc, &options.glutArgs[0]);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_ALPHA | GLUT_DEPTH);
-	glutInitWindowSize(1000, 800);
-	glutCreateWindow("Solar System");
+	glutInitWindowSize(options.width, options.height);
+	if (options.coreProfile) {
+		glutInitContextVersion(3, 3);
+		glutInitContextProfile(GLUT_CORE_PROFILE);
+	}
+	int window = glutCreateWindow("Solar System");
+	if (options.coreProfile && !startCoreRenderer()) {
+		printf("Falling back to the fixed-function renderer\n");
+		glutDestroyWindow(window);
+		glutInitContextVersion(1, 0);
+		glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
+		glutCreateWindow("Solar System");
+	}
 
 	glutDisplayFunc(display);
 	glutKeyboardFunc(&KeyboardFunc);
+	glutMouseFunc(mouse);
 	glutReshapeFunc(reshape);
 
 	glutTimerFunc(100, timer, 0);
 
 	glEnable(GL_DEPTH_TEST);
 	InitGL(800, 600);
+	simulation->reset(options.startDays);
+	if (options.simThread)
+		simulation->startThread();
 	glutMainLoop();
 }
@@ -0,0 +1,77 @@
+/* Read-only views of whole files. */
+
+#include "mappedfile.h"
+
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mapFile(const char *filename, MappedFile *file, bool populate,
+		bool writable) {
+	file->data = NULL;
+	file->size = 0;
+#if defined(_WIN32)
+	FILE *fp;
+	long size;
+
+	if ((fp = fopen(filename, "rb")) == NULL)
+		return false;
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size <= 0 || (file->data = malloc(size)) == NULL) {
+		fclose(fp);
+		return false;
+	}
+	file->size = size;
+	if (fread(file->data, size, 1, fp) != 1) {
+		fclose(fp);
+		unmapFile(file);
+		return false;
+	}
+	fclose(fp);
+	return true;
+#else
+	int fd;
+	struct stat st;
+	int flags = MAP_PRIVATE;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return false;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+#ifdef MAP_POPULATE
+	if (populate)
+		flags |= MAP_POPULATE;
+#endif
+	void *p = mmap(NULL, st.st_size,
+			writable ? PROT_READ | PROT_WRITE : PROT_READ, flags, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	file->data = p;
+	file->size = st.st_size;
+	return true;
+#endif
+}
+
+void unmapFile(MappedFile *file) {
+	if (file->data != NULL) {
+#if defined(_WIN32)
+		free(file->data);
+#else
+		munmap(file->data, file->size);
+#endif
+	}
+	file->data = NULL;
+	file->size = 0;
+}
@@ -0,0 +1,24 @@
+/* Read-only views of whole files. */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+struct MappedFile {
+	void *data;
+	size_t size;
+};
+
+// Maps the whole file into memory, read-only unless writable is set. The
+// pages are private, so writing to them never changes the file, but every
+// page written to, or read in by populate when writable, becomes a copy.
+// With populate the file is read in before the call returns, so later
+// accesses do not stall on disk. Platforms without mmap get a heap copy
+// instead.
+bool mapFile(const char *filename, MappedFile *file, bool populate,
+		bool writable = false);
+
+void unmapFile(MappedFile *file);
+
+#endif
@@ -0,0 +1,108 @@
+/* 4x4 matrices and quaternions. */
+
+#include "matrix.h"
+
+#include <cmath>
+#include <cstring>
+
+Matrix4 matrixMultiply(const Matrix4 &a, const Matrix4 &b) {
+	Matrix4 out;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += a.m[k * 4 + r] * b.m[c * 4 + k];
+			out.m[c * 4 + r] = sum;
+		}
+	return out;
+}
+
+Matrix4 matrixPerspective(float fovy, float aspect, float zNear, float zFar) {
+	Matrix4 out;
+	memset(out.m, 0, sizeof(out.m));
+	float f = 1.0f / tanf(fovy * (float) M_PI / 360.0f);
+	out.m[0] = f / aspect;
+	out.m[5] = f;
+	out.m[10] = (zFar + zNear) / (zNear - zFar);
+	out.m[11] = -1.0f;
+	out.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+	return out;
+}
+
+static void normalize(float v[3]) {
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (length > 0.0f)
+		for (int i = 0; i < 3; i++)
+			v[i] /= length;
+}
+
+static void cross(const float a[3], const float b[3], float out[3]) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+Matrix4 matrixLookAt(const Camera &camera) {
+	float forward[3] = { camera.centerX - camera.eyeX,
+			camera.centerY - camera.eyeY, camera.centerZ - camera.eyeZ };
+	float up[3] = { camera.upX, camera.upY, camera.upZ };
+	float side[3], trueUp[3];
+	normalize(forward);
+	cross(forward, up, side);
+	normalize(side);
+	cross(side, forward, trueUp);
+
+	// rows side, up and -forward, then the eye moved to the origin
+	const float eye[3] = { camera.eyeX, camera.eyeY, camera.eyeZ };
+	Matrix4 out;
+	for (int c = 0; c < 3; c++) {
+		out.m[c * 4] = side[c];
+		out.m[c * 4 + 1] = trueUp[c];
+		out.m[c * 4 + 2] = -forward[c];
+		out.m[c * 4 + 3] = 0.0f;
+	}
+	for (int r = 0; r < 3; r++)
+		out.m[12 + r] = -(out.m[r] * eye[0] + out.m[4 + r] * eye[1]
+				+ out.m[8 + r] * eye[2]);
+	out.m[15] = 1.0f;
+	return out;
+}
+
+Matrix4 matrixTranslation(float x, float y, float z) {
+	Matrix4 out;
+	memset(out.m, 0, sizeof(out.m));
+	out.m[0] = out.m[5] = out.m[10] = out.m[15] = 1.0f;
+	out.m[12] = x;
+	out.m[13] = y;
+	out.m[14] = z;
+	return out;
+}
+
+Quaternion quaternionAxisAngle(float degrees, float x, float y, float z) {
+	float half = degrees * (float) M_PI / 360.0f;
+	float s = sinf(half);
+	Quaternion q = { cosf(half), x * s, y * s, z * s };
+	return q;
+}
+
+Quaternion quaternionMultiply(const Quaternion &a, const Quaternion &b) {
+	Quaternion q;
+	q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+	q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+	q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+	q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+	return q;
+}
+
+void quaternionRotate(const Quaternion &q, double v[3]) {
+	// v + 2 u x (u x v + w v), with u the vector part
+	double t[3] = { q.y * v[2] - q.z * v[1] + q.w * v[0],
+			q.z * v[0] - q.x * v[2] + q.w * v[1],
+			q.x * v[1] - q.y * v[0] + q.w * v[2] };
+	double out[3] = { v[0] + 2.0 * (q.y * t[2] - q.z * t[1]),
+			v[1] + 2.0 * (q.z * t[0] - q.x * t[2]),
+			v[2] + 2.0 * (q.x * t[1] - q.y * t[0]) };
+	v[0] = out[0];
+	v[1] = out[1];
+	v[2] = out[2];
+}
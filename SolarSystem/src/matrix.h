@@ -0,0 +1,47 @@
+/* 4x4 matrices and quaternions.
+ *
+ * A core-profile context has no matrix stack, and the scene graph composes
+ * the bodies' transforms itself, so the camera, the projection and the
+ * orientations are built here instead. Matrices are laid out column by
+ * column as GL takes them.
+ */
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "camera.h"
+
+struct Matrix4 {
+	float m[16];  // column major
+};
+
+// a b: b applied first.
+Matrix4 matrixMultiply(const Matrix4 &a, const Matrix4 &b);
+
+// As gluPerspective: fovy in degrees.
+Matrix4 matrixPerspective(float fovy, float aspect, float zNear, float zFar);
+
+// As gluLookAt.
+Matrix4 matrixLookAt(const Camera &camera);
+
+// As glTranslatef.
+Matrix4 matrixTranslation(float x, float y, float z);
+
+// A rotation, of unit length.
+struct Quaternion {
+	float w, x, y, z;
+};
+
+const Quaternion identityQuaternion = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+// A turn of degrees about the unit axis (x, y, z), anticlockwise looking
+// down the axis, as glRotatef.
+Quaternion quaternionAxisAngle(float degrees, float x, float y, float z);
+
+// a b: b applied first.
+Quaternion quaternionMultiply(const Quaternion &a, const Quaternion &b);
+
+// Turns v by q.
+void quaternionRotate(const Quaternion &q, double v[3]);
+
+#endif
@@ -0,0 +1,302 @@
+/* Cached sphere and ring meshes. */
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "glstate.h"
+
+MeshStats meshStats;
+
+static std::map<std::pair<int, int>, Mesh> sphereCache;
+static std::map<std::pair<int, std::pair<int, int> >, Mesh> ringCache;
+
+// Copies the tessellated geometry into a new pair of buffer objects.
+static Mesh uploadMesh(const std::vector<MeshVertex> &vertices,
+		const std::vector<GLuint> &indices) {
+	Mesh mesh;
+	mesh.vertexCount = (GLsizei) vertices.size();
+	mesh.indexCount = (GLsizei) indices.size();
+
+	glGenBuffers(1, &mesh.vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex),
+			&vertices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &mesh.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+			&indices[0], GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return mesh;
+}
+
+static Mesh buildSphere(int slices, int stacks) {
+	std::vector<MeshVertex> vertices;
+	std::vector<GLuint> indices;
+
+	// one extra column so the texture seam gets its own vertices
+	for (int j = 0; j <= stacks; j++) {
+		double phi = M_PI * (double) j / stacks;
+		double z = -cos(phi);
+		double r = sin(phi);
+		for (int i = 0; i <= slices; i++) {
+			double theta = 2.0 * M_PI * (double) i / slices;
+			MeshVertex v;
+			v.nx = v.x = (GLfloat) (sin(theta) * r);
+			v.ny = v.y = (GLfloat) (cos(theta) * r);
+			v.nz = v.z = (GLfloat) z;
+			v.s = (GLfloat) i / slices;
+			v.t = (GLfloat) j / stacks;
+			vertices.push_back(v);
+		}
+	}
+
+	// counter-clockwise seen from outside; skip the triangles that
+	// collapse into the poles
+	for (int j = 0; j < stacks; j++) {
+		for (int i = 0; i < slices; i++) {
+			GLuint a = j * (slices + 1) + i;
+			GLuint b = a + 1;
+			GLuint c = a + slices + 1;
+			GLuint d = c + 1;
+			if (j != 0) {
+				indices.push_back(a);
+				indices.push_back(c);
+				indices.push_back(b);
+			}
+			if (j != stacks - 1) {
+				indices.push_back(b);
+				indices.push_back(c);
+				indices.push_back(d);
+			}
+		}
+	}
+	return uploadMesh(vertices, indices);
+}
+
+static Mesh buildRing(GLfloat innerRadius, int slices, int loops) {
+	std::vector<MeshVertex> vertices;
+	std::vector<GLuint> indices;
+
+	for (int j = 0; j <= loops; j++) {
+		double r = innerRadius + (1.0 - innerRadius) * (double) j / loops;
+		for (int i = 0; i <= slices; i++) {
+			double theta = 2.0 * M_PI * (double) i / slices;
+			MeshVertex v;
+			v.x = (GLfloat) (r * sin(theta));
+			v.y = (GLfloat) (r * cos(theta));
+			v.z = 0.0f;
+			v.nx = 0.0f;
+			v.ny = 0.0f;
+			v.nz = 1.0f;
+			v.s = 0.5f + v.x * 0.5f;
+			v.t = 0.5f + v.y * 0.5f;
+			vertices.push_back(v);
+		}
+	}
+
+	for (int j = 0; j < loops; j++) {
+		for (int i = 0; i < slices; i++) {
+			GLuint a = j * (slices + 1) + i;
+			GLuint b = a + 1;
+			GLuint c = a + slices + 1;
+			GLuint d = c + 1;
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+			indices.push_back(b);
+			indices.push_back(d);
+			indices.push_back(c);
+		}
+	}
+	return uploadMesh(vertices, indices);
+}
+
+const Mesh &sphereMesh(int slices, int stacks) {
+	std::pair<int, int> key(slices, stacks);
+	std::map<std::pair<int, int>, Mesh>::iterator it = sphereCache.find(key);
+	if (it == sphereCache.end())
+		it = sphereCache.insert(std::make_pair(key,
+				buildSphere(slices, stacks))).first;
+	return it->second;
+}
+
+const Mesh &ringMesh(GLfloat innerRadius, int slices, int loops) {
+	// key the inner radius in thousandths so nearly equal rings share a mesh
+	std::pair<int, std::pair<int, int> > key(
+			(int) lround(innerRadius * 1000.0f), std::make_pair(slices, loops));
+	std::map<std::pair<int, std::pair<int, int> >, Mesh>::iterator it =
+			ringCache.find(key);
+	if (it == ringCache.end())
+		it = ringCache.insert(std::make_pair(key,
+				buildRing(innerRadius, slices, loops))).first;
+	return it->second;
+}
+
+// No level is coarser than these.
+static const int minSphereSlices = 6, minSphereStacks = 4, minRingSlices = 12;
+// Longest edge, in pixels, that a level may show.
+static const float maxEdgePixels = 8.0f;
+
+MeshLod sphereMeshLod(int slices, int stacks) {
+	MeshLod lod;
+	for (int l = 0; l < meshLodCount; l++) {
+		lod.slices[l] = slices;
+		lod.level[l] = &sphereMesh(slices, stacks);
+		// a mesh already below the floor keeps its detail
+		slices = std::min(slices, std::max(slices / 2, minSphereSlices));
+		stacks = std::min(stacks, std::max(stacks / 2, minSphereStacks));
+	}
+	return lod;
+}
+
+MeshLod ringMeshLod(GLfloat innerRadius, int slices, int loops) {
+	MeshLod lod;
+	for (int l = 0; l < meshLodCount; l++) {
+		lod.slices[l] = slices;
+		lod.level[l] = &ringMesh(innerRadius, slices, loops);
+		slices = std::min(slices, std::max(slices / 2, minRingSlices));
+	}
+	return lod;
+}
+
+const Mesh &selectMeshLod(const MeshLod &lod, float pixels) {
+	return *lod.level[selectMeshLodLevel(lod, pixels)];
+}
+
+int selectMeshLodLevel(const MeshLod &lod, float pixels) {
+	// an edge is about the circumference over the slices
+	for (int l = meshLodCount - 1; l > 0; l--)
+		if (2.0f * (float) M_PI * pixels <= maxEdgePixels * lod.slices[l])
+			return l;
+	return 0;
+}
+
+void drawMesh(const Mesh &mesh) {
+	// the pointers only need setting when the vertex buffer changes
+	if (glState.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer)) {
+		glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex),
+				(const GLvoid *) offsetof(MeshVertex, x));
+		glNormalPointer(GL_FLOAT, sizeof(MeshVertex),
+				(const GLvoid *) offsetof(MeshVertex, nx));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(MeshVertex),
+				(const GLvoid *) offsetof(MeshVertex, s));
+	}
+	glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+	glState.clientState(GL_VERTEX_ARRAY, true);
+	glState.clientState(GL_NORMAL_ARRAY, true);
+	glState.clientState(GL_TEXTURE_COORD_ARRAY, true);
+	glState.clientState(GL_COLOR_ARRAY, false);
+
+	glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+	meshStats.drawCalls++;
+	meshStats.indices += mesh.indexCount;
+}
+
+void drawMeshWireframe(const Mesh &mesh) {
+	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT | GL_CURRENT_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_LIGHTING);
+	glColor3f(1.0f, 1.0f, 1.0f);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	glEnable(GL_POLYGON_OFFSET_LINE);
+	glPolygonOffset(-1.0f, -1.0f);
+	drawMesh(mesh);
+	glPopAttrib();
+}
+
+// Reused by every drawPoints call.
+static PointBuffer sharedPoints = { 0, 0, false };
+
+void uploadPoints(PointBuffer &points, const GLfloat *xyz, GLsizei count,
+		const GLfloat *rgb) {
+	points.count = count;
+	points.colored = rgb != NULL;
+	if (count == 0)
+		return;
+	if (points.buffer == 0)
+		glGenBuffers(1, &points.buffer);
+	// positions first, then the colours if there are any; the storage is
+	// replaced each time so the driver never waits for the last frame's
+	const GLsizeiptr bytes = count * 3 * sizeof(GLfloat);
+	glState.bindBuffer(GL_ARRAY_BUFFER, points.buffer);
+	glBufferData(GL_ARRAY_BUFFER, rgb != NULL ? 2 * bytes : bytes, NULL,
+			GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, xyz);
+	if (rgb != NULL)
+		glBufferSubData(GL_ARRAY_BUFFER, bytes, bytes, rgb);
+}
+
+void drawPointBuffer(const PointBuffer &points, GLfloat size) {
+	if (points.count == 0)
+		return;
+	glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_CURRENT_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_LIGHTING);
+	glPointSize(size);
+	glState.bindBuffer(GL_ARRAY_BUFFER, points.buffer);
+	glState.clientState(GL_VERTEX_ARRAY, true);
+	glState.clientState(GL_NORMAL_ARRAY, false);
+	glState.clientState(GL_TEXTURE_COORD_ARRAY, false);
+	glVertexPointer(3, GL_FLOAT, 0, 0);
+	glState.clientState(GL_COLOR_ARRAY, points.colored);
+	if (points.colored)
+		glColorPointer(3, GL_FLOAT, 0,
+				(const GLvoid *) (points.count * 3 * sizeof(GLfloat)));
+
+	glDrawArrays(GL_POINTS, 0, points.count);
+	meshStats.drawCalls++;
+	meshStats.indices += points.count;
+	glPopAttrib();
+}
+
+void deletePointBuffer(PointBuffer &points) {
+	if (points.buffer != 0)
+		glDeleteBuffers(1, &points.buffer);
+	points.buffer = 0;
+	points.count = 0;
+	// deleting a bound buffer unbinds it behind the cache's back
+	glState.invalidate();
+}
+
+void drawPoints(const GLfloat *xyz, GLsizei count, const GLfloat *rgb,
+		GLfloat size) {
+	uploadPoints(sharedPoints, xyz, count, rgb);
+	drawPointBuffer(sharedPoints, size);
+}
+
+void resetMeshStats() {
+	meshStats.drawCalls = 0;
+	meshStats.indices = 0;
+	meshStats.culled = 0;
+	meshStats.points = 0;
+}
+
+static void deleteMesh(Mesh &mesh) {
+	glDeleteBuffers(1, &mesh.vertexBuffer);
+	glDeleteBuffers(1, &mesh.indexBuffer);
+}
+
+void deleteMeshes() {
+	for (std::map<std::pair<int, int>, Mesh>::iterator it =
+			sphereCache.begin(); it != sphereCache.end(); ++it)
+		deleteMesh(it->second);
+	for (std::map<std::pair<int, std::pair<int, int> >, Mesh>::iterator it =
+			ringCache.begin(); it != ringCache.end(); ++it)
+		deleteMesh(it->second);
+	sphereCache.clear();
+	ringCache.clear();
+	if (sharedPoints.buffer != 0)
+		glDeleteBuffers(1, &sharedPoints.buffer);
+	sharedPoints.buffer = 0;
+	// deleting a bound buffer unbinds it behind the cache's back
+	glState.invalidate();
+}
@@ -0,0 +1,107 @@
+/* Cached sphere and ring meshes.
+ *
+ * Every mesh is tessellated once into a vertex buffer and an index buffer
+ * and then drawn with a single glDrawElements call, instead of rebuilding
+ * the geometry through a GLU quadric on every frame.
+ */
+
+#ifndef MESH_H
+#define MESH_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <cstddef>
+
+// Interleaved vertex layout shared by every cached mesh.
+struct MeshVertex {
+	GLfloat x, y, z;     // position
+	GLfloat nx, ny, nz;  // normal
+	GLfloat s, t;        // texture coordinate
+};
+
+struct Mesh {
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLsizei vertexCount;
+	GLsizei indexCount;
+};
+
+// Coarser and coarser tessellations of one shape, finest first.
+const int meshLodCount = 4;
+struct MeshLod {
+	const Mesh *level[meshLodCount];
+	int slices[meshLodCount];
+};
+
+// Submission counters, accumulated by drawMesh until reset. The renderer
+// counts the bodies it culls or draws as points.
+struct MeshStats {
+	unsigned long drawCalls;
+	// the indices of indexed draws, and the vertices of the others
+	unsigned long indices;
+	unsigned long culled;
+	unsigned long points;
+};
+
+extern MeshStats meshStats;
+
+// Returns the unit sphere for the given tessellation, building it on first
+// use. The layout and texture coordinates follow gluSphere: poles on the
+// z-axis, t from 0 at z = -1 to 1 at z = +1, s starting at the +y axis.
+const Mesh &sphereMesh(int slices, int stacks);
+
+// Returns a flat ring in the z = 0 plane with an outer radius of 1 and the
+// given inner radius, building it on first use. Texture coordinates follow
+// gluDisk.
+const Mesh &ringMesh(GLfloat innerRadius, int slices, int loops);
+
+// The levels of detail of sphereMesh and ringMesh: each level halves the
+// slices and stacks of the one before, down to a floor, and none is finer
+// than the one before.
+MeshLod sphereMeshLod(int slices, int stacks);
+MeshLod ringMeshLod(GLfloat innerRadius, int slices, int loops);
+
+// The coarsest level whose edges stay within a few pixels on a shape that
+// appears pixels in radius, and its index.
+const Mesh &selectMeshLod(const MeshLod &lod, float pixels);
+int selectMeshLodLevel(const MeshLod &lod, float pixels);
+
+// Draws a cached mesh with the current modelview matrix. Its buffers and
+// arrays stay bound, through glState, so that drawing the same mesh again
+// costs only the draw call.
+void drawMesh(const Mesh &mesh);
+
+// Draws the edges of a cached mesh untextured and unlit, pulled slightly
+// towards the viewer so they show on top of the filled mesh.
+void drawMeshWireframe(const Mesh &mesh);
+
+// Points streamed into a buffer of their own, to be drawn more than once.
+struct PointBuffer {
+	GLuint buffer;
+	GLsizei count;
+	bool colored;
+};
+
+// Streams count points, three floats each, into points, with the colours
+// rgb (three floats each) unless it is NULL.
+void uploadPoints(PointBuffer &points, const GLfloat *xyz, GLsizei count,
+		const GLfloat *rgb = NULL);
+
+// Draws points untextured and unlit, in their colours or, without any, in
+// the current colour.
+void drawPointBuffer(const PointBuffer &points, GLfloat size = 1.0f);
+
+void deletePointBuffer(PointBuffer &points);
+
+// Streams count points into a shared buffer and draws them, as uploadPoints
+// and drawPointBuffer.
+void drawPoints(const GLfloat *xyz, GLsizei count, const GLfloat *rgb = NULL,
+		GLfloat size = 1.0f);
+
+void resetMeshStats();
+
+// Releases every cached buffer, and the point buffer.
+void deleteMeshes();
+
+#endif
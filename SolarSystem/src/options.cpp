@@ -0,0 +1,323 @@
+/* Command-line options. */
+
+#include "options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+#include "simulation.h"
+#include "views.h"
+
+void optionsUsage() {
+	printf("usage: solar [options] [bodies.cfg]\n\
+	--pack FILE       texture pack to load textures from (textures.pack)\n\
+	--texture-budget K\n\
+	                  kilobytes of texture uploaded per frame while the\n\
+	                  textures stream in (2048)\n\
+	--stars FILE      star catalog to draw the sky from (stars.cat)\n\
+	--star-count N    stars to generate when there is no catalog, 0 for\n\
+	                  none (100000)\n\
+	--ephemeris FILE  ephemeris to take the bodies' positions from, where\n\
+	                  it covers them (ephemeris.eph)\n\
+	--headless        render offscreen without a window or display server\n\
+	--frames N        number of frames to render headless (100)\n\
+	--camera NAME     front, side, top or perspective (perspective)\n\
+	--views LIST      draw the cameras of LIST side by side: preset names,\n\
+	                  all for the four presets, or eye positions X:Y:Z\n\
+	                  looking at the sun, separated by commas\n\
+	--size WxH        size of the headless frames (1000x800)\n\
+	--output DIR      write headless frames to DIR as PPM images\n\
+	--capture TARGET  render headless and write every frame to TARGET, a\n\
+	                  file pattern such as clip/%%05d.ppm, or |COMMAND to\n\
+	                  pipe raw RGB frames, top row first, into COMMAND\n\
+	--steps N         simulation steps of 1/60 s per headless frame (1)\n\
+	--fps F           headless frames per second of real time, each moving\n\
+	                  the clock on by 1/F s instead of --steps steps\n\
+	--no-lod          draw every body, at full detail\n\
+	--trails          draw a trail behind every body\n\
+	--trail-length N  frames each trail covers (200)\n\
+	--orbits          draw the orbit of every body\n\
+	--renderer NAME   fixed for the fixed-function pipeline, or core for\n\
+	                  shaders on OpenGL 3.3 core (fixed)\n\
+	--sim-thread      run the simulation on its own thread\n\
+	--date D          start at date D, YYYY-MM-DD[THH:MM] (2000-01-01T12:00)\n\
+	--time-scale X    simulated seconds per real second, negative to run\n\
+	                  backwards (a year per 3 s, about 1.05e7)\n\
+	--belt-count N    share N bodies among the belts, 0 for none (as listed\n\
+	                  in bodies.cfg)\n\
+	--gravity         move the bodies by their mutual gravity\n\
+	--swarm N         add N asteroids and comets to the gravity simulation\n\
+	--theta X         Barnes-Hut opening angle, smaller is exacter (0.5)\n\
+	--gravity-step D  longest gravity integration step in days (1)\n\
+	--bench           time --frames frames at every camera preset, headless\n\
+	--warmup N        untimed frames before each benchmark run (10)\n\
+	--body-count N    add generated planets up to N bodies\n\
+	--bench-async     time stages without waiting for the GL in between\n\
+	--bench-output F  write the benchmark JSON to F instead of stdout\n");
+}
+
+// Returns the value of the option at argv[*i] and steps past it.
+static const char *optionValue(int argc, char **argv, int *i) {
+	if (*i + 1 >= argc) {
+		printf("%s needs a value\n", argv[*i]);
+		return NULL;
+	}
+	return argv[++*i];
+}
+
+static bool parseDouble(const char *text, double *value) {
+	char *end;
+	*value = strtod(text, &end);
+	return end != text && *end == '\0';
+}
+
+static bool parsePositive(const char *text, int *value) {
+	char *end;
+	long v = strtol(text, &end, 10);
+	if (*text == '\0' || *end != '\0' || v <= 0 || v > 1 << 30)
+		return false;
+	*value = (int) v;
+	return true;
+}
+
+bool parseOptions(int argc, char **argv, Options *options) {
+	options->bodyFile = "bodies.cfg";
+	options->packFile = "textures.pack";
+	options->textureBudget = 2048;
+	options->starFile = "stars.cat";
+	options->starCount = 100000;
+	options->ephemeris = "ephemeris.eph";
+	options->headless = false;
+	options->width = 1000;
+	options->height = 800;
+	options->frames = 100;
+	options->camera = "perspective";
+	options->views = NULL;
+	options->outputDir = NULL;
+	options->capture = NULL;
+	options->stepsPerFrame = 1;
+	options->fps = 0.0;
+	options->lod = true;
+	options->coreProfile = false;
+	options->trails = false;
+	options->trailLength = 200;
+	options->orbits = false;
+	options->simThread = false;
+	options->startDays = 0.0;
+	options->timeScale = defaultTimeScale;
+	options->beltCount = -1;
+	options->gravity = false;
+	options->swarm = 0;
+	options->theta = 0.5;
+	options->gravityStep = 1.0;
+	options->bench = false;
+	options->warmupFrames = 10;
+	options->bodyCount = 0;
+	options->benchSync = true;
+	options->benchOutput = NULL;
+	options->glutArgs.assign(1, argv[0]);
+
+	bool haveBodyFile = false;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value;
+
+		if (strcmp(arg, "--help") == 0) {
+			optionsUsage();
+			exit(0);
+		} else if (strcmp(arg, "--headless") == 0) {
+			options->headless = true;
+		} else if (strcmp(arg, "--pack") == 0) {
+			if ((options->packFile = optionValue(argc, argv, &i)) == NULL)
+				return false;
+		} else if (strcmp(arg, "--texture-budget") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->textureBudget)) {
+				printf("Bad texture budget: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--stars") == 0) {
+			if ((options->starFile = optionValue(argc, argv, &i)) == NULL)
+				return false;
+		} else if (strcmp(arg, "--ephemeris") == 0) {
+			if ((options->ephemeris = optionValue(argc, argv, &i)) == NULL)
+				return false;
+		} else if (strcmp(arg, "--star-count") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (strcmp(value, "0") == 0)
+				options->starCount = 0;
+			else if (!parsePositive(value, &options->starCount)) {
+				printf("Bad star count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--frames") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->frames)) {
+				printf("Bad frame count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--camera") == 0) {
+			if ((options->camera = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (findCameraPreset(options->camera) == NULL) {
+				printf("Unknown camera preset: %s\n", options->camera);
+				return false;
+			}
+		} else if (strcmp(arg, "--views") == 0) {
+			if ((options->views = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			std::vector<Camera> cameras;
+			if (!parseViewCameras(options->views, cameras))
+				return false;
+		} else if (strcmp(arg, "--size") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (sscanf(value, "%dx%d", &options->width, &options->height) != 2
+					|| options->width <= 0 || options->height <= 0) {
+				printf("Bad size: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--output") == 0) {
+			if ((options->outputDir = optionValue(argc, argv, &i)) == NULL)
+				return false;
+		} else if (strcmp(arg, "--capture") == 0) {
+			if ((options->capture = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			options->headless = true;
+		} else if (strcmp(arg, "--fps") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parseDouble(value, &options->fps) || options->fps <= 0.0) {
+				printf("Bad frame rate: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--steps") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->stepsPerFrame)) {
+				printf("Bad step count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--no-lod") == 0) {
+			options->lod = false;
+		} else if (strcmp(arg, "--trails") == 0) {
+			options->trails = true;
+		} else if (strcmp(arg, "--trail-length") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->trailLength)
+					|| options->trailLength < 2) {
+				printf("Bad trail length: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--orbits") == 0) {
+			options->orbits = true;
+		} else if (strcmp(arg, "--renderer") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (strcmp(value, "core") == 0)
+				options->coreProfile = true;
+			else if (strcmp(value, "fixed") == 0)
+				options->coreProfile = false;
+			else {
+				printf("Unknown renderer: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--sim-thread") == 0) {
+			options->simThread = true;
+		} else if (strcmp(arg, "--date") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parseDate(value, &options->startDays)) {
+				printf("Bad date: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--time-scale") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parseDouble(value, &options->timeScale)) {
+				printf("Bad time scale: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--belt-count") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (strcmp(value, "0") == 0)
+				options->beltCount = 0;
+			else if (!parsePositive(value, &options->beltCount)) {
+				printf("Bad belt body count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--gravity") == 0) {
+			options->gravity = true;
+		} else if (strcmp(arg, "--swarm") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->swarm)) {
+				printf("Bad swarm size: %s\n", value);
+				return false;
+			}
+			options->gravity = true;
+		} else if (strcmp(arg, "--theta") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parseDouble(value, &options->theta) || options->theta < 0.0) {
+				printf("Bad opening angle: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--gravity-step") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parseDouble(value, &options->gravityStep)
+					|| options->gravityStep <= 0.0) {
+				printf("Bad gravity step: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--bench") == 0) {
+			options->bench = true;
+		} else if (strcmp(arg, "--warmup") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (strcmp(value, "0") == 0)
+				options->warmupFrames = 0;
+			else if (!parsePositive(value, &options->warmupFrames)) {
+				printf("Bad warmup frame count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--body-count") == 0) {
+			if ((value = optionValue(argc, argv, &i)) == NULL)
+				return false;
+			if (!parsePositive(value, &options->bodyCount)) {
+				printf("Bad body count: %s\n", value);
+				return false;
+			}
+		} else if (strcmp(arg, "--bench-async") == 0) {
+			options->benchSync = false;
+		} else if (strcmp(arg, "--bench-output") == 0) {
+			if ((options->benchOutput = optionValue(argc, argv, &i)) == NULL)
+				return false;
+		} else if (strncmp(arg, "--", 2) == 0) {
+			printf("Unknown option: %s\n", arg);
+			return false;
+		} else if (arg[0] == '-') {
+			// a GLUT option such as -display or -geometry, maybe with a value
+			options->glutArgs.push_back(argv[i]);
+			if ((strcmp(arg, "-display") == 0 || strcmp(arg, "-geometry") == 0)
+					&& i + 1 < argc)
+				options->glutArgs.push_back(argv[++i]);
+		} else if (!haveBodyFile) {
+			options->bodyFile = arg;
+			haveBodyFile = true;
+		} else {
+			printf("Unexpected argument: %s\n", arg);
+			return false;
+		}
+	}
+	options->glutArgs.push_back(NULL);
+	return true;
+}
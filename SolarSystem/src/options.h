@@ -0,0 +1,61 @@
+/* Command-line options. */
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <vector>
+
+struct Options {
+	const char *bodyFile;     // body table, see bodies.cfg
+	const char *packFile;     // texture pack used when present
+	int textureBudget;        // kilobytes of texture uploaded per frame
+	const char *starFile;     // star catalog used when present
+	int starCount;            // stars generated without a catalog
+	const char *ephemeris;    // body positions used when present
+
+	// offscreen rendering without a window system
+	bool headless;
+	int width, height;
+	int frames;
+	const char *camera;       // name of a camera preset
+	const char *views;        // split-screen cameras, NULL for one camera
+	const char *outputDir;    // where frames are written, NULL to discard
+	const char *capture;      // file pattern or "|command" for the frames
+	int stepsPerFrame;        // simulation steps between headless frames
+	double fps;               // headless frames per real second, 0 for steps
+	bool lod;                 // cull and simplify bodies by their screen size
+	bool coreProfile;         // draw with shaders in a GL 3.3 core context
+	bool trails;              // draw where the bodies have been
+	int trailLength;          // frames each trail covers
+	bool orbits;              // draw the bodies' orbits
+
+	bool simThread;           // step the simulation on its own thread
+	double startDays;         // start date, in days since J2000
+	double timeScale;         // simulated seconds per real second
+	int beltCount;            // belt bodies in all, -1 for bodies.cfg's
+
+	// N-body gravity instead of fixed orbits
+	bool gravity;
+	int swarm;                // asteroids and comets added to the bodies
+	double theta;             // Barnes-Hut opening angle
+	double gravityStep;       // longest integration step, in days
+
+	// headless benchmark over every camera preset
+	bool bench;
+	int warmupFrames;
+	int bodyCount;            // pad the table with generated bodies
+	bool benchSync;           // finish the GL work at every stage boundary
+	const char *benchOutput;  // JSON report, NULL for stdout
+
+	// arguments meant for glutInit
+	std::vector<char *> glutArgs;
+};
+
+// Fills in options from the command line. Arguments starting with a
+// single '-' are passed on to GLUT. Prints the problem and returns false
+// on a bad argument.
+bool parseOptions(int argc, char **argv, Options *options);
+
+void optionsUsage();
+
+#endif
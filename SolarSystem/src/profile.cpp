@@ -0,0 +1,149 @@
+/* Per-stage frame timing for the benchmark mode. */
+
+#include "profile.h"
+
+#include <GL/gl.h>
+#include <algorithm>
+#include <chrono>
+
+const char *const frameStageNames[STAGE_COUNT] = { "update", "setup",
+		"stars", "sun", "planets", "rings", "points", "trails", "swap" };
+
+typedef std::chrono::steady_clock Clock;
+
+static bool profiling = false;
+static bool profileSync = false;
+static FrameStage currentStage;
+static Clock::time_point frameStart, stageStart;
+static FrameTiming timing;
+
+void enableFrameProfile(bool sync) {
+	profiling = true;
+	profileSync = sync;
+}
+
+void disableFrameProfile() {
+	profiling = false;
+}
+
+void profileBeginFrame() {
+	if (!profiling)
+		return;
+	for (int i = 0; i < STAGE_COUNT; i++)
+		timing.stage[i] = 0.0;
+	currentStage = STAGE_UPDATE;
+	frameStart = stageStart = Clock::now();
+}
+
+// Charges the time since the last boundary to the current stage.
+static void closeStage(Clock::time_point now) {
+	timing.stage[currentStage] += std::chrono::duration<double, std::milli>(
+			now - stageStart).count();
+	stageStart = now;
+}
+
+void profileStage(FrameStage stage) {
+	if (!profiling || stage == currentStage)
+		return;
+	if (profileSync)
+		glFinish();
+	closeStage(Clock::now());
+	currentStage = stage;
+}
+
+FrameTiming profileEndFrame() {
+	if (profiling) {
+		if (profileSync)
+			glFinish();
+		Clock::time_point now = Clock::now();
+		closeStage(now);
+		timing.total = std::chrono::duration<double, std::milli>(
+				now - frameStart).count();
+	}
+	return timing;
+}
+
+// Nearest-rank percentile of sorted values.
+static double percentile(const std::vector<double> &sorted, double p) {
+	if (sorted.empty())
+		return 0.0;
+	size_t rank = (size_t) (p / 100.0 * sorted.size() + 0.999999);
+	rank = rank < 1 ? 1 : rank > sorted.size() ? sorted.size() : rank;
+	return sorted[rank - 1];
+}
+
+static void writeStats(FILE *file, std::vector<double> values) {
+	double sum = 0.0;
+	std::sort(values.begin(), values.end());
+	for (size_t i = 0; i < values.size(); i++)
+		sum += values[i];
+	fprintf(file, "{ \"min\": %.4f, \"mean\": %.4f, \"median\": %.4f, "
+			"\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+			values.empty() ? 0.0 : values.front(),
+			values.empty() ? 0.0 : sum / values.size(), percentile(values, 50),
+			percentile(values, 95), percentile(values, 99),
+			values.empty() ? 0.0 : values.back());
+}
+
+// Writes text as a JSON string, quoted and escaped.
+static void writeString(FILE *file, const char *text) {
+	fputc('"', file);
+	for (const unsigned char *c = (const unsigned char *) text; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(file, "\\u%04x", *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+void writeBenchJSON(FILE *file, const BenchInfo &info,
+		const std::vector<BenchRun> &runs) {
+	fprintf(file, "{\n");
+	fprintf(file, "  \"renderer\": ");
+	writeString(file, info.renderer);
+	fprintf(file, ",\n  \"pipeline\": ");
+	writeString(file, info.pipeline);
+	fprintf(file, ",\n");
+	fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", info.width,
+			info.height);
+	fprintf(file, "  \"warmup_frames\": %d,\n", info.warmupFrames);
+	fprintf(file, "  \"bodies\": %d,\n", info.bodyCount);
+	fprintf(file, "  \"belt_bodies\": %d,\n", info.beltBodyCount);
+	fprintf(file, "  \"stage_sync\": %s,\n", info.sync ? "true" : "false");
+	fprintf(file, "  \"runs\": [\n");
+	for (size_t r = 0; r < runs.size(); r++) {
+		const BenchRun &run = runs[r];
+		std::vector<double> values(run.frames.size());
+
+		fprintf(file, "    {\n      \"camera\": ");
+		writeString(file, run.camera);
+		fprintf(file, ",\n");
+		fprintf(file, "      \"frames\": %u,\n", (unsigned) run.frames.size());
+		for (size_t i = 0; i < run.frames.size(); i++)
+			values[i] = run.frames[i].total;
+		fprintf(file, "      \"frame_ms\": ");
+		writeStats(file, values);
+		fprintf(file, ",\n      \"stage_ms\": {\n");
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			for (size_t i = 0; i < run.frames.size(); i++)
+				values[i] = run.frames[i].stage[s];
+			fprintf(file, "        \"%s\": ", frameStageNames[s]);
+			writeStats(file, values);
+			fprintf(file, s + 1 < STAGE_COUNT ? ",\n" : "\n");
+		}
+		fprintf(file, "      },\n      \"state_changes\": {\n");
+		for (size_t i = 0; i < run.frames.size(); i++)
+			values[i] = run.frames[i].stateIssued;
+		fprintf(file, "        \"issued\": ");
+		writeStats(file, values);
+		for (size_t i = 0; i < run.frames.size(); i++)
+			values[i] = run.frames[i].stateElided;
+		fprintf(file, ",\n        \"elided\": ");
+		writeStats(file, values);
+		fprintf(file, "\n      }\n    }%s\n", r + 1 < runs.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+}
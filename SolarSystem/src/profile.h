@@ -0,0 +1,68 @@
+/* Per-stage frame timing for the benchmark mode. */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <vector>
+
+enum FrameStage {
+	STAGE_UPDATE,   // simulation steps and body positions for the frame
+	STAGE_SETUP,    // texture uploads, clear, views, lighting state
+	STAGE_STARS,    // star background
+	STAGE_SUN,
+	STAGE_PLANETS,  // every other sphere
+	STAGE_RINGS,
+	STAGE_POINTS,   // belts and free particles such as the gravity swarm
+	STAGE_TRAILS,   // orbits and trails
+	STAGE_SWAP,     // buffer swap up to the finished frame
+	STAGE_COUNT
+};
+
+extern const char *const frameStageNames[STAGE_COUNT];
+
+// Wall time spent in each stage of one frame, in milliseconds.
+struct FrameTiming {
+	double total;
+	double stage[STAGE_COUNT];
+	// GL state changes made and skipped as redundant, filled in by the
+	// caller
+	unsigned long stateIssued, stateElided;
+};
+
+// Starts timing. With sync every stage boundary waits for the GL to finish,
+// so work the driver defers (all rasterization, on llvmpipe) is charged to
+// the stage that issued it instead of the swap.
+void enableFrameProfile(bool sync);
+void disableFrameProfile();
+
+// Starts a frame in STAGE_UPDATE.
+void profileBeginFrame();
+// Ends the current stage and starts stage. Free when profiling is off.
+void profileStage(FrameStage stage);
+// Ends the frame and returns its timings.
+FrameTiming profileEndFrame();
+
+// Frame timings of one benchmark run, from one camera preset or the split
+// screen of --views.
+struct BenchRun {
+	const char *camera;
+	std::vector<FrameTiming> frames;
+};
+
+struct BenchInfo {
+	const char *renderer;
+	const char *pipeline;  // "fixed" or "core"
+	int width, height;
+	int warmupFrames;
+	int bodyCount;
+	int beltBodyCount;
+	bool sync;
+};
+
+// Writes min/median/p95/p99 frame times and per-stage statistics of every
+// run as JSON.
+void writeBenchJSON(FILE *file, const BenchInfo &info,
+		const std::vector<BenchRun> &runs);
+
+#endif
@@ -0,0 +1,51 @@
+/* Sorted submission of the meshes drawn each frame. */
+
+#include "renderqueue.h"
+
+#include <algorithm>
+
+#include "glstate.h"
+
+void RenderQueue::clear() {
+	items.clear();
+}
+
+void RenderQueue::add(FrameStage stage, GLuint texture,
+		const AtlasRect &textureRect, const Mesh &mesh,
+		const Matrix4 &transform) {
+	RenderItem item;
+	// 8 bits of stage, 12 of texture, 12 of the corner of the rectangle in
+	// it and 32 of mesh, told apart by its vertex buffer. Keys that collide
+	// only sort less well.
+	uint64_t corner = (uint64_t) (textureRect.t * 63.99f) << 6
+			| (uint64_t) (textureRect.s * 63.99f);
+	item.key = (uint64_t) stage << 56 | (uint64_t) (texture & 0xfff) << 44
+			| corner << 32 | mesh.vertexBuffer;
+	item.stage = stage;
+	item.texture = texture;
+	item.textureRect = textureRect;
+	item.mesh = &mesh;
+	item.transform = &transform;
+	items.push_back(item);
+}
+
+void RenderQueue::submit(const Matrix4 &view, bool wireframe) {
+	order.resize(items.size());
+	for (size_t i = 0; i < items.size(); i++)
+		order[i] = std::make_pair(items[i].key, (int) i);
+	// equal keys keep the order they were added in
+	std::sort(order.begin(), order.end());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const RenderItem &item = items[order[i].second];
+		profileStage(item.stage);
+		glState.bindTexture(item.texture);
+		glState.textureRect(item.textureRect);
+		Matrix4 modelView = matrixMultiply(view, *item.transform);
+		glLoadMatrixf(modelView.m);
+		drawMesh(*item.mesh);
+		if (wireframe)
+			drawMeshWireframe(*item.mesh);
+	}
+	glLoadMatrixf(view.m);
+}
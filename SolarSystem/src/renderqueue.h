@@ -0,0 +1,55 @@
+/* Sorted submission of the meshes drawn each frame.
+ *
+ * The renderer records an item per body instead of drawing it on the spot.
+ * Each item carries a sort key made of, from the most significant bits
+ * down, its frame stage (which also stands for its pipeline state), its
+ * texture, its place in the texture and its mesh. Sorting groups the items
+ * that share state, and the state cache then drops the binds between them.
+ * Each item's model matrix comes finished from the scene graph and is
+ * loaded with the view in one call, so the matrix stack is never touched.
+ */
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "atlas.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "profile.h"
+
+struct RenderItem {
+	uint64_t key;
+	FrameStage stage;
+	GLuint texture;
+	AtlasRect textureRect;
+	const Mesh *mesh;
+	const Matrix4 *transform;  // model matrix, owned by the caller
+};
+
+class RenderQueue {
+public:
+	void clear();
+
+	// transform must stay put until submit.
+	void add(FrameStage stage, GLuint texture, const AtlasRect &textureRect,
+			const Mesh &mesh, const Matrix4 &transform);
+
+	// Draws every item in key order, charging each to its stage, and with
+	// the wireframe overlay if asked. Leaves view in the modelview matrix.
+	void submit(const Matrix4 &view, bool wireframe);
+
+	size_t size() const {
+		return items.size();
+	}
+
+private:
+	std::vector<RenderItem> items;
+	// key and index of every item, sorted by submit
+	std::vector<std::pair<uint64_t, int> > order;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/* World transforms of every body. */
+
+#include "scenegraph.h"
+
+#include <cmath>
+
+typedef float float4 __attribute__((vector_size(16)));
+typedef int int4 __attribute__((vector_size(16)));
+
+void updateWorldTransforms(const BodyTable &table, const BodyState &state,
+		std::vector<Matrix4> &world) {
+	const int n = table.count;
+	world.resize(n);
+	const float radians = (float) M_PI / 180.0f;
+	for (int i = 0; i < n; i += 4) {
+		const int lanes = n - i < 4 ? n - i : 4;
+		// the missing lanes of the last block are never stored
+		float4 w = { 1, 1, 1, 1 }, x = { 0, 0, 0, 0 }, y = x, z = x;
+		float4 c = w, s = x, scale = w;
+		int4 ring = { 0, 0, 0, 0 };
+		for (int l = 0; l < lanes; l++) {
+			const Quaternion &q = table.frame[i + l];
+			w[l] = q.w;
+			x[l] = q.x;
+			y[l] = q.y;
+			z[l] = q.z;
+			float angle = (state.yearAngle[i + l] + state.dayAngle[i + l])
+					* radians;
+			c[l] = cosf(angle);
+			s[l] = sinf(angle);
+			scale[l] = table.radius[i + l];
+			ring[l] = table.shape[i + l] == SHAPE_RING ? -1 : 0;
+		}
+
+		// the columns of the frame's rotation
+		const float4 r0x = 1.0f - 2.0f * (y * y + z * z);
+		const float4 r0y = 2.0f * (x * y + w * z);
+		const float4 r0z = 2.0f * (x * z - w * y);
+		const float4 r1x = 2.0f * (x * y - w * z);
+		const float4 r1y = 1.0f - 2.0f * (x * x + z * z);
+		const float4 r1z = 2.0f * (y * z + w * x);
+		const float4 r2x = 2.0f * (x * z + w * y);
+		const float4 r2y = 2.0f * (y * z - w * x);
+		const float4 r2z = 1.0f - 2.0f * (x * x + y * y);
+
+		// turned about the body's own y
+		const float4 a0x = c * r0x - s * r2x, a0y = c * r0y - s * r2y,
+				a0z = c * r0z - s * r2z;
+		const float4 a2x = s * r0x + c * r2x, a2y = s * r0y + c * r2y,
+				a2z = s * r0z + c * r2z;
+
+		// rings are meshed in the x-y plane and lie in the x-z one, so
+		// their y and z columns become z and -y
+		const float4 m0x = scale * a0x, m0y = scale * a0y, m0z = scale * a0z;
+		const float4 m1x = scale * (ring ? a2x : r1x);
+		const float4 m1y = scale * (ring ? a2y : r1y);
+		const float4 m1z = scale * (ring ? a2z : r1z);
+		const float4 m2x = scale * (ring ? -r1x : a2x);
+		const float4 m2y = scale * (ring ? -r1y : a2y);
+		const float4 m2z = scale * (ring ? -r1z : a2z);
+
+		for (int l = 0; l < lanes; l++) {
+			float *m = world[i + l].m;
+			m[0] = m0x[l];
+			m[1] = m0y[l];
+			m[2] = m0z[l];
+			m[3] = 0.0f;
+			m[4] = m1x[l];
+			m[5] = m1y[l];
+			m[6] = m1z[l];
+			m[7] = 0.0f;
+			m[8] = m2x[l];
+			m[9] = m2y[l];
+			m[10] = m2z[l];
+			m[11] = 0.0f;
+			m[12] = state.x[i + l];
+			m[13] = state.y[i + l];
+			m[14] = state.z[i + l];
+			m[15] = 1.0f;
+		}
+	}
+}
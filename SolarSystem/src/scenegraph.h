@@ -0,0 +1,25 @@
+/* World transforms of every body.
+ *
+ * The body table is the scene graph: a flat array of nodes, each naming
+ * its parent, with parents first. Positions are already resolved down the
+ * graph by updateBodies and orientations by the loader, so one linear pass
+ * composes each body's model matrix from them, four bodies at a time with
+ * GCC vector extensions. The renderer then loads the finished matrices
+ * instead of building them on the matrix stack call by call.
+ */
+
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <vector>
+
+#include "bodies.h"
+#include "matrix.h"
+
+// Fills world with the model matrix of every body of state: its mesh
+// scaled by the radius, laid flat for rings, turned by its orbit and spin
+// about its own axis, tilted into its frame and moved to its position.
+void updateWorldTransforms(const BodyTable &table, const BodyState &state,
+		std::vector<Matrix4> &world);
+
+#endif
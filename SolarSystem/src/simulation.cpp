@@ -0,0 +1,258 @@
+/* Fixed-timestep simulation of the body table. */
+
+#include "simulation.h"
+
+#include <cmath>
+#include <cstdio>
+
+// Further behind than this (a stopped debugger, a dragged window) the clock
+// skips ahead instead of running every missed step at once.
+static const int maxCatchUpSteps = 60;
+
+Simulation::Simulation(const BodyTable &table, double stepSeconds) :
+		table(table),
+		stepLength(std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(stepSeconds))),
+		previousDays(0.0), currentDays(0.0), steps(0), gravity(NULL),
+		solveBelts(true), scale(defaultTimeScale),
+		paused(false), stopping(false) {
+	reset();
+}
+
+Simulation::~Simulation() {
+	stopThread();
+}
+
+void Simulation::reset(double days) {
+	std::lock_guard<std::mutex> stepLock(stepMutex);
+	if (gravity != NULL)
+		gravity->reset(days);
+	computeState(days, next);
+	std::lock_guard<std::mutex> lock(mutex);
+	previous = next;
+	current = next;
+	previousDays = currentDays = days;
+	steps = 0;
+	origin = Clock::now();
+}
+
+void Simulation::setGravity(Gravity *newGravity) {
+	std::lock_guard<std::mutex> stepLock(stepMutex);
+	gravity = newGravity;
+}
+
+void Simulation::setSolveBelts(bool solve) {
+	std::lock_guard<std::mutex> stepLock(stepMutex);
+	solveBelts = solve;
+	if (solve)
+		return;
+	next.belt.clear();
+	std::lock_guard<std::mutex> lock(mutex);
+	previous.belt.clear();
+	current.belt.clear();
+}
+
+double Simulation::stepDays() const {
+	if (paused)
+		return 0.0;
+	return scale * std::chrono::duration<double>(stepLength).count() / 86400.0;
+}
+
+void Simulation::computeState(double days, BodyState &state) {
+	updateBodies(table, days, state);
+	if (gravity != NULL) {
+		gravity->advanceTo(days);
+		gravity->writeState(table, state);
+	}
+	// after the gravity, so that the belts follow their parents
+	if (solveBelts)
+		updateBelts(table, days, state);
+}
+
+void Simulation::runStep() {
+	double days;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		days = currentDays + stepDays();
+	}
+	computeState(days, next);
+	std::lock_guard<std::mutex> lock(mutex);
+	std::swap(previous, current);
+	std::swap(current, next);
+	previousDays = currentDays;
+	currentDays = days;
+	steps++;
+}
+
+void Simulation::step(int count) {
+	std::lock_guard<std::mutex> stepLock(stepMutex);
+	for (int i = 0; i < count; i++)
+		runStep();
+}
+
+long Simulation::stepsDue(Clock::time_point now) {
+	long due = (long) ((now - origin) / stepLength);
+	if (due - steps > maxCatchUpSteps) {
+		origin += (due - steps - maxCatchUpSteps) * stepLength;
+		due = steps + maxCatchUpSteps;
+	}
+	return due;
+}
+
+void Simulation::catchUp() {
+	long due, done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		due = stepsDue(Clock::now());
+		done = steps;
+	}
+	if (due > done)
+		step((int) (due - done));
+}
+
+void Simulation::startThread() {
+	if (worker.joinable())
+		return;
+	stopping = false;
+	worker = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stopThread() {
+	if (!worker.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	worker.join();
+}
+
+void Simulation::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopping) {
+		if (stepsDue(Clock::now()) <= steps) {
+			wake.wait_until(lock, origin + (steps + 1) * stepLength);
+			continue;
+		}
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> stepLock(stepMutex);
+			runStep();
+		}
+		lock.lock();
+	}
+}
+
+float Simulation::blendNow() {
+	std::lock_guard<std::mutex> lock(mutex);
+	// the frame shows the clock one step late, so that the state it blends
+	// towards has already been computed
+	double blend = std::chrono::duration<double>(Clock::now() - origin)
+			/ stepLength - steps;
+	return blend < 0.0 ? 0.0f : blend > 1.0 ? 1.0f : (float) blend;
+}
+
+double Simulation::interpolate(float blend, BodyState &out) {
+	std::lock_guard<std::mutex> lock(mutex);
+	interpolateBodies(previous, current, blend, out);
+	return previousDays + (currentDays - previousDays) * blend;
+}
+
+double Simulation::stepSeconds() const {
+	return std::chrono::duration<double>(stepLength).count();
+}
+
+double Simulation::time() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return currentDays;
+}
+
+void Simulation::setTimeScale(double newScale) {
+	std::lock_guard<std::mutex> lock(mutex);
+	scale = newScale;
+}
+
+double Simulation::timeScale() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return scale;
+}
+
+void Simulation::setPaused(bool pause) {
+	std::lock_guard<std::mutex> lock(mutex);
+	paused = pause;
+}
+
+bool Simulation::isPaused() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return paused;
+}
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+static long daysFromCivil(long y, unsigned m, unsigned d) {
+	y -= m <= 2;
+	long era = (y >= 0 ? y : y - 399) / 400;
+	unsigned yoe = (unsigned) (y - era * 400);
+	unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (long) doe - 719468;
+}
+
+// The inverse of daysFromCivil.
+static void civilFromDays(long z, long *y, unsigned *m, unsigned *d) {
+	z += 719468;
+	long era = (z >= 0 ? z : z - 146096) / 146097;
+	unsigned doe = (unsigned) (z - era * 146097);
+	unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp < 10 ? mp + 3 : mp - 9;
+	*y = (long) yoe + era * 400 + (*m <= 2);
+}
+
+// The number of days in month of the proleptic Gregorian year.
+static unsigned daysInMonth(long year, unsigned month) {
+	static const unsigned days[12] = {
+		31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+	return days[month - 1] + (month == 2 && leap ? 1 : 0);
+}
+
+// 2000-01-01 12:00 counted from 1970-01-01 00:00.
+static const double j2000 = 10957.5;
+
+bool parseDate(const char *text, double *days) {
+	long year;
+	unsigned month, day, hour = 0, minute = 0;
+	int length = 0, timeLength = 0;
+	if (sscanf(text, "%ld-%u-%u%n", &year, &month, &day, &length) != 3)
+		return false;
+	if (text[length] == 'T'
+			&& sscanf(text + length, "T%u:%u%n", &hour, &minute,
+					&timeLength) == 2)
+		length += timeLength;
+	// nothing may follow, and the day must be in the month
+	if (text[length] != '\0' || month < 1 || month > 12 || day < 1
+			|| day > daysInMonth(year, month) || hour > 23 || minute > 59)
+		return false;
+	*days = daysFromCivil(year, month, day) - j2000
+			+ (hour * 60 + minute) / 1440.0;
+	return true;
+}
+
+void formatDate(double days, char *text, size_t size) {
+	double unixDays = days + j2000;
+	long whole = (long) floor(unixDays);
+	long minutes = (long) floor((unixDays - whole) * 1440.0 + 0.5);
+	if (minutes == 1440) {
+		whole++;
+		minutes = 0;
+	}
+	long year;
+	unsigned month, day;
+	civilFromDays(whole, &year, &month, &day);
+	snprintf(text, size, "%04ld-%02u-%02u %02ld:%02ld", year, month, day,
+			minutes / 60, minutes % 60);
+}
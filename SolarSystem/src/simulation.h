@@ -0,0 +1,130 @@
+/* Fixed-timestep simulation of the body table.
+ *
+ * Simulated time is a double count of days since J2000 (2000-01-01 12:00),
+ * and every body's state is evaluated in closed form at a given time, so
+ * jumping to any date costs the same as one step. Real time advances the
+ * clock in steps of a fixed length, each covering the real step length
+ * times the time scale of simulated time; the scale may be negative to run
+ * backwards, and pausing holds the clock where it is.
+ *
+ * The two most recent states are kept, and a frame shows the bodies
+ * blended between them at the time it is drawn, so a slow or uneven
+ * display rate neither slows the motion down nor makes it jitter. Steps
+ * due in real time are either run by the renderer before each frame
+ * (catchUp) or by a thread of their own (startThread); batch jobs call
+ * step directly and run as fast as the machine allows.
+ *
+ * With a Gravity attached the positions come from integrating the motion
+ * instead, step by step; jumps put every body back on its orbit.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bodies.h"
+#include "gravity.h"
+
+// Simulated seconds per real second at which the original animation ran:
+// a year of the Earth in three seconds.
+const double defaultTimeScale = 365.25 * 86400.0 / 3.0;
+
+class Simulation {
+public:
+	// The table must outlive the simulation and stay unchanged while it
+	// runs. One step of the original animation took 1/60 s.
+	explicit Simulation(const BodyTable &table,
+			double stepSeconds = 1.0 / 60.0);
+	~Simulation();
+
+	// Jumps to days since J2000 and restarts the real-time clock. The jump
+	// is not blended.
+	void reset(double days = 0.0);
+
+	// Takes positions from gravity, which must outlive the simulation, from
+	// the next reset on. NULL goes back to the orbits.
+	void setGravity(Gravity *gravity);
+
+	// Whether steps solve the belt bodies, as they do by default. A
+	// renderer that places them itself turns this off.
+	void setSolveBelts(bool solve);
+
+	// Runs count steps now, whatever the clock says.
+	void step(int count = 1);
+
+	// Runs the steps that are due by now on the calling thread.
+	void catchUp();
+
+	// Runs the steps on a thread of their own, in real time, until
+	// stopThread.
+	void startThread();
+	void stopThread();
+
+	// How far the clock is between the last two states, from 0 to 1.
+	float blendNow();
+
+	// Writes the bodies at blend between the last two states into out and
+	// returns the days since J2000 they stand for.
+	double interpolate(float blend, BodyState &out);
+
+	// Days since J2000 of the latest state.
+	double time();
+
+	// Real seconds of one step.
+	double stepSeconds() const;
+
+	// Simulated seconds per real second; negative runs backwards. Takes
+	// effect from the next step.
+	void setTimeScale(double scale);
+	double timeScale();
+	void setPaused(bool paused);
+	bool isPaused();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// Days the next step covers; needs the mutex.
+	double stepDays() const;
+	// Fills state for days; needs stepMutex.
+	void computeState(double days, BodyState &state);
+	// Runs one step; needs stepMutex.
+	void runStep();
+	void run();
+	// Steps the clock says should have run by now; needs the mutex.
+	long stepsDue(Clock::time_point now);
+
+	const BodyTable &table;
+	const Clock::duration stepLength;
+	Clock::time_point origin;   // real time of step 0
+
+	// previous and current are read by the renderer under the mutex; next
+	// and the gravity belong to whoever holds stepMutex.
+	BodyState previous, current, next;
+	double previousDays, currentDays;
+	long steps;
+	Gravity *gravity;
+	bool solveBelts;
+
+	double scale;
+	bool paused;
+
+	std::thread worker;
+	// taken before mutex by anything that computes a state
+	std::mutex stepMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+};
+
+// Reads a date as YYYY-MM-DD or YYYY-MM-DDTHH:MM (UTC) into days since
+// J2000. Returns false if text is not such a date.
+bool parseDate(const char *text, double *days);
+
+// Writes days since J2000 as YYYY-MM-DD HH:MM.
+void formatDate(double days, char *text, size_t size);
+
+#endif
@@ -0,0 +1,91 @@
+/* Star catalog: the background stars, one fixed-size record each. */
+
+#include "starcatalog.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// the records are read in place from the mapped file
+static_assert(sizeof(StarCatalogHeader) == 16, "StarCatalogHeader layout");
+static_assert(sizeof(StarRecord) == 16, "StarRecord layout");
+
+bool openStarCatalog(const char *filename, StarCatalog *catalog) {
+	FILE *probe = fopen(filename, "rb");
+	if (probe == NULL)
+		return false;
+	fclose(probe);
+	if (!mapFile(filename, &catalog->file, true)) {
+		printf("Cannot read %s\n", filename);
+		return false;
+	}
+
+	const char *base = (const char *) catalog->file.data;
+	catalog->header = (const StarCatalogHeader *) base;
+	if (catalog->file.size < sizeof(StarCatalogHeader)
+			|| memcmp(catalog->header->magic, STARCAT_MAGIC, 4) != 0
+			|| catalog->header->version != STARCAT_VERSION) {
+		printf("%s is not a version %d star catalog\n", filename,
+				STARCAT_VERSION);
+		closeStarCatalog(catalog);
+		return false;
+	}
+	if ((catalog->file.size - sizeof(StarCatalogHeader)) / sizeof(StarRecord)
+			< catalog->header->starCount) {
+		printf("%s is truncated\n", filename);
+		closeStarCatalog(catalog);
+		return false;
+	}
+	catalog->stars = (const StarRecord *) (base + sizeof(StarCatalogHeader));
+	return true;
+}
+
+void closeStarCatalog(StarCatalog *catalog) {
+	unmapFile(&catalog->file);
+	catalog->header = NULL;
+	catalog->stars = NULL;
+}
+
+// Galactic to J2000 equatorial axes: column i is galactic axis i.
+static const double galacticToEquatorial[3][3] = {
+	{ -0.0548755604, 0.4941094279, -0.8676661490 },
+	{ -0.8734370902, -0.4448296300, -0.1980763734 },
+	{ -0.4838350155, 0.7469822445, 0.4559837762 }
+};
+
+void generateStars(int count, unsigned seed, std::vector<StarRecord> &stars) {
+	stars.resize(count > 0 ? count : 0);
+	// there are about 5000 stars to magnitude 6, and each magnitude holds
+	// 10^0.45 times as many as the one before
+	const double faintest = 6.0 + log10(count / 5000.0) / 0.45;
+	for (int i = 0; i < count; i++) {
+		// a small linear congruential generator keeps runs reproducible
+		double r[8];
+		for (int k = 0; k < 8; k++) {
+			seed = seed * 1664525u + 1013904223u;
+			r[k] = ((seed >> 8) + 0.5) / (double) (1 << 24);
+		}
+		// three in five lie near the galactic plane, normally spread by 15
+		// degrees; the rest anywhere
+		double gauss = sqrt(-2.0 * log(r[1])) * cos(2.0 * M_PI * r[2]);
+		double sinB = r[0] < 0.6 ? sin(gauss * 15.0 * M_PI / 180.0)
+				: 2.0 * r[5] - 1.0;
+		double cosB = sqrt(1.0 - sinB * sinB);
+		double l = 2.0 * M_PI * r[3];
+		double galactic[3] = { cosB * cos(l), cosB * sin(l), sinB };
+		double e[3];
+		for (int row = 0; row < 3; row++)
+			e[row] = galacticToEquatorial[row][0] * galactic[0]
+					+ galacticToEquatorial[row][1] * galactic[1]
+					+ galacticToEquatorial[row][2] * galactic[2];
+
+		StarRecord &star = stars[i];
+		star.rightAscension = (float) atan2(e[1], e[0]);
+		star.declination = (float) asin(fmax(-1.0, fmin(1.0, e[2])));
+		star.magnitude = (float) fmax(-1.5, faintest + log10(r[4]) / 0.45);
+		// mostly white to yellow, a few blue and more red
+		double index = 0.7
+				+ 0.45 * sqrt(-2.0 * log(r[6])) * cos(2.0 * M_PI * r[7]);
+		star.colorIndex = (float) fmax(-0.4, fmin(2.0, index));
+	}
+}
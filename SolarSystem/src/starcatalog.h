@@ -0,0 +1,54 @@
+/* Star catalog: the background stars, one fixed-size record each.
+ *
+ * Layout, little endian:
+ *   StarCatalogHeader
+ *   StarRecord[starCount]
+ *
+ * The positions are J2000 equatorial, as in Hipparcos, and the records
+ * are read in place from the mapped file; see tools/starcat.cpp for the
+ * writer. Without a catalog a sky of the same form is generated.
+ */
+
+#ifndef STARCATALOG_H
+#define STARCATALOG_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "mappedfile.h"
+
+#define STARCAT_MAGIC "STCT"
+#define STARCAT_VERSION 1
+
+struct StarCatalogHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t starCount;
+	uint32_t reserved;
+};
+
+struct StarRecord {
+	float rightAscension;  // radians
+	float declination;     // radians
+	float magnitude;       // visual
+	float colorIndex;      // B-V
+};
+
+struct StarCatalog {
+	MappedFile file;
+	const StarCatalogHeader *header;
+	const StarRecord *stars;
+};
+
+// Maps a catalog and checks that its records lie inside the file. Returns
+// false, printing the reason unless the file is missing, if they do not.
+bool openStarCatalog(const char *filename, StarCatalog *catalog);
+
+void closeStarCatalog(StarCatalog *catalog);
+
+// Generates count stars drawn from seed: magnitudes that grow more
+// numerous towards the faint end as in the real sky, ending where count
+// stars are reached, crowded towards the plane of the Milky Way.
+void generateStars(int count, unsigned seed, std::vector<StarRecord> &stars);
+
+#endif
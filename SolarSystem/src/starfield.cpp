@@ -0,0 +1,155 @@
+/* The star background. */
+
+#include "starfield.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+#include "glstate.h"
+#include "mesh.h"
+#include "starcatalog.h"
+
+// Stars at least this bright are drawn at full intensity.
+static const float fullMagnitude = 1.0f;
+// Upper magnitude bounds of the point sizes but the last.
+static const float sizeMagnitudes[starSizeCount - 1] = { 0.5f, 2.5f };
+// Obliquity of the ecliptic at J2000, in radians.
+static const double obliquity = 23.4392911 * M_PI / 180.0;
+
+// Colour of a star with colour index B-V, from blue-white to red.
+static void starColor(float colorIndex, float rgb[3]) {
+	static const float index[] = { -0.4f, 0.0f, 0.4f, 0.8f, 1.4f, 2.0f };
+	static const float colors[][3] = {
+		{ 0.62f, 0.70f, 1.00f }, { 0.80f, 0.85f, 1.00f },
+		{ 1.00f, 1.00f, 1.00f }, { 1.00f, 0.93f, 0.80f },
+		{ 1.00f, 0.78f, 0.55f }, { 1.00f, 0.62f, 0.40f }
+	};
+	const int n = sizeof(index) / sizeof(index[0]);
+	int k = 0;
+	while (k < n - 2 && colorIndex > index[k + 1])
+		k++;
+	float t = (colorIndex - index[k]) / (index[k + 1] - index[k]);
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	for (int c = 0; c < 3; c++)
+		rgb[c] = colors[k][c] + (colors[k + 1][c] - colors[k][c]) * t;
+}
+
+static int sizeOf(float magnitude) {
+	int k = 0;
+	while (k < starSizeCount - 1 && magnitude >= sizeMagnitudes[k])
+		k++;
+	return k;
+}
+
+static StarVertex starVertex(const StarRecord &star) {
+	// J2000 equatorial to ecliptic, then ecliptic (X, Y, Z) to scene
+	// (X, Z, -Y) as the orbits have it
+	double cosDec = cos(star.declination);
+	double x = cosDec * cos(star.rightAscension);
+	double y = cosDec * sin(star.rightAscension);
+	double z = sin(star.declination);
+	double eclipticY = y * cos(obliquity) + z * sin(obliquity);
+	double eclipticZ = -y * sin(obliquity) + z * cos(obliquity);
+
+	// the eye sees faint stars less dimmed than their light, so the
+	// intensity falls by only 10^0.16 per magnitude
+	float intensity = powf(10.0f, -0.16f * (star.magnitude - fullMagnitude));
+	intensity = intensity > 1.0f ? 1.0f : intensity;
+	float rgb[3];
+	starColor(star.colorIndex, rgb);
+
+	StarVertex vertex;
+	vertex.x = (GLfloat) x;
+	vertex.y = (GLfloat) eclipticZ;
+	vertex.z = (GLfloat) -eclipticY;
+	vertex.w = 0.0f;
+	vertex.r = (GLubyte) (255.0f * rgb[0] * intensity + 0.5f);
+	vertex.g = (GLubyte) (255.0f * rgb[1] * intensity + 0.5f);
+	vertex.b = (GLubyte) (255.0f * rgb[2] * intensity + 0.5f);
+	vertex.a = 255;
+	return vertex;
+}
+
+void createStarField(const char *catalogFile, int count, StarField &field) {
+	StarCatalog catalog;
+	std::vector<StarRecord> generated;
+	const StarRecord *stars;
+	bool haveCatalog = catalogFile != NULL
+			&& openStarCatalog(catalogFile, &catalog);
+	if (haveCatalog) {
+		stars = catalog.stars;
+		count = (int) catalog.header->starCount;
+		printf("Read %d stars from %s\n", count, catalogFile);
+	} else {
+		generateStars(count, 1, generated);
+		stars = generated.empty() ? NULL : &generated[0];
+	}
+
+	// sorted by size in two passes over the records, which are read in
+	// place
+	int sizes[starSizeCount] = { 0 };
+	for (int i = 0; i < count; i++)
+		sizes[sizeOf(stars[i].magnitude)]++;
+	int next[starSizeCount];
+	for (int k = 0, first = 0; k < starSizeCount; k++) {
+		field.first[k] = next[k] = first;
+		field.count[k] = sizes[k];
+		first += sizes[k];
+	}
+	std::vector<StarVertex> vertices(count);
+	for (int i = 0; i < count; i++)
+		vertices[next[sizeOf(stars[i].magnitude)]++] = starVertex(stars[i]);
+	if (haveCatalog)
+		closeStarCatalog(&catalog);
+
+	field.buffer = 0;
+	if (count == 0)
+		return;
+	glGenBuffers(1, &field.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, field.buffer);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(StarVertex), &vertices[0],
+			GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// bound behind the cache's back
+	glState.invalidate();
+}
+
+void drawStarField(const StarField &field) {
+	if (field.buffer == 0)
+		return;
+	glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_DEPTH_CLAMP);
+
+	glState.bindBuffer(GL_ARRAY_BUFFER, field.buffer);
+	glState.clientState(GL_VERTEX_ARRAY, true);
+	glState.clientState(GL_NORMAL_ARRAY, false);
+	glState.clientState(GL_TEXTURE_COORD_ARRAY, false);
+	glState.clientState(GL_COLOR_ARRAY, true);
+	// set every time: the meshes and points share the pointers
+	glVertexPointer(4, GL_FLOAT, sizeof(StarVertex),
+			(const GLvoid *) offsetof(StarVertex, x));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(StarVertex),
+			(const GLvoid *) offsetof(StarVertex, r));
+	for (int k = 0; k < starSizeCount; k++) {
+		if (field.count[k] == 0)
+			continue;
+		glPointSize(starPointSizes[k]);
+		glDrawArrays(GL_POINTS, field.first[k], field.count[k]);
+		meshStats.drawCalls++;
+		meshStats.indices += field.count[k];
+	}
+	glPopAttrib();
+}
+
+void deleteStarField(StarField &field) {
+	if (field.buffer != 0)
+		glDeleteBuffers(1, &field.buffer);
+	field.buffer = 0;
+	glState.invalidate();
+}
@@ -0,0 +1,44 @@
+/* The star background.
+ *
+ * Every star of the catalog becomes a point at infinity, a direction with
+ * w = 0, so that the camera's position never moves it and only its turn
+ * does. The points are uploaded once into a static vertex buffer, sorted
+ * by the size their magnitude gives them, and drawn first each frame with
+ * depth clamping, so that the far plane cannot clip them, and without
+ * depth writes, so that everything drawn later covers them.
+ */
+
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// One star as the vertex buffer holds it.
+struct StarVertex {
+	GLfloat x, y, z, w;  // direction in scene coordinates, w = 0
+	GLubyte r, g, b, a;  // colour, dimmed by the magnitude
+};
+
+// Point sizes in pixels, brightest stars first.
+const int starSizeCount = 3;
+const GLfloat starPointSizes[starSizeCount] = { 3.0f, 2.0f, 1.0f };
+
+struct StarField {
+	GLuint buffer;
+	// the stars drawn at starPointSizes[k] lie from first[k] on
+	int first[starSizeCount], count[starSizeCount];
+};
+
+// Reads the stars of catalogFile, or generates count of them if it does
+// not exist, and uploads them. Needs a current GL context.
+void createStarField(const char *catalogFile, int count, StarField &field);
+
+// Draws the stars with the fixed-function pipeline, under the current
+// modelview matrix.
+void drawStarField(const StarField &field);
+
+void deleteStarField(StarField &field);
+
+#endif
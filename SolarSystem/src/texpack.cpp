@@ -0,0 +1,115 @@
+/* Pre-baked texture pack: every texture of the scene in one file. */
+
+#include "texpack.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// the tables are read in place from the mapped file
+static_assert(sizeof(TexPackHeader) == 16, "TexPackHeader layout");
+static_assert(sizeof(TexPackEntry) == 128, "TexPackEntry layout");
+static_assert(sizeof(TexPackLevel) == 24, "TexPackLevel layout");
+
+uint64_t texPackLevelSize(uint32_t format, uint32_t width, uint32_t height) {
+	if (format == TEXPACK_DXT1)
+		return (uint64_t) ((width + 3) / 4) * ((height + 3) / 4) * 8;
+	return (uint64_t) width * height * 3;
+}
+
+static bool fits(const MappedFile &file, uint64_t offset, uint64_t size) {
+	return offset <= file.size && size <= file.size - offset;
+}
+
+bool openTexPack(const char *filename, TexPack *pack) {
+	if (!mapFile(filename, &pack->file, true))
+		return false;
+
+	const char *base = (const char *) pack->file.data;
+	pack->header = (const TexPackHeader *) base;
+	if (!fits(pack->file, 0, sizeof(TexPackHeader))
+			|| memcmp(pack->header->magic, TEXPACK_MAGIC, 4) != 0
+			|| pack->header->version != TEXPACK_VERSION) {
+		printf("%s is not a version %d texture pack\n", filename,
+				TEXPACK_VERSION);
+		closeTexPack(pack);
+		return false;
+	}
+
+	uint64_t entryOffset = sizeof(TexPackHeader);
+	uint64_t levelOffset = entryOffset
+			+ (uint64_t) pack->header->entryCount * sizeof(TexPackEntry);
+	if (!fits(pack->file, entryOffset,
+			(uint64_t) pack->header->entryCount * sizeof(TexPackEntry))
+			|| !fits(pack->file, levelOffset,
+					(uint64_t) pack->header->levelCount * sizeof(TexPackLevel))) {
+		printf("%s is truncated\n", filename);
+		closeTexPack(pack);
+		return false;
+	}
+	pack->entries = (const TexPackEntry *) (base + entryOffset);
+	pack->levels = (const TexPackLevel *) (base + levelOffset);
+
+	for (uint32_t i = 0; i < pack->header->entryCount; i++) {
+		const TexPackEntry &entry = pack->entries[i];
+		bool ok = memchr(entry.name, '\0', sizeof(entry.name)) != NULL
+				&& (entry.format == TEXPACK_RGB8 || entry.format == TEXPACK_DXT1)
+				&& entry.levelCount > 0
+				&& entry.firstLevel <= pack->header->levelCount
+				&& entry.levelCount <= pack->header->levelCount - entry.firstLevel;
+		for (uint32_t j = 0; ok && j < entry.levelCount; j++) {
+			const TexPackLevel &level = pack->levels[entry.firstLevel + j];
+			ok = level.size == texPackLevelSize(entry.format, level.width,
+					level.height) && fits(pack->file, level.offset, level.size);
+		}
+		if (!ok) {
+			printf("%s: entry %u is corrupt\n", filename, i);
+			closeTexPack(pack);
+			return false;
+		}
+	}
+	return true;
+}
+
+void closeTexPack(TexPack *pack) {
+	unmapFile(&pack->file);
+	pack->header = NULL;
+	pack->entries = NULL;
+	pack->levels = NULL;
+}
+
+const TexPackEntry *findTexPackEntry(const TexPack &pack, const char *name) {
+	for (uint32_t i = 0; i < pack.header->entryCount; i++)
+		if (strcmp(pack.entries[i].name, name) == 0)
+			return &pack.entries[i];
+	return NULL;
+}
+
+// Expands an RGB565 colour to 8 bits a channel.
+static void expand565(unsigned color, float rgb[3]) {
+	rgb[0] = (float) ((color >> 11) & 31) * 255.0f / 31.0f;
+	rgb[1] = (float) ((color >> 5) & 63) * 255.0f / 63.0f;
+	rgb[2] = (float) (color & 31) * 255.0f / 31.0f;
+}
+
+void decodeDXT1Block(const unsigned char *block, unsigned char rgb[16][3]) {
+	unsigned color0 = block[0] | block[1] << 8;
+	unsigned color1 = block[2] | block[3] << 8;
+	float palette[4][3];
+	expand565(color0, palette[0]);
+	expand565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		if (color0 > color1) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		} else {
+			// the three colour mode; the fourth is transparent black
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+			palette[3][c] = 0.0f;
+		}
+	}
+	for (int i = 0; i < 16; i++) {
+		int index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+		for (int c = 0; c < 3; c++)
+			rgb[i][c] = (unsigned char) (palette[index][c] + 0.5f);
+	}
+}
@@ -0,0 +1,74 @@
+/* Pre-baked texture pack: every texture of the scene in one file.
+ *
+ * Layout, little endian, every section 16-byte aligned:
+ *   TexPackHeader
+ *   TexPackEntry[entryCount]   one per texture, looked up by name
+ *   TexPackLevel[levelCount]   mip levels of all entries, largest first
+ *   payloads                   one per level, RGB rows or DXT1 blocks as
+ *                              GL takes them
+ *
+ * The file is meant to be mapped and uploaded in place; see
+ * tools/bake.cpp for the writer.
+ */
+
+#ifndef TEXPACK_H
+#define TEXPACK_H
+
+#include <stdint.h>
+
+#include "mappedfile.h"
+
+#define TEXPACK_MAGIC "STXP"
+#define TEXPACK_VERSION 1
+
+enum TexPackFormat {
+	TEXPACK_RGB8 = 1,  // tightly packed RGB rows, bottom row first
+	TEXPACK_DXT1 = 2   // S3TC DXT1 blocks (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+};
+
+struct TexPackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t levelCount;
+};
+
+struct TexPackEntry {
+	char name[108];       // as listed in bodies.cfg, NUL terminated
+	uint32_t format;      // TexPackFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t firstLevel;  // index into the level table
+};
+
+struct TexPackLevel {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;      // from the start of the file
+	uint64_t size;
+};
+
+struct TexPack {
+	MappedFile file;
+	const TexPackHeader *header;
+	const TexPackEntry *entries;
+	const TexPackLevel *levels;
+};
+
+// Byte size of one level in the given format.
+uint64_t texPackLevelSize(uint32_t format, uint32_t width, uint32_t height);
+
+// Maps a pack and checks that every table and payload lies inside the
+// file. Returns false, printing the reason, if it does not.
+bool openTexPack(const char *filename, TexPack *pack);
+
+void closeTexPack(TexPack *pack);
+
+// Decodes the 4x4 texels of one DXT1 block, row by row, as RGB.
+void decodeDXT1Block(const unsigned char *block, unsigned char rgb[16][3]);
+
+// Returns the entry with the given name, or NULL.
+const TexPackEntry *findTexPackEntry(const TexPack &pack, const char *name);
+
+#endif
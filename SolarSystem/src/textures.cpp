@@ -0,0 +1,616 @@
+/* Texture streaming for the body table. */
+
+#include "textures.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glinfo.h"
+#include "glstate.h"
+#include "image.h"
+#include "threadpool.h"
+
+// Segments of the persistently mapped ring, so that the frame being
+// written never waits on the two before it.
+static const int segmentCount = 3;
+// Side of the largest page the surfaces share. Larger pages take longer
+// to allocate than a frame can spare, in software at least.
+static const int sharedPageSize = 4096;
+// Grey of the placeholder texels no surface has reached yet.
+static const unsigned char placeholderGrey = 128;
+
+static double nowMs() {
+	return std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TextureStreamer::TextureStreamer() :
+		havePack(false), budget(0), pending(0), cancelled(false),
+		pixelBuffer(0), persistent(false), mapped(NULL), segmentSize(0),
+		segment(0), streamed(0), startMs(0.0) {
+	for (int k = 0; k < segmentCount; k++)
+		fences[k] = 0;
+}
+
+// The average colour of an RGB surface, for drawing it from afar.
+static void averageColor(const unsigned char *rgb, int width, int height,
+		size_t stride, GLfloat color[3]) {
+	double sum[3] = { 0.0, 0.0, 0.0 };
+	for (int y = 0; y < height; y++) {
+		const unsigned char *row = rgb + y * stride;
+		for (int x = 0; x < 3 * width; x++)
+			sum[x % 3] += row[x];
+	}
+	for (int c = 0; c < 3; c++)
+		color[c] = (GLfloat) (sum[c] / (255.0 * width * height));
+}
+
+// Decodes a whole DXT1 level into tightly packed RGB.
+static void decodeDXT1(const unsigned char *blocks, int width, int height,
+		std::vector<unsigned char> &rgb) {
+	int blocksWide = (width + 3) / 4;
+	rgb.resize(3 * (size_t) width * height);
+	for (int by = 0; by < (height + 3) / 4; by++) {
+		for (int bx = 0; bx < blocksWide; bx++) {
+			unsigned char texels[16][3];
+			decodeDXT1Block(blocks + 8 * ((size_t) by * blocksWide + bx), texels);
+			for (int i = 0; i < 16; i++) {
+				int x = 4 * bx + i % 4, y = 4 * by + i / 4;
+				if (x < width && y < height)
+					memcpy(&rgb[3 * ((size_t) y * width + x)], texels[i], 3);
+			}
+		}
+	}
+}
+
+// Samples a copy of the surface at mip level `level`, nearest texel, into
+// every placeholder texel whose centre lies in the surface's block. The
+// copy's texel 0 sits at originX, originY of the atlas, and it is clamped
+// at its edges.
+void TextureStreamer::fillPlaceholder(Surface &surface,
+		const unsigned char *levelBase, int level, int levelWidth,
+		int levelHeight, size_t stride, int originX, int originY, bool dxt1) {
+	const Page &page = pages[surface.page];
+	const int scale = 1 << page.shift, half = scale / 2;
+	const AtlasSlot &slot = surface.slot;
+	int *rect = surface.placeholderRect;
+	rect[0] = (slot.x - half + scale - 1) >> page.shift;
+	rect[1] = (slot.y - half + scale - 1) >> page.shift;
+	rect[2] = ((slot.x + atlasBlockSize(slot.width, page.gutter) - half
+			+ scale - 1) >> page.shift) - rect[0];
+	rect[3] = ((slot.y + atlasBlockSize(slot.height, page.gutter) - half
+			+ scale - 1) >> page.shift) - rect[1];
+	surface.placeholder.resize(3 * (size_t) rect[2] * rect[3]);
+
+	const int blocksWide = (levelWidth + 3) / 4;
+	unsigned char *out = surface.placeholder.data();
+	for (int py = rect[1]; py < rect[1] + rect[3]; py++) {
+		int y = (((py << page.shift) + half) - originY) >> level;
+		y = std::min(std::max(y, 0), levelHeight - 1);
+		for (int px = rect[0]; px < rect[0] + rect[2]; px++, out += 3) {
+			int x = (((px << page.shift) + half) - originX) >> level;
+			x = std::min(std::max(x, 0), levelWidth - 1);
+			if (dxt1) {
+				unsigned char texels[16][3];
+				decodeDXT1Block(levelBase
+						+ 8 * ((size_t) (y / 4) * blocksWide + x / 4), texels);
+				memcpy(out, texels[(y % 4) * 4 + x % 4], 3);
+			} else
+				memcpy(out, levelBase + y * stride + 3 * x, 3);
+		}
+	}
+}
+
+void TextureStreamer::uploadPlaceholder(const Surface &surface) {
+	if (surface.placeholder.empty())
+		return;
+	const int *rect = surface.placeholderRect;
+	glBindTexture(GL_TEXTURE_2D, pages[surface.page].placeholder);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, rect[0], rect[1], rect[2], rect[3],
+			GL_RGB, GL_UNSIGNED_BYTE, surface.placeholder.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glState.invalidate();
+}
+
+// Runs on a worker: reads the whole surface and fills its block.
+void TextureStreamer::decode(size_t index) {
+	if (cancelled)
+		return;
+	Surface &surface = surfaces[index];
+	const AtlasSlot &slot = surface.slot;
+	surface.ok = true;
+	if (surface.compressed) {
+		// copied block by block, and the colour taken from a small level
+		const unsigned char *levels[atlasLevels + 1];
+		for (int k = 0; k <= atlasLevels; k++)
+			levels[k] = (const unsigned char *) pack.file.data
+					+ pack.levels[surface.packed->firstLevel + k].offset;
+		fillCompressedAtlasBlock(slot, levels, surface.block);
+		int w = std::max(slot.width >> atlasLevels, 1);
+		int h = std::max(slot.height >> atlasLevels, 1);
+		std::vector<unsigned char> rgb;
+		decodeDXT1(levels[atlasLevels], w, h, rgb);
+		averageColor(rgb.data(), w, h, 3 * w, surface.color);
+	} else if (surface.packed != NULL) {
+		const TexPackLevel &level = pack.levels[surface.packed->firstLevel];
+		const unsigned char *data =
+				(const unsigned char *) pack.file.data + level.offset;
+		std::vector<unsigned char> rgb;
+		if (surface.packed->format == TEXPACK_DXT1) {
+			decodeDXT1(data, slot.width, slot.height, rgb);
+			data = rgb.data();
+		}
+		fillAtlasBlock(slot, data, 3 * slot.width, surface.block);
+		averageColor(data, slot.width, slot.height, 3 * slot.width,
+				surface.color);
+	} else {
+		Image image;
+		// left in BGR and read-only, since the block is a copy anyway
+		surface.ok = ImageLoad(surface.file.c_str(), &image, true)
+				&& (int) image.sizeX == slot.width
+				&& (int) image.sizeY == slot.height;
+		if (surface.ok) {
+			size_t stride = (3 * (size_t) slot.width + 3) & ~(size_t) 3;
+			fillAtlasBlock(slot, image.data, stride, surface.block, true);
+			averageColor(image.data, slot.width, slot.height, stride,
+					surface.color);
+			std::swap(surface.color[0], surface.color[2]);
+			// the placeholder from the filtered level nearest its scale
+			int level = std::min(pages[surface.page].shift, atlasLevels);
+			int w = surface.block.width >> level;
+			fillPlaceholder(surface, surface.block.levels[level].data(), level,
+					w, surface.block.height >> level, 3 * w, slot.x, slot.y,
+					false);
+		}
+		if (image.data != NULL)
+			ImageFree(&image);
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	decoded.push_back(index);
+}
+
+// Bytes of a row of a level the given width, or of a row of 4x4 blocks on
+// a DXT1 page.
+static size_t rowBytes(bool compressed, int width) {
+	return compressed ? 2 * (size_t) width : 3 * (size_t) width;
+}
+
+void TextureStreamer::layoutPages(const std::vector<AtlasSlot> &slots,
+		std::vector<size_t> shared, bool compressed, int maxSize) {
+	Page page;
+	page.compressed = compressed;
+	page.gutter = compressed ? atlasCompressedGutter : atlasGutter;
+	std::vector<size_t> alone;
+	std::vector<AtlasSlot> sharedSlots;
+	for (;;) {
+		sharedSlots.clear();
+		for (size_t k = 0; k < shared.size(); k++)
+			sharedSlots.push_back(slots[shared[k]]);
+		if (layoutAtlas(sharedSlots, std::min(maxSize, sharedPageSize),
+				&page.width, &page.height, page.gutter))
+			break;
+		size_t largest = 0;
+		for (size_t k = 1; k < shared.size(); k++)
+			if ((long) slots[shared[k]].width * slots[shared[k]].height
+					> (long) slots[shared[largest]].width
+							* slots[shared[largest]].height)
+				largest = k;
+		alone.push_back(shared[largest]);
+		shared.erase(shared.begin() + largest);
+	}
+	if (!shared.empty()) {
+		for (size_t k = 0; k < shared.size(); k++) {
+			surfaces[shared[k]].slot = sharedSlots[k];
+			surfaces[shared[k]].page = (int) pages.size();
+		}
+		pages.push_back(page);
+	}
+	for (size_t k = 0; k < alone.size(); k++) {
+		Surface &surface = surfaces[alone[k]];
+		std::vector<AtlasSlot> single(1, slots[alone[k]]);
+		if (!layoutAtlas(single, maxSize, &page.width, &page.height,
+				page.gutter)) {
+			printf("%s is larger than %dx%d\n", surface.file.c_str(),
+					maxSize, maxSize);
+			exit(1);
+		}
+		surface.slot = single[0];
+		surface.page = (int) pages.size();
+		pages.push_back(page);
+	}
+}
+
+void TextureStreamer::start(BodyTable &table, const char *packFile,
+		long frameBudget) {
+	startMs = nowMs();
+	budget = std::max(frameBudget, 1L);
+	havePack = packFile != NULL && openTexPack(packFile, &pack);
+	table.texture.assign(table.count, 0);
+	table.placeholderTexture.assign(table.count, 0);
+	table.textureRect.assign(table.count, wholeTexture);
+	table.textureReady.assign(table.count, 1);
+
+	// bodies that share a file share its surface
+	std::map<std::string, size_t> byFile;
+	for (int i = 0; i < table.count; i++) {
+		const std::string &file = table.textureFile[i];
+		if (file.empty())
+			continue;
+		std::pair<std::map<std::string, size_t>::iterator, bool> added =
+				byFile.insert(std::make_pair(file, surfaces.size()));
+		if (added.second) {
+			Surface surface;
+			surface.file = file;
+			surface.packed = havePack
+					? findTexPackEntry(pack, file.c_str()) : NULL;
+			surface.page = 0;
+			surface.compressed = false;
+			surface.ok = false;
+			surface.level = surface.row = 0;
+			surfaces.push_back(surface);
+		}
+		surfaces[added.first->second].bodies.push_back(i);
+		table.textureReady[i] = 0;
+	}
+	if (surfaces.empty()) {
+		if (havePack)
+			closeTexPack(&pack);
+		havePack = false;
+		return;
+	}
+
+	// only the sizes are read now
+	std::vector<AtlasSlot> slots(surfaces.size());
+	for (size_t s = 0; s < surfaces.size(); s++) {
+		Surface &surface = surfaces[s];
+		if (surface.packed != NULL) {
+			slots[s].width = surface.packed->width;
+			slots[s].height = surface.packed->height;
+		} else {
+			unsigned long width, height;
+			if (!ImageReadSize(surface.file.c_str(), &width, &height))
+				exit(1);
+			slots[s].width = (int) width;
+			slots[s].height = (int) height;
+		}
+	}
+
+	// DXT1 surfaces share pages of their own, where the driver takes them
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	bool s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+	std::vector<size_t> plain, compressed;
+	for (size_t s = 0; s < surfaces.size(); s++) {
+		const TexPackEntry *entry = surfaces[s].packed;
+		surfaces[s].compressed = s3tc && entry != NULL
+				&& entry->format == TEXPACK_DXT1
+				&& (int) entry->levelCount > atlasLevels;
+		(surfaces[s].compressed ? compressed : plain).push_back(s);
+	}
+	layoutPages(slots, plain, false, maxSize);
+	layoutPages(slots, compressed, true, maxSize);
+
+	size_t widestRow = 0;
+	for (size_t p = 0; p < pages.size(); p++) {
+		Page &page = pages[p];
+		page.shift = 0;
+		while ((page.width >> page.shift) > placeholderSize
+				|| (page.height >> page.shift) > placeholderSize)
+			page.shift++;
+		// whole placeholder texels, so that both share the rectangles
+		int scale = 1 << page.shift;
+		page.width = (page.width + scale - 1) & ~(scale - 1);
+		page.height = (page.height + scale - 1) & ~(scale - 1);
+		// the atlas itself is allocated with its first rows, which spares
+		// the first frame the cost of a large one
+		glGenTextures(1, &page.texture);
+		page.allocated = false;
+
+		int placeholderWidth = page.width >> page.shift;
+		int placeholderHeight = page.height >> page.shift;
+		std::vector<unsigned char> grey(
+				3 * (size_t) placeholderWidth * placeholderHeight,
+				placeholderGrey);
+		glGenTextures(1, &page.placeholder);
+		glBindTexture(GL_TEXTURE_2D, page.placeholder);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, placeholderWidth,
+				placeholderHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, grey.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (size_t s = 0; s < surfaces.size(); s++) {
+		Surface &surface = surfaces[s];
+		const Page &page = pages[surface.page];
+		AtlasRect rect = atlasRect(surface.slot, page.width, page.height,
+				page.gutter);
+		widestRow = std::max(widestRow, rowBytes(page.compressed,
+				atlasBlockSize(surface.slot.width, page.gutter)));
+		for (size_t b = 0; b < surface.bodies.size(); b++) {
+			int i = surface.bodies[b];
+			table.texture[i] = page.texture;
+			table.placeholderTexture[i] = page.placeholder;
+			table.textureRect[i] = rect;
+		}
+		// a pack has small levels ready to show
+		if (surface.packed != NULL) {
+			const TexPackEntry &entry = *surface.packed;
+			int level = std::min(page.shift, (int) entry.levelCount - 1);
+			const TexPackLevel &data = pack.levels[entry.firstLevel + level];
+			fillPlaceholder(surface,
+					(const unsigned char *) pack.file.data + data.offset, level,
+					data.width, data.height, 3 * (size_t) data.width,
+					surface.slot.x + page.gutter, surface.slot.y + page.gutter,
+					entry.format == TEXPACK_DXT1);
+			uploadPlaceholder(surface);
+			surface.placeholder.clear();
+		}
+		pending++;
+		backgroundPool().submit([this, s]() { decode(s); });
+	}
+
+	// the ring of rows on their way to the atlas; a single row may exceed
+	// the budget
+	segmentSize = std::max((size_t) budget, widestRow);
+	persistent = glVersionAtLeast(4, 4)
+			|| hasGLExtension("GL_ARB_buffer_storage");
+	if (glVersionAtLeast(2, 1)
+			|| hasGLExtension("GL_ARB_pixel_buffer_object")) {
+		glGenBuffers(1, &pixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		if (persistent) {
+			GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+					| GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, segmentCount * segmentSize,
+					NULL, access);
+			mapped = (unsigned char *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+					0, segmentCount * segmentSize, access);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	persistent = mapped != NULL;
+	if (pixelBuffer == 0)
+		staging.resize(segmentSize);
+
+	printf("Laid out %u textures in %u atlas page%s (%dx%d) in %.1f ms, "
+			"streaming %ld KB a frame%s\n", (unsigned) surfaces.size(),
+			(unsigned) pages.size(), pages.size() == 1 ? "" : "s",
+			pages[0].width, pages[0].height, nowMs() - startMs, budget / 1024,
+			persistent ? " through a persistent buffer" : "");
+}
+
+// Gives a page's atlas its storage, empty.
+static void allocateAtlas(GLuint texture, int width, int height,
+		bool compressed) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlasLevels);
+	GLenum format = compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGB8;
+	for (int k = 0; k <= atlasLevels; k++)
+		glTexImage2D(GL_TEXTURE_2D, k, format, std::max(width >> k, 1),
+				std::max(height >> k, 1), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+}
+
+// Where this frame's rows are written.
+unsigned char *TextureStreamer::mapSegment() {
+	if (pixelBuffer == 0)
+		return staging.data();
+	if (persistent) {
+		if (fences[segment] != 0) {
+			while (glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT,
+					1000000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fences[segment]);
+			fences[segment] = 0;
+		}
+		return mapped + segment * segmentSize;
+	}
+	// orphaned, so the driver need not wait for last frame's uploads
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, segmentSize, NULL, GL_STREAM_DRAW);
+	unsigned char *out = (unsigned char *) glMapBuffer(GL_PIXEL_UNPACK_BUFFER,
+			GL_WRITE_ONLY);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return out;
+}
+
+void TextureStreamer::unmapSegment() {
+	if (pixelBuffer == 0 || persistent)
+		return;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::finishSurface(BodyTable &table, Surface &surface) {
+	for (size_t b = 0; b < surface.bodies.size(); b++)
+		table.textureReady[surface.bodies[b]] = 1;
+	printf("Streamed %s (%dx%d) %.1f ms after start\n", surface.file.c_str(),
+			surface.slot.width, surface.slot.height, nowMs() - startMs);
+	streamed++;
+}
+
+bool TextureStreamer::update(BodyTable &table) {
+	if (pending == 0 && uploads.empty())
+		return false;
+
+	// the surfaces the workers have finished show their placeholders and
+	// colours now, and join the uploads
+	std::deque<size_t> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(decoded);
+	}
+	for (size_t r = 0; r < ready.size(); r++) {
+		Surface &surface = surfaces[ready[r]];
+		pending--;
+		if (!surface.ok) {
+			printf("Cannot load %s\n", surface.file.c_str());
+			exit(1);
+		}
+		uploadPlaceholder(surface);
+		surface.placeholder.clear();
+		for (size_t b = 0; b < surface.bodies.size(); b++)
+			std::copy(surface.color, surface.color + 3,
+					&table.color[3 * surface.bodies[b]]);
+		uploads.push_back(ready[r]);
+	}
+	if (pending == 0 && havePack) {
+		closeTexPack(&pack);
+		havePack = false;
+	}
+
+	if (!uploads.empty()) {
+		// copy up to the budget of rows into the buffer
+		unsigned char *out = mapSegment();
+		size_t base = persistent ? segment * segmentSize : 0;
+		size_t used = 0;
+		std::vector<size_t> done;
+		chunks.clear();
+		while (!uploads.empty()) {
+			Surface &surface = surfaces[uploads.front()];
+			const int level = surface.level;
+			const int w = surface.block.width >> level;
+			// rows of texels, or of 4x4 blocks on a DXT1 page
+			const int rowHeight = surface.compressed ? 4 : 1;
+			const int h = (surface.block.height >> level) / rowHeight;
+			const size_t bytes = rowBytes(surface.compressed, w);
+			size_t room = used < (size_t) budget ? budget - used : 0;
+			int rows = (int) std::min((size_t) (h - surface.row),
+					room / bytes);
+			if (rows == 0) {
+				if (used > 0)
+					break;
+				rows = 1;
+			}
+			memcpy(out + used, &surface.block.levels[level][surface.row
+					* bytes], rows * bytes);
+			Chunk chunk;
+			chunk.page = surface.page;
+			chunk.level = level;
+			chunk.x = surface.slot.x >> level;
+			chunk.y = (surface.slot.y >> level) + surface.row * rowHeight;
+			chunk.width = w;
+			chunk.height = rows * rowHeight;
+			chunk.offset = base + used;
+			chunk.size = rows * bytes;
+			chunks.push_back(chunk);
+			used += rows * bytes;
+
+			surface.row += rows;
+			if (surface.row < h)
+				continue;
+			std::vector<unsigned char>().swap(surface.block.levels[level]);
+			surface.row = 0;
+			if (++surface.level > atlasLevels) {
+				done.push_back(uploads.front());
+				uploads.pop_front();
+			}
+		}
+		unmapSegment();
+
+		// and from there into the atlas, once it has storage; which must be
+		// given before the buffer is bound, or it would be read from it
+		for (size_t c = 0; c < chunks.size(); c++) {
+			Page &page = pages[chunks[c].page];
+			if (!page.allocated) {
+				allocateAtlas(page.texture, page.width, page.height,
+						page.compressed);
+				page.allocated = true;
+			}
+		}
+		const unsigned char *source = pixelBuffer != 0 ? NULL : staging.data();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t c = 0; c < chunks.size(); c++) {
+			const Chunk &chunk = chunks[c];
+			glBindTexture(GL_TEXTURE_2D, pages[chunk.page].texture);
+			if (pages[chunk.page].compressed)
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, chunk.level, chunk.x,
+						chunk.y, chunk.width, chunk.height,
+						GL_COMPRESSED_RGB_S3TC_DXT1_EXT, (GLsizei) chunk.size,
+						source + chunk.offset);
+			else
+				glTexSubImage2D(GL_TEXTURE_2D, chunk.level, chunk.x, chunk.y,
+						chunk.width, chunk.height, GL_RGB, GL_UNSIGNED_BYTE,
+						source + chunk.offset);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		// bound behind the cache's back
+		glState.invalidate();
+		if (persistent) {
+			fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			segment = (segment + 1) % segmentCount;
+		}
+		for (size_t d = 0; d < done.size(); d++)
+			finishSurface(table, surfaces[done[d]]);
+	}
+
+	if (pending > 0 || !uploads.empty())
+		return true;
+	printf("Streamed %u textures in %.1f ms\n", streamed, nowMs() - startMs);
+	releaseBuffer();
+	return false;
+}
+
+void TextureStreamer::finish(BodyTable &table) {
+	backgroundPool().wait();
+	while (update(table))
+		;
+}
+
+// Deletes the pixel buffer, once nothing is left to stream.
+void TextureStreamer::releaseBuffer() {
+	for (int k = 0; k < segmentCount; k++) {
+		if (fences[k] != 0)
+			glDeleteSync(fences[k]);
+		fences[k] = 0;
+	}
+	if (pixelBuffer != 0) {
+		if (persistent) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &pixelBuffer);
+	}
+	pixelBuffer = 0;
+	mapped = NULL;
+	persistent = false;
+	std::vector<unsigned char>().swap(staging);
+}
+
+void TextureStreamer::release() {
+	// the workers still hold the surfaces and the pack; those yet to begin
+	// return at once
+	cancelled = true;
+	backgroundPool().wait();
+	cancelled = false;
+	releaseBuffer();
+	for (size_t p = 0; p < pages.size(); p++) {
+		GLuint textures[] = { pages[p].texture, pages[p].placeholder };
+		glDeleteTextures(2, textures);
+	}
+	pages.clear();
+	surfaces.clear();
+	decoded.clear();
+	uploads.clear();
+	pending = 0;
+	if (havePack)
+		closeTexPack(&pack);
+	havePack = false;
+}
@@ -0,0 +1,144 @@
+/* Texture streaming for the body table.
+ *
+ * Start-up only reads the size of every surface and lays the atlas out
+ * from them (see atlas.h), with a small placeholder copy of it, at most
+ * placeholderSize texels a side, that the bodies show in the meantime: grey
+ * at first, then each surface as soon as it is known, straight from a small
+ * mip level for surfaces in the pack. Background workers, at low priority
+ * and apart from the pool the frames share their work out on, decode the
+ * surfaces, each into its block with the gutter and mip levels, and the
+ * GL thread uploads the blocks a few rows at a time through a pixel buffer
+ * object, within a budget of bytes per frame, so no frame waits on a whole
+ * texture and the first one waits on none, however large they are. Each
+ * body switches to the atlas when its surface is complete. Surfaces too
+ * large to share a page of the atlas get a page of their own, and DXT1
+ * surfaces of a pack stay compressed on pages apart from the others where
+ * the driver has S3TC.
+ *
+ * Where the context has GL 4.4 or ARB_buffer_storage the buffer is mapped
+ * once, persistently, as a ring of segments fenced as the GPU reads them;
+ * elsewhere each frame orphans and maps it again.
+ */
+
+#ifndef TEXTURES_H
+#define TEXTURES_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "atlas.h"
+#include "bodies.h"
+#include "texpack.h"
+
+const int placeholderSize = 256;
+
+class TextureStreamer {
+public:
+	TextureStreamer();
+
+	// Reads the sizes of the table's textures, lays out the atlas and
+	// uploads its placeholder, and starts decoding every surface; fills in
+	// the table's textures, placeholders and rectangles. Names found in the
+	// pack packFile, if it opens, are read from it rather than from the
+	// bitmaps.
+	// Each frame then uploads up to frameBudget bytes. Needs a current GL
+	// context. Exits if a file cannot be read.
+	void start(BodyTable &table, const char *packFile, long frameBudget);
+
+	// Uploads the next frameBudget bytes and marks the bodies whose surface
+	// is complete, and gives them their average colour. Runs on the GL
+	// thread once a frame. Returns true while surfaces remain.
+	bool update(BodyTable &table);
+
+	// Uploads everything that remains, waiting for the workers.
+	void finish(BodyTable &table);
+
+	// Deletes the textures and buffers, dropping decodes not yet begun.
+	void release();
+
+private:
+	// One texture file, shared by every body that names it.
+	struct Surface {
+		std::string file;
+		const TexPackEntry *packed;  // or NULL for a bitmap
+		bool compressed;             // kept in DXT1, on a DXT1 page
+		int page;                    // which atlas holds it
+		AtlasSlot slot;
+		std::vector<int> bodies;
+		// filled in by the worker
+		bool ok;
+		AtlasBlock block;
+		GLfloat color[3];
+		std::vector<unsigned char> placeholder;  // texels of placeholderRect
+		int placeholderRect[4];                  // x, y, width, height
+		// upload progress
+		int level, row;
+	};
+
+	// An atlas, and its placeholder copy shrunk by 1 << shift.
+	struct Page {
+		GLuint texture, placeholder;
+		int width, height;
+		bool compressed;  // DXT1, with atlasCompressedGutter
+		int gutter;
+		int shift;
+		bool allocated;  // the atlas, which waits for its first rows
+	};
+
+	// A run of rows in the pixel buffer, for glTexSubImage2D or
+	// glCompressedTexSubImage2D.
+	struct Chunk {
+		int page;
+		int level, x, y, width, height;
+		size_t offset, size;
+	};
+
+	// Lays out the surfaces shared on one page, bar those that do not fit
+	// it, largest first, which get a page each, and appends the pages.
+	void layoutPages(const std::vector<AtlasSlot> &slots,
+			std::vector<size_t> shared, bool compressed, int maxSize);
+	void decode(size_t index);
+	void finishSurface(BodyTable &table, Surface &surface);
+	void fillPlaceholder(Surface &surface, const unsigned char *levelBase,
+			int level, int levelWidth, int levelHeight, size_t stride,
+			int originX, int originY, bool dxt1);
+	void uploadPlaceholder(const Surface &surface);
+	unsigned char *mapSegment();
+	void unmapSegment();
+	void releaseBuffer();
+
+	std::vector<Surface> surfaces;
+	std::vector<Page> pages;
+	TexPack pack;
+	bool havePack;
+	long budget;
+
+	// surfaces the workers are done with, for the GL thread
+	std::mutex mutex;
+	std::deque<size_t> decoded;
+	size_t pending;
+	std::atomic<bool> cancelled;  // set by release; decodes not begun skip
+	// surfaces being uploaded, first one first
+	std::deque<size_t> uploads;
+
+	// the pixel buffer, segmentCount segments of segmentSize bytes
+	GLuint pixelBuffer;
+	bool persistent;
+	unsigned char *mapped;  // the whole buffer when persistent
+	size_t segmentSize;
+	int segment;
+	GLsync fences[3];
+	std::vector<unsigned char> staging;  // stands in without buffers
+	std::vector<Chunk> chunks;
+
+	unsigned streamed;
+	double startMs;
+};
+
+#endif
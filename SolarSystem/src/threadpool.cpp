@@ -0,0 +1,198 @@
+/* A fixed set of worker threads that run submitted tasks in FIFO order. */
+
+#include "threadpool.h"
+
+#include <memory>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+ThreadPool::ThreadPool(int threads, bool background) :
+		busy(0), stopping(false) {
+	if (threads <= 0)
+		threads = (int) std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&ThreadPool::run, this, background));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskReady.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::submit(const std::function<void()> &task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+	}
+	taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!tasks.empty() || busy > 0)
+		allDone.wait(lock);
+}
+
+void ThreadPool::run(bool background) {
+#ifdef __linux__
+	// Linux gives every thread a nice value of its own; at 19 they would
+	// barely run while the frames keep a core busy
+	if (background)
+		setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 10);
+#endif
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		while (tasks.empty() && !stopping)
+			taskReady.wait(lock);
+		if (tasks.empty())
+			return;
+
+		std::function<void()> task = tasks.front();
+		tasks.pop_front();
+		busy++;
+		lock.unlock();
+		task();
+		lock.lock();
+		busy--;
+		if (tasks.empty() && busy == 0)
+			allDone.notify_all();
+	}
+}
+
+ThreadPool &workerPool() {
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool &backgroundPool() {
+	static ThreadPool pool(0, true);
+	return pool;
+}
+
+// The items of a parallelFor one thread has yet to start.
+struct StealRange {
+	std::mutex mutex;
+	int next, end;
+};
+
+// Moves the upper half of the fullest other range into ranges[self].
+// Returns false once every range is empty.
+static bool stealWork(std::vector<StealRange> &ranges, int self, int grain) {
+	for (;;) {
+		int victim = -1, most = 0;
+		for (int v = 0; v < (int) ranges.size(); v++) {
+			if (v == self)
+				continue;
+			std::lock_guard<std::mutex> lock(ranges[v].mutex);
+			if (ranges[v].end - ranges[v].next > most) {
+				most = ranges[v].end - ranges[v].next;
+				victim = v;
+			}
+		}
+		if (victim < 0)
+			return false;
+
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+			int left = ranges[victim].end - ranges[victim].next;
+			if (left <= 0)
+				continue;  // drained meanwhile, look again
+			end = ranges[victim].end;
+			begin = end - (left > grain ? left / 2 : left);
+			ranges[victim].end = begin;
+		}
+		std::lock_guard<std::mutex> lock(ranges[self].mutex);
+		ranges[self].next = begin;
+		ranges[self].end = end;
+		return true;
+	}
+}
+
+// Runs the pieces of ranges[self], then stolen ones, until none are left.
+static void runRanges(std::vector<StealRange> &ranges, int self, int grain,
+		const std::function<void(int, int)> &body) {
+	for (;;) {
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(ranges[self].mutex);
+			begin = ranges[self].next;
+			end = begin + grain < ranges[self].end ?
+					begin + grain : ranges[self].end;
+			ranges[self].next = end;
+		}
+		if (begin < end)
+			body(begin, end);
+		else if (!stealWork(ranges, self, grain))
+			return;
+	}
+}
+
+// A parallelFor's ranges and the pool tasks helping with them, shared
+// with tasks that may only start after it has returned.
+struct ParallelJob {
+	std::vector<StealRange> ranges;
+	std::mutex mutex;
+	std::condition_variable finished;
+	int helping;  // tasks inside runRanges
+	bool closed;  // every range is done; later tasks have nothing to do
+};
+
+void parallelFor(int count, int grain,
+		const std::function<void(int, int)> &body) {
+	ThreadPool &pool = workerPool();
+	if (grain < 1)
+		grain = 1;
+	int parts = pool.size() + 1;
+	if (parts > (count + grain - 1) / grain)
+		parts = (count + grain - 1) / grain;
+	if (parts <= 1) {
+		if (count > 0)
+			body(0, count);
+		return;
+	}
+
+	std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+	job->ranges = std::vector<StealRange>(parts);
+	job->helping = 0;
+	job->closed = false;
+	for (int p = 0; p < parts; p++) {
+		job->ranges[p].next = (int) ((long long) count * p / parts);
+		job->ranges[p].end = (int) ((long long) count * (p + 1) / parts);
+	}
+
+	const std::function<void(int, int)> *work = &body;
+	for (int p = 1; p < parts; p++) {
+		pool.submit([job, work, grain, p]() {
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				if (job->closed)
+					return;
+				job->helping++;
+			}
+			runRanges(job->ranges, p, grain, *work);
+			// notify under the lock: the caller's body goes away once it
+			// sees the count reach zero
+			std::lock_guard<std::mutex> lock(job->mutex);
+			if (--job->helping == 0)
+				job->finished.notify_one();
+		});
+	}
+	// the caller steals whatever tasks still queued behind others, such as
+	// texture decodes, have not started, and waits only for those running
+	runRanges(job->ranges, 0, grain, body);
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->closed = true;
+	while (job->helping > 0)
+		job->finished.wait(lock);
+}
@@ -0,0 +1,59 @@
+/* A fixed set of worker threads that run submitted tasks in FIFO order. */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	// threads <= 0 starts one worker per hardware thread. Background
+	// workers run at a lower priority than the rest of the process, where
+	// the system allows it.
+	explicit ThreadPool(int threads = 0, bool background = false);
+	~ThreadPool();
+
+	void submit(const std::function<void()> &task);
+
+	// Blocks until every task submitted so far has finished.
+	void wait();
+
+	int size() const {
+		return (int) workers.size();
+	}
+
+private:
+	void run(bool background);
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::condition_variable allDone;
+	int busy;
+	bool stopping;
+};
+
+// Process-wide pool for parallelFor, started on first use.
+ThreadPool &workerPool();
+
+// Process-wide background pool for long tasks, such as decoding textures,
+// that must not hold up the frames, started on first use.
+ThreadPool &backgroundPool();
+
+// Calls body(begin, end) on ranges covering 0 to count - 1, about grain
+// items each, on the worker pool and the calling thread. Every thread starts
+// on an equal share; one that runs out steals half of the largest share
+// left, so uneven work still keeps every thread busy. Workers still busy
+// with earlier tasks have their shares stolen by the others, the calling
+// thread included, which never waits for a task that has not started.
+// Returns once every range is done.
+void parallelFor(int count, int grain,
+		const std::function<void(int, int)> &body);
+
+#endif
@@ -0,0 +1,296 @@
+/* Trails behind the bodies and the orbits ahead of them. */
+
+#include "trails.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "glstate.h"
+#include "mesh.h"
+
+// How opaque an orbit is drawn, of 255.
+static const int orbitAlpha = 90;
+
+bool hasOrbitPath(const BodyTable &table, int i) {
+	return table.shape[i] == SHAPE_SPHERE && table.parent[i] >= 0
+			&& table.distance[i] > 0.0f;
+}
+
+// The colour a body's lines are drawn in, at alpha out of 255.
+static void lineColor(const BodyTable &table, int body, int alpha,
+		GLubyte *rgba) {
+	for (int c = 0; c < 3; c++)
+		rgba[c] = (GLubyte) (255.0f
+				* std::min(std::max(table.color[3 * body + c], 0.0f), 1.0f));
+	rgba[3] = (GLubyte) alpha;
+}
+
+void createTrails(const BodyTable &table, int length, TrailBuffer &trails) {
+	trails.length = std::max(length, 2);
+	trails.bodies.clear();
+	for (int i = 0; i < table.count; i++)
+		if (hasOrbitPath(table, i))
+			trails.bodies.push_back(i);
+	const int n = (int) trails.bodies.size();
+	trails.slot.resize(3 * n);
+	trails.head = 0;
+	trails.empty = true;
+
+	// the window is oldest first, so the alpha rises along it
+	std::vector<GLubyte> colors(4 * (size_t) n * length);
+	for (int k = 0; k < length; k++)
+		for (int b = 0; b < n; b++)
+			lineColor(table, trails.bodies[b], 255 * (k + 1) / length,
+					&colors[4 * ((size_t) k * n + b)]);
+	std::vector<GLuint> indices;
+	indices.reserve(2 * (size_t) n * (length - 1));
+	for (int k = 0; k + 1 < length; k++)
+		for (int b = 0; b < n; b++) {
+			indices.push_back(k * n + b);
+			indices.push_back((k + 1) * n + b);
+		}
+	trails.indexCount = (GLsizei) indices.size();
+
+	glGenBuffers(1, &trails.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, trails.buffer);
+	glBufferData(GL_ARRAY_BUFFER, 2 * (size_t) length * n * 3
+			* sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+	glGenBuffers(1, &trails.colorBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, trails.colorBuffer);
+	glBufferData(GL_ARRAY_BUFFER, colors.size(),
+			colors.empty() ? NULL : &colors[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenBuffers(1, &trails.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, trails.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+			indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// bound behind the cache's back
+	glState.invalidate();
+}
+
+void recordTrails(TrailBuffer &trails, const BodyState &state,
+		double days) {
+	const int n = (int) trails.bodies.size();
+	if (n == 0 || (!trails.empty && days == trails.days))
+		return;
+	trails.days = days;
+	for (int b = 0; b < n; b++) {
+		const int i = trails.bodies[b];
+		trails.slot[3 * b] = state.x[i];
+		trails.slot[3 * b + 1] = state.y[i];
+		trails.slot[3 * b + 2] = state.z[i];
+	}
+	const GLsizeiptr bytes = 3 * n * sizeof(GLfloat);
+	glState.bindBuffer(GL_ARRAY_BUFFER, trails.buffer);
+	if (trails.empty) {
+		// every slot at the first position, so the lines start out empty
+		std::vector<GLfloat> all;
+		all.reserve(2 * trails.length * trails.slot.size());
+		for (int s = 0; s < 2 * trails.length; s++)
+			all.insert(all.end(), trails.slot.begin(), trails.slot.end());
+		glBufferSubData(GL_ARRAY_BUFFER, 0, all.size() * sizeof(GLfloat),
+				&all[0]);
+		trails.head = trails.length - 1;
+		trails.empty = false;
+		return;
+	}
+	trails.head = (trails.head + 1) % trails.length;
+	glBufferSubData(GL_ARRAY_BUFFER, trails.head * bytes, bytes,
+			&trails.slot[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, (trails.head + trails.length) * bytes,
+			bytes, &trails.slot[0]);
+}
+
+void clearTrails(TrailBuffer &trails) {
+	trails.empty = true;
+}
+
+void drawTrails(const TrailBuffer &trails) {
+	if (trails.indexCount == 0 || trails.empty)
+		return;
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// the bodies hide them, but they do not hide each other
+	glDepthMask(GL_FALSE);
+
+	glState.clientState(GL_VERTEX_ARRAY, true);
+	glState.clientState(GL_NORMAL_ARRAY, false);
+	glState.clientState(GL_TEXTURE_COORD_ARRAY, false);
+	glState.clientState(GL_COLOR_ARRAY, true);
+	glState.bindBuffer(GL_ARRAY_BUFFER, trails.colorBuffer);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, 0);
+	glState.bindBuffer(GL_ARRAY_BUFFER, trails.buffer);
+	glVertexPointer(3, GL_FLOAT, 0, (const GLvoid *) trailWindowOffset(trails));
+	glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, trails.indexBuffer);
+	glDrawElements(GL_LINES, trails.indexCount, GL_UNSIGNED_INT, 0);
+	meshStats.drawCalls++;
+	meshStats.indices += trails.indexCount;
+	glPopAttrib();
+}
+
+void deleteTrails(TrailBuffer &trails) {
+	GLuint buffers[] = { trails.buffer, trails.colorBuffer,
+			trails.indexBuffer };
+	glDeleteBuffers(3, buffers);
+	trails.buffer = trails.colorBuffer = trails.indexBuffer = 0;
+	trails.indexCount = 0;
+	trails.bodies.clear();
+	// deleting a bound buffer unbinds it behind the cache's back
+	glState.invalidate();
+}
+
+// The elements of body that shape its orbit, as the polyline has them.
+static const int orbitElements = 7;
+static void orbitShape(const BodyTable &table, int body, double *out) {
+	const KeplerOrbits &o = table.orbits;
+	out[0] = o.px[body];
+	out[1] = o.py[body];
+	out[2] = o.pz[body];
+	out[3] = o.qx[body];
+	out[4] = o.qy[body];
+	out[5] = o.qz[body];
+	out[6] = o.eccentricity[body];
+}
+
+// Writes the polyline of body around its parent, evenly spaced in the
+// eccentric anomaly so that the ends of eccentric orbits keep their shape.
+static void buildOrbit(const BodyTable &table, int body, OrbitVertex *out) {
+	double shape[orbitElements];
+	orbitShape(table, body, shape);
+	for (int j = 0; j < orbitSegments; j++) {
+		const double E = 2.0 * M_PI * j / orbitSegments;
+		const double u = cos(E) - shape[6], v = sin(E);
+		out[j].x = (GLfloat) (u * shape[0] + v * shape[3]);
+		out[j].y = (GLfloat) (u * shape[1] + v * shape[4]);
+		out[j].z = (GLfloat) (u * shape[2] + v * shape[5]);
+		out[j].parent = (GLfloat) table.parent[body];
+	}
+}
+
+// Lays out the groups, the colours and the lines, and builds every
+// polyline.
+static void createOrbitPaths(const BodyTable &table, OrbitPaths &orbits) {
+	std::vector<std::pair<int, int> > order;
+	for (int i = 0; i < table.count; i++)
+		if (hasOrbitPath(table, i))
+			order.push_back(std::make_pair(table.parent[i], i));
+	std::sort(order.begin(), order.end());
+	const int n = (int) order.size();
+	orbits.bodies.resize(n);
+	orbits.groupParent.clear();
+	orbits.groupIndex.clear();
+	std::vector<OrbitVertex> vertices((size_t) n * orbitSegments);
+	std::vector<GLubyte> colors(4 * (size_t) n * orbitSegments);
+	std::vector<GLuint> indices;
+	indices.reserve(2 * (size_t) n * orbitSegments);
+	orbits.elements.resize(orbitElements * (size_t) n);
+	for (int b = 0; b < n; b++) {
+		const int body = order[b].second;
+		orbits.bodies[b] = body;
+		if (b == 0 || order[b].first != order[b - 1].first) {
+			orbits.groupParent.push_back(order[b].first);
+			orbits.groupIndex.push_back((int) indices.size());
+		}
+		orbitShape(table, body, &orbits.elements[orbitElements * b]);
+		buildOrbit(table, body, &vertices[(size_t) b * orbitSegments]);
+		for (int j = 0; j < orbitSegments; j++) {
+			lineColor(table, body, orbitAlpha,
+					&colors[4 * ((size_t) b * orbitSegments + j)]);
+			indices.push_back(b * orbitSegments + j);
+			indices.push_back(b * orbitSegments + (j + 1) % orbitSegments);
+		}
+	}
+	orbits.groupIndex.push_back((int) indices.size());
+	orbits.indexCount = (GLsizei) indices.size();
+
+	glGenBuffers(1, &orbits.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, orbits.buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(OrbitVertex),
+			vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &orbits.colorBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, orbits.colorBuffer);
+	glBufferData(GL_ARRAY_BUFFER, colors.size(),
+			colors.empty() ? NULL : &colors[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenBuffers(1, &orbits.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, orbits.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+			indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// bound behind the cache's back
+	glState.invalidate();
+}
+
+void updateOrbitPaths(const BodyTable &table, OrbitPaths &orbits) {
+	if (orbits.buffer == 0) {
+		createOrbitPaths(table, orbits);
+		return;
+	}
+	// only the polylines whose elements differ are built and written again
+	OrbitVertex vertices[orbitSegments];
+	for (size_t b = 0; b < orbits.bodies.size(); b++) {
+		double shape[orbitElements];
+		orbitShape(table, orbits.bodies[b], shape);
+		double *known = &orbits.elements[orbitElements * b];
+		if (std::equal(shape, shape + orbitElements, known))
+			continue;
+		std::copy(shape, shape + orbitElements, known);
+		buildOrbit(table, orbits.bodies[b], vertices);
+		glState.bindBuffer(GL_ARRAY_BUFFER, orbits.buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, b * sizeof(vertices),
+				sizeof(vertices), vertices);
+	}
+}
+
+void drawOrbitPaths(const OrbitPaths &orbits, const BodyState &state,
+		const Matrix4 &view) {
+	if (orbits.indexCount == 0)
+		return;
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_LIGHTING);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	glState.clientState(GL_VERTEX_ARRAY, true);
+	glState.clientState(GL_NORMAL_ARRAY, false);
+	glState.clientState(GL_TEXTURE_COORD_ARRAY, false);
+	glState.clientState(GL_COLOR_ARRAY, true);
+	glState.bindBuffer(GL_ARRAY_BUFFER, orbits.colorBuffer);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, 0);
+	glState.bindBuffer(GL_ARRAY_BUFFER, orbits.buffer);
+	glVertexPointer(3, GL_FLOAT, sizeof(OrbitVertex), 0);
+	glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, orbits.indexBuffer);
+	// one draw for the orbits around each parent, moved to where it is
+	for (size_t g = 0; g < orbits.groupParent.size(); g++) {
+		const int parent = orbits.groupParent[g];
+		Matrix4 modelview = matrixMultiply(view, matrixTranslation(
+				state.x[parent], state.y[parent], state.z[parent]));
+		glLoadMatrixf(modelview.m);
+		const GLsizei count = orbits.groupIndex[g + 1] - orbits.groupIndex[g];
+		glDrawElements(GL_LINES, count, GL_UNSIGNED_INT,
+				(const GLvoid *) (orbits.groupIndex[g] * sizeof(GLuint)));
+		meshStats.drawCalls++;
+		meshStats.indices += count;
+	}
+	glLoadMatrixf(view.m);
+	glPopAttrib();
+}
+
+void deleteOrbitPaths(OrbitPaths &orbits) {
+	GLuint buffers[] = { orbits.buffer, orbits.colorBuffer,
+			orbits.indexBuffer };
+	glDeleteBuffers(3, buffers);
+	orbits.buffer = orbits.colorBuffer = orbits.indexBuffer = 0;
+	orbits.indexCount = 0;
+	orbits.bodies.clear();
+	orbits.elements.clear();
+	// deleting a bound buffer unbinds it behind the cache's back
+	glState.invalidate();
+}
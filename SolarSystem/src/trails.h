@@ -0,0 +1,102 @@
+/* Trails behind the bodies and the orbits ahead of them.
+ *
+ * A trail is the last few positions of a body, drawn as lines that fade
+ * out with age. Every trailed body records its position at the same
+ * moments, so the positions of one moment form a slot of the ring, and
+ * the ring keeps each slot twice, at s and s + length: however far round
+ * it has come, the last length slots then lie next to each other in the
+ * buffer, oldest first. Recording writes the new slot's two copies with
+ * sub-range writes, and drawing points the vertex arrays at the window,
+ * so the index buffer, joining every body's position in each slot to its
+ * position in the next, and the colours, which fade with the place in the
+ * window, never change.
+ *
+ * An orbit is a closed polyline of the ellipse in the parent's frame,
+ * relative to the parent, built from the table's elements when it is
+ * first drawn and again only for the bodies whose elements change; each
+ * frame only moves it with the parent.
+ */
+
+#ifndef TRAILS_H
+#define TRAILS_H
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <vector>
+
+#include "bodies.h"
+#include "matrix.h"
+
+// Segments of every orbit's polyline.
+const int orbitSegments = 128;
+
+struct TrailBuffer {
+	int length;                // positions kept of each body
+	std::vector<int> bodies;   // that have trails, in the order of a slot
+	GLuint buffer;             // 2 length slots of x, y and z of each body
+	GLuint colorBuffer;        // RGBA of a window of length slots
+	GLuint indexBuffer;        // lines within the window
+	GLsizei indexCount;
+	int head;                  // the slot written last, below length
+	bool empty;                // the next record fills every slot
+	double days;               // since J2000 of the newest slot
+	std::vector<GLfloat> slot; // staging for one slot
+};
+
+struct OrbitPaths {
+	std::vector<int> bodies;   // that have orbits, grouped by parent
+	// the orbits around groupParent[g] are the lines from groupIndex[g] to
+	// groupIndex[g + 1]
+	std::vector<int> groupParent, groupIndex;
+	GLuint buffer;             // orbitSegments vertices of each body
+	GLuint colorBuffer;
+	GLuint indexBuffer;
+	GLsizei indexCount;
+	// the elements the polylines were built from, to spot changes
+	std::vector<double> elements;
+};
+
+// One orbit vertex: relative to the parent, whose index is w.
+struct OrbitVertex {
+	GLfloat x, y, z, parent;
+};
+
+// Whether body i orbits something and so gets a trail and an orbit.
+bool hasOrbitPath(const BodyTable &table, int i);
+
+// Allocates the ring for length positions of every orbiting body. Needs a
+// current GL context.
+void createTrails(const BodyTable &table, int length, TrailBuffer &trails);
+
+// Records where state has the bodies at days since J2000 as the newest
+// position, unless the newest is already of that moment, as while paused.
+void recordTrails(TrailBuffer &trails, const BodyState &state, double days);
+
+// Forgets the positions, as after a jump in time.
+void clearTrails(TrailBuffer &trails);
+
+// The first vertex of the window of trails, the oldest slot.
+inline GLintptr trailWindowOffset(const TrailBuffer &trails) {
+	return (GLintptr) (trails.head + 1) * trails.bodies.size() * 3
+			* sizeof(GLfloat);
+}
+
+// Draws the trails with the fixed-function pipeline, under the current
+// modelview matrix.
+void drawTrails(const TrailBuffer &trails);
+
+void deleteTrails(TrailBuffer &trails);
+
+// Builds the polylines of the bodies whose elements changed since the
+// last call, every body's the first time. Needs a current GL context.
+void updateOrbitPaths(const BodyTable &table, OrbitPaths &orbits);
+
+// Draws the orbits around where state has the parents with the
+// fixed-function pipeline, seen through view.
+void drawOrbitPaths(const OrbitPaths &orbits, const BodyState &state,
+		const Matrix4 &view);
+
+void deleteOrbitPaths(OrbitPaths &orbits);
+
+#endif
@@ -0,0 +1,113 @@
+/* Split-screen views. */
+
+#include "views.h"
+
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// A camera at eye looking at the sun. Up is y, or z when looking straight
+// down or up, as the top preset has it.
+static Camera cameraAt(float x, float y, float z) {
+	Camera camera = { x, y, z, 0, 0, 0, 0, 1, 0 };
+	if (sqrtf(x * x + z * z) < 1e-3f * fabsf(y)) {
+		camera.upY = 0;
+		camera.upZ = 1;
+	}
+	return camera;
+}
+
+bool parseViewCameras(const char *list, std::vector<Camera> &cameras) {
+	cameras.clear();
+	std::string text = list;
+	size_t start = 0;
+	for (;;) {
+		size_t end = text.find(',', start);
+		std::string entry = text.substr(start,
+				end == std::string::npos ? std::string::npos : end - start);
+		float x, y, z;
+		char rest;
+		const CameraPreset *preset = findCameraPreset(entry.c_str());
+		if (entry == "all") {
+			for (int i = 0; i < cameraPresetCount; i++)
+				cameras.push_back(cameraPresets[i].camera);
+		} else if (preset != NULL)
+			cameras.push_back(preset->camera);
+		else if (sscanf(entry.c_str(), "%f:%f:%f%c", &x, &y, &z, &rest) == 3
+				&& (x != 0.0f || y != 0.0f || z != 0.0f))
+			cameras.push_back(cameraAt(x, y, z));
+		else {
+			printf("Bad view: %s\n", entry.c_str());
+			return false;
+		}
+		if (end == std::string::npos)
+			break;
+		start = end + 1;
+	}
+	if ((int) cameras.size() > maxViews) {
+		printf("Too many views: %d, at most %d\n", (int) cameras.size(),
+				maxViews);
+		return false;
+	}
+	return true;
+}
+
+void layoutViews(const std::vector<Camera> &cameras, int width, int height,
+		std::vector<View> &views) {
+	const int count = (int) cameras.size();
+	views.resize(count);
+	if (count == 0)
+		return;
+	int columns = (int) ceil(sqrt((double) count));
+	int rows = (count + columns - 1) / columns;
+	for (int i = 0; i < count; i++) {
+		int column = i % columns, row = i / columns;
+		View &view = views[i];
+		view.camera = cameras[i];
+		// row 0 at the top, and GL counts from the bottom
+		view.x = width * column / columns;
+		view.width = width * (column + 1) / columns - view.x;
+		view.y = height - height * (row + 1) / rows;
+		view.height = height - height * row / rows - view.y;
+		view.projection = matrixPerspective(viewFieldOfView,
+				(float) view.width / (float) (view.height > 0 ? view.height : 1),
+				viewNear, viewFar);
+	}
+}
+
+int viewAt(const std::vector<View> &views, double x, double y) {
+	for (int i = 0; i < (int) views.size(); i++) {
+		const View &view = views[i];
+		if (x >= view.x && x < view.x + view.width && y >= view.y
+				&& y < view.y + view.height)
+			return i;
+	}
+	return -1;
+}
+
+void viewRay(const View &view, double x, double y, double origin[3],
+		double direction[3], double *pixelSlope) {
+	const float *p = view.projection.m;
+	const int height = view.height > 0 ? view.height : 1;
+	// through the point on the plane at distance 1 in front of the eye
+	double ndcX = 2.0 * (x - view.x) / (view.width > 0 ? view.width : 1) - 1.0;
+	double ndcY = 2.0 * (y - view.y) / height - 1.0;
+	const double eyeRay[3] = { ndcX / p[0], ndcY / p[5], -1.0 };
+
+	// the look-at matrix's rows are the camera's axes
+	Matrix4 look = matrixLookAt(view.camera);
+	double length = 0.0;
+	for (int c = 0; c < 3; c++) {
+		direction[c] = eyeRay[0] * look.m[c * 4] + eyeRay[1] * look.m[c * 4 + 1]
+				+ eyeRay[2] * look.m[c * 4 + 2];
+		length += direction[c] * direction[c];
+	}
+	length = sqrt(length);
+	for (int c = 0; c < 3; c++)
+		direction[c] /= length;
+	origin[0] = view.camera.eyeX;
+	origin[1] = view.camera.eyeY;
+	origin[2] = view.camera.eyeZ;
+	*pixelSlope = 2.0 / (height * p[5]);
+}
@@ -0,0 +1,53 @@
+/* Split-screen views.
+ *
+ * The window can show several cameras at once, the four presets or any
+ * others, each in its own tile of a grid. The renderers draw them all from
+ * one frame's worth of positions and transforms, culling the bodies against
+ * every view in a single pass over the table: the fixed-function one then
+ * draws each view in turn, and the shader one every view with each
+ * instanced call.
+ */
+
+#ifndef VIEWS_H
+#define VIEWS_H
+
+#include <vector>
+
+#include "camera.h"
+#include "matrix.h"
+
+// The perspective every view is drawn with.
+const float viewFieldOfView = 60.0f;  // vertical, in degrees
+const float viewNear = 1.0f, viewFar = 40.0f;
+
+// The most views a frame can show.
+const int maxViews = 16;
+
+// A camera and the part of the window it draws into.
+struct View {
+	Camera camera;
+	Matrix4 projection;       // for the aspect of its tile
+	int x, y, width, height;  // the tile in pixels, from the bottom left
+};
+
+// Reads a comma-separated list of cameras: preset names, "all" for the
+// four presets, or eye positions X:Y:Z looking at the sun. Prints the
+// problem and returns false on a bad entry or more than maxViews cameras.
+bool parseViewCameras(const char *list, std::vector<Camera> &cameras);
+
+// Lays cameras out in a grid over a width x height window, filling the rows
+// from the top left, as square as their number allows.
+void layoutViews(const std::vector<Camera> &cameras, int width, int height,
+		std::vector<View> &views);
+
+// The view whose tile holds the window point x, y, from the bottom left,
+// or -1.
+int viewAt(const std::vector<View> &views, double x, double y);
+
+// The ray from view's eye through the window point x, y, as a unit
+// direction, and how much wider a pixel of the view gets per unit of
+// distance along it.
+void viewRay(const View &view, double x, double y, double origin[3],
+		double direction[3], double *pixelSlope);
+
+#endif
@@ -0,0 +1,287 @@
+/* Bakes 24-bit BMP textures into a single texture pack (see texpack.h).
+ *
+ *   bake [--dxt1] output.pack texture.bmp...
+ *
+ * Every texture gets a full mip chain, built with a 2x2 box filter. With
+ * --dxt1 each level is compressed to S3TC DXT1, 6 times smaller than RGB.
+ * Entries are named by the paths given on the command line, so pass them
+ * as they are written in bodies.cfg.
+ *
+ * Build: compile this file with src/image.cpp, src/mappedfile.cpp and
+ * src/texpack.cpp.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/image.h"
+#include "../src/texpack.h"
+
+// One mip level as tightly packed RGB.
+struct Level {
+	uint32_t width, height;
+	std::vector<unsigned char> rgb;
+};
+
+// Copies a loaded BMP into a tightly packed RGB level.
+static Level levelFromImage(const Image &image) {
+	Level level;
+	size_t stride = (image.sizeX * 3 + 3) & ~(size_t) 3;
+	level.width = image.sizeX;
+	level.height = image.sizeY;
+	level.rgb.resize((size_t) level.width * level.height * 3);
+	for (uint32_t y = 0; y < level.height; y++)
+		memcpy(&level.rgb[(size_t) y * level.width * 3], image.data + y * stride,
+				(size_t) level.width * 3);
+	return level;
+}
+
+// Halves a level with a 2x2 box filter; odd edges repeat their last texel.
+static Level downsample(const Level &src) {
+	Level dst;
+	dst.width = src.width > 1 ? src.width / 2 : 1;
+	dst.height = src.height > 1 ? src.height / 2 : 1;
+	dst.rgb.resize((size_t) dst.width * dst.height * 3);
+	for (uint32_t y = 0; y < dst.height; y++) {
+		uint32_t y0 = y * 2, y1 = y0 + 1 < src.height ? y0 + 1 : y0;
+		for (uint32_t x = 0; x < dst.width; x++) {
+			uint32_t x0 = x * 2, x1 = x0 + 1 < src.width ? x0 + 1 : x0;
+			for (int c = 0; c < 3; c++) {
+				unsigned sum = src.rgb[((size_t) y0 * src.width + x0) * 3 + c]
+						+ src.rgb[((size_t) y0 * src.width + x1) * 3 + c]
+						+ src.rgb[((size_t) y1 * src.width + x0) * 3 + c]
+						+ src.rgb[((size_t) y1 * src.width + x1) * 3 + c];
+				dst.rgb[((size_t) y * dst.width + x) * 3 + c] =
+						(unsigned char) ((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+static uint16_t packRGB565(const float c[3]) {
+	int r = (int) (c[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int) (c[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int) (c[2] * 31.0f / 255.0f + 0.5f);
+	r = r < 0 ? 0 : r > 31 ? 31 : r;
+	g = g < 0 ? 0 : g > 63 ? 63 : g;
+	b = b < 0 ? 0 : b > 31 ? 31 : b;
+	return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t v, float c[3]) {
+	c[0] = (float) ((v >> 11) & 31) * 255.0f / 31.0f;
+	c[1] = (float) ((v >> 5) & 63) * 255.0f / 63.0f;
+	c[2] = (float) (v & 31) * 255.0f / 31.0f;
+}
+
+// Encodes one 4x4 block: the end points are the extremes of the block's
+// colours along their principal axis, found by power iteration on the
+// covariance matrix.
+static void encodeBlock(const float texels[16][3], unsigned char out[8]) {
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++)
+			mean[c] += texels[i][c] / 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1],
+				texels[i][2] - mean[2] };
+		cov[0] += d[0] * d[0];
+		cov[1] += d[0] * d[1];
+		cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1];
+		cov[4] += d[1] * d[2];
+		cov[5] += d[2] * d[2];
+	}
+	float axis[3] = { 1, 1, 1 };
+	for (int k = 0; k < 8; k++) {
+		float a[3] = { cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+		float len = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+		if (len < 1e-6f)
+			break;
+		for (int c = 0; c < 3; c++)
+			axis[c] = a[c] / len;
+	}
+
+	float lo = 1e30f, hi = -1e30f;
+	for (int i = 0; i < 16; i++) {
+		float t = (texels[i][0] - mean[0]) * axis[0]
+				+ (texels[i][1] - mean[1]) * axis[1]
+				+ (texels[i][2] - mean[2]) * axis[2];
+		lo = t < lo ? t : lo;
+		hi = t > hi ? t : hi;
+	}
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++) {
+		end0[c] = mean[c] + axis[c] * hi;
+		end1[c] = mean[c] + axis[c] * lo;
+	}
+	uint16_t c0 = packRGB565(end0), c1 = packRGB565(end1);
+	// colour0 > colour1 selects the four-colour mode
+	if (c0 < c1) {
+		uint16_t t = c0;
+		c0 = c1;
+		c1 = t;
+	}
+
+	float palette[4][3];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+		palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			float bestError = 1e30f;
+			for (int p = 0; p < 4; p++) {
+				float e = 0;
+				for (int c = 0; c < 3; c++)
+					e += (texels[i][c] - palette[p][c])
+							* (texels[i][c] - palette[p][c]);
+				if (e < bestError) {
+					bestError = e;
+					best = p;
+				}
+			}
+			indices |= (uint32_t) best << (2 * i);
+		}
+	}
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// Compresses a level block by block, clamping blocks that overhang the
+// edge of small levels.
+static std::vector<unsigned char> encodeDXT1(const Level &level) {
+	uint32_t bw = (level.width + 3) / 4, bh = (level.height + 3) / 4;
+	std::vector<unsigned char> out((size_t) bw * bh * 8);
+	for (uint32_t by = 0; by < bh; by++) {
+		for (uint32_t bx = 0; bx < bw; bx++) {
+			float texels[16][3];
+			for (uint32_t i = 0; i < 16; i++) {
+				uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+				x = x < level.width ? x : level.width - 1;
+				y = y < level.height ? y : level.height - 1;
+				for (int c = 0; c < 3; c++)
+					texels[i][c] = level.rgb[((size_t) y * level.width + x) * 3 + c];
+			}
+			encodeBlock(texels, &out[((size_t) by * bw + bx) * 8]);
+		}
+	}
+	return out;
+}
+
+static uint64_t align16(uint64_t offset) {
+	return (offset + 15) & ~(uint64_t) 15;
+}
+
+int main(int argc, char **argv) {
+	uint32_t format = TEXPACK_RGB8;
+	int first = 1;
+
+	if (argc > 1 && strcmp(argv[1], "--dxt1") == 0) {
+		format = TEXPACK_DXT1;
+		first++;
+	}
+	if (argc - first < 2) {
+		printf("usage: %s [--dxt1] output.pack texture.bmp...\n", argv[0]);
+		return 1;
+	}
+	const char *output = argv[first++];
+
+	std::vector<TexPackEntry> entries;
+	std::vector<TexPackLevel> levels;
+	std::vector<std::vector<unsigned char> > payloads;
+
+	for (int i = first; i < argc; i++) {
+		Image image;
+		TexPackEntry entry;
+
+		if (strlen(argv[i]) >= sizeof(entry.name)) {
+			printf("Name too long for a pack entry: %s\n", argv[i]);
+			return 1;
+		}
+		if (!ImageLoad(argv[i], &image))
+			return 1;
+
+		memset(&entry, 0, sizeof(entry));
+		strcpy(entry.name, argv[i]);
+		entry.format = format;
+		entry.width = image.sizeX;
+		entry.height = image.sizeY;
+		entry.firstLevel = levels.size();
+
+		Level level = levelFromImage(image);
+		ImageFree(&image);
+		for (;;) {
+			TexPackLevel info;
+			info.width = level.width;
+			info.height = level.height;
+			info.offset = 0;
+			if (format == TEXPACK_DXT1)
+				payloads.push_back(encodeDXT1(level));
+			else
+				payloads.push_back(level.rgb);
+			info.size = payloads.back().size();
+			levels.push_back(info);
+			entry.levelCount++;
+			if (level.width == 1 && level.height == 1)
+				break;
+			level = downsample(level);
+		}
+		entries.push_back(entry);
+		printf("%s: %ux%u, %u levels\n", argv[i], entry.width, entry.height,
+				entry.levelCount);
+	}
+
+	TexPackHeader header;
+	memcpy(header.magic, TEXPACK_MAGIC, 4);
+	header.version = TEXPACK_VERSION;
+	header.entryCount = entries.size();
+	header.levelCount = levels.size();
+
+	uint64_t offset = sizeof(header) + entries.size() * sizeof(TexPackEntry)
+			+ levels.size() * sizeof(TexPackLevel);
+	for (size_t i = 0; i < levels.size(); i++) {
+		offset = align16(offset);
+		levels[i].offset = offset;
+		offset += levels[i].size;
+	}
+
+	FILE *file = fopen(output, "wb");
+	if (file == NULL) {
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(&entries[0], sizeof(TexPackEntry), entries.size(), file);
+	fwrite(&levels[0], sizeof(TexPackLevel), levels.size(), file);
+	for (size_t i = 0; i < levels.size(); i++) {
+		static const char zeros[16] = { 0 };
+		fwrite(zeros, 1, levels[i].offset - ftell(file), file);
+		fwrite(&payloads[i][0], 1, payloads[i].size(), file);
+	}
+	if (fclose(file) != 0) {
+		printf("Error writing %s\n", output);
+		return 1;
+	}
+	printf("Wrote %s: %u textures, %llu bytes\n", output,
+			(unsigned) entries.size(), (unsigned long long) offset);
+	return 0;
+}
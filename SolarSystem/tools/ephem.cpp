@@ -0,0 +1,367 @@
+/* Writes an ephemeris (see ephemeris.h) from tables of positions.
+ *
+ *   ephem [--span DAYS] [--degree N] output.eph [[--body NAME] table.csv]...
+ *
+ * Two kinds of table are read, in any mix:
+ *   - Vector tables exported from JPL Horizons as CSV: the positions lie
+ *     between $$SOE and $$EOE, a Julian day, the calendar date and then X,
+ *     Y and Z on every line, and the body is named by the "Target body
+ *     name" line of the header.
+ *   - Lines of a body name, a Julian day and X, Y and Z, separated by
+ *     commas, spaces or tabs.
+ * Positions are ecliptic and relative to the body's parent in bodies.cfg,
+ * in any unit, each body's in time order; lines that are not positions,
+ * such as headers, are skipped. --body names the body of the tables after
+ * it, overriding Horizons' name. Without tables the lines are read from
+ * standard input.
+ *
+ * The tables are read a line at a time, and each body's positions are
+ * fitted as soon as a segment of --span days (8) is complete, so only one
+ * segment's worth of them is ever held. Every segment is a series of
+ * degree --degree (7). A body's last segment is dropped unless its
+ * positions reach its end. The largest error of the fit at the positions
+ * is printed for every body, as a fraction of its mean distance.
+ *
+ * Build: compile this file with src/mappedfile.cpp and src/ephemeris.cpp.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/ephemeris.h"
+
+// Julian day of J2000.
+static const double j2000 = 2451545.0;
+
+static double span = 8.0;
+static int degree = 7;
+
+// One body being fitted.
+struct BodyFit {
+	std::string name;
+	double start;  // of the segment being filled
+	bool started;
+	// the positions of the segment being filled
+	std::vector<double> times, values[3];
+	// of the finished segments
+	std::vector<double> coefficients;
+	uint32_t segments;
+	double first;  // day of the first position
+	double distanceSum;
+	long positions;
+	double worst;  // largest error of the fit
+};
+
+static std::vector<BodyFit> fits;
+static std::map<std::string, size_t> fitIndex;  // by the lower case name
+
+static std::string lowerCase(const std::string &text) {
+	std::string lower = text;
+	for (size_t i = 0; i < lower.size(); i++)
+		lower[i] = (char) tolower((unsigned char) lower[i]);
+	return lower;
+}
+
+// The value of a series of degree at s in [-1, 1].
+static double chebyshev(const double *c, double s) {
+	double b1 = 0.0, b2 = 0.0;
+	for (int k = degree; k > 0; k--) {
+		double b = 2.0 * s * b1 - b2 + c[k];
+		b2 = b1;
+		b1 = b;
+	}
+	return s * b1 - b2 + c[0];
+}
+
+// Fits the segment of fit being filled and starts the next one, which keeps
+// the positions on the boundary.
+static void finishSegment(BodyFit &fit) {
+	const int count = (int) fit.times.size();
+	const size_t base = fit.coefficients.size();
+	fit.coefficients.resize(base + 3 * (degree + 1));
+	for (int axis = 0; axis < 3; axis++) {
+		double *c = &fit.coefficients[base + axis * (degree + 1)];
+		fitChebyshev(&fit.times[0], &fit.values[axis][0], count, fit.start,
+				span, degree, c);
+		for (int i = 0; i < count; i++) {
+			double s = 2.0 * (fit.times[i] - fit.start) / span - 1.0;
+			fit.worst = fmax(fit.worst, fabs(chebyshev(c, s)
+					- fit.values[axis][i]));
+		}
+	}
+	fit.segments++;
+	fit.start += span;
+
+	size_t keep = 0;
+	for (int i = 0; i < count; i++) {
+		if (fit.times[i] < fit.start)
+			continue;
+		fit.times[keep] = fit.times[i];
+		for (int axis = 0; axis < 3; axis++)
+			fit.values[axis][keep] = fit.values[axis][i];
+		keep++;
+	}
+	fit.times.resize(keep);
+	for (int axis = 0; axis < 3; axis++)
+		fit.values[axis].resize(keep);
+}
+
+// Adds a position of the named body at a Julian day. Returns false, printing
+// why, if it cannot be fitted.
+static bool addPosition(const std::string &name, double julianDay,
+		const double xyz[3]) {
+	const std::string key = lowerCase(name);
+	std::map<std::string, size_t>::iterator found = fitIndex.find(key);
+	if (found == fitIndex.end()) {
+		if (name.size() >= sizeof(((EphemerisBody *) 0)->name)) {
+			printf("Body name too long: %s\n", name.c_str());
+			return false;
+		}
+		BodyFit fit;
+		fit.name = name;
+		fit.started = false;
+		fit.segments = 0;
+		fit.distanceSum = 0.0;
+		fit.positions = 0;
+		fit.worst = 0.0;
+		found = fitIndex.insert(std::make_pair(key, fits.size())).first;
+		fits.push_back(fit);
+	}
+	BodyFit &fit = fits[found->second];
+
+	const double days = julianDay - j2000;
+	if (!fit.started) {
+		fit.start = fit.first = days;
+		fit.started = true;
+	} else if (days < fit.times.back()) {
+		printf("%s: the positions are not in time order at JD %.6f\n",
+				name.c_str(), julianDay);
+		return false;
+	}
+	while (days > fit.start + span) {
+		if (fit.times.empty() || fit.times.back() < fit.start + span * 0.5) {
+			printf("%s: too few positions between JD %.6f and %.6f for a "
+					"span of %g days\n", name.c_str(), fit.start + j2000,
+					fit.start + span + j2000, span);
+			return false;
+		}
+		finishSegment(fit);
+	}
+	fit.times.push_back(days);
+	for (int axis = 0; axis < 3; axis++)
+		fit.values[axis].push_back(xyz[axis]);
+	fit.distanceSum += sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]
+			+ xyz[2] * xyz[2]);
+	fit.positions++;
+	return true;
+}
+
+static bool parseNumber(const std::string &text, double *value) {
+	const char *start = text.c_str();
+	char *end;
+	*value = strtod(start, &end);
+	while (isspace((unsigned char) *end))
+		end++;
+	return end != start && *end == '\0';
+}
+
+// Splits a line at commas, or at spaces and tabs if it has none, trimming
+// the fields.
+static void splitFields(const char *line, std::vector<std::string> &fields) {
+	fields.clear();
+	const bool commas = strchr(line, ',') != NULL;
+	std::string field;
+	for (const char *p = line;; p++) {
+		bool end = *p == '\0' || *p == '\n' || *p == '\r';
+		if (end || (commas ? *p == ',' : isspace((unsigned char) *p))) {
+			size_t a = field.find_first_not_of(" \t");
+			size_t b = field.find_last_not_of(" \t");
+			if (a != std::string::npos)
+				fields.push_back(field.substr(a, b - a + 1));
+			else if (commas && !end)
+				fields.push_back("");
+			field.clear();
+			if (end)
+				return;
+		} else
+			field += *p;
+	}
+}
+
+// Reads the positions of a table; body, if not empty, names them. Returns
+// false, printing why, on positions that cannot be fitted.
+static bool readTable(FILE *file, const std::string &body) {
+	char line[4096];
+	std::string target = body;
+	bool horizons = false, inTable = false;
+	std::vector<std::string> fields;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (strncmp(line, "Target body name:", 17) == 0) {
+			horizons = true;
+			if (body.empty()) {
+				char name[64];
+				if (sscanf(line + 17, "%63s", name) == 1)
+					target = name;
+			}
+			continue;
+		}
+		if (strncmp(line, "$$SOE", 5) == 0) {
+			horizons = inTable = true;
+			continue;
+		}
+		if (strncmp(line, "$$EOE", 5) == 0) {
+			inTable = false;
+			continue;
+		}
+		if (horizons && !inTable)
+			continue;
+
+		splitFields(line, fields);
+		double julianDay, xyz[3];
+		size_t next;
+		std::string name;
+		if (fields.size() >= 4 && parseNumber(fields[0], &julianDay)) {
+			// Horizons: the Julian day, maybe the calendar date, X, Y, Z
+			name = target;
+			next = 1;
+			if (!parseNumber(fields[1], &xyz[0]))
+				next = 2;
+		} else if (fields.size() >= 5 && parseNumber(fields[1], &julianDay)) {
+			name = body.empty() ? fields[0] : body;
+			next = 2;
+		} else
+			continue;
+		if (fields.size() < next + 3 || name.empty()
+				|| !parseNumber(fields[next], &xyz[0])
+				|| !parseNumber(fields[next + 1], &xyz[1])
+				|| !parseNumber(fields[next + 2], &xyz[2]))
+			continue;
+		if (!addPosition(name, julianDay, xyz))
+			return false;
+	}
+	return true;
+}
+
+static void usage(const char *program) {
+	printf("usage: %s [--span DAYS] [--degree N] output.eph "
+			"[[--body NAME] table.csv]...\n", program);
+}
+
+int main(int argc, char **argv) {
+	int arg = 1;
+	for (; arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+		if (strcmp(argv[arg], "--span") == 0) {
+			span = atof(argv[arg + 1]);
+			if (!(span > 0.0)) {
+				printf("Bad span: %s\n", argv[arg + 1]);
+				return 1;
+			}
+		} else if (strcmp(argv[arg], "--degree") == 0) {
+			degree = atoi(argv[arg + 1]);
+			if (degree < 1 || degree > maxChebyshevDegree) {
+				printf("Bad degree: %s, from 1 to %d\n", argv[arg + 1],
+						maxChebyshevDegree);
+				return 1;
+			}
+		} else
+			break;
+	}
+	if (arg >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	const char *output = argv[arg++];
+
+	std::string body;
+	bool readAny = false;
+	for (; arg < argc; arg++) {
+		if (strcmp(argv[arg], "--body") == 0 && arg + 1 < argc) {
+			body = argv[++arg];
+			continue;
+		}
+		FILE *table = fopen(argv[arg], "r");
+		if (table == NULL) {
+			printf("File Not Found : %s\n", argv[arg]);
+			return 1;
+		}
+		bool ok = readTable(table, body);
+		fclose(table);
+		if (!ok)
+			return 1;
+		readAny = true;
+	}
+	if (!readAny && !readTable(stdin, body))
+		return 1;
+
+	// every body's last segment, if its positions reach its end
+	std::vector<EphemerisBody> entries;
+	uint64_t offset = sizeof(EphemerisHeader);
+	for (size_t i = 0; i < fits.size(); i++)
+		offset += sizeof(EphemerisBody);
+	for (size_t i = 0; i < fits.size(); i++) {
+		BodyFit &fit = fits[i];
+		if (!fit.times.empty() && fit.times.back() >= fit.start + span * 0.999)
+			finishSegment(fit);
+		double dropped = fit.times.empty() ? 0.0
+				: fit.times.back() - fit.start;
+		EphemerisBody entry;
+		memset(&entry, 0, sizeof(entry));
+		strcpy(entry.name, fit.name.c_str());
+		entry.start = fit.first;
+		entry.span = span;
+		entry.segmentCount = fit.segments;
+		entry.degree = degree;
+		entry.offset = offset;
+		entry.meanDistance = fit.distanceSum / fit.positions;
+		if (fit.segments == 0) {
+			printf("%s: fewer than %g days of positions, skipped\n",
+					fit.name.c_str(), span);
+			continue;
+		}
+		offset += fit.coefficients.size() * sizeof(double);
+		entries.push_back(entry);
+		printf("%s: %u segments from JD %.2f to %.2f, largest error %.2g of "
+				"the mean distance", fit.name.c_str(), fit.segments,
+				fit.first + j2000, fit.first + fit.segments * span + j2000,
+				fit.worst / entry.meanDistance);
+		if (dropped > 0.0)
+			printf(", last %.2f days dropped", dropped);
+		printf("\n");
+	}
+	// the offsets assumed every body was kept
+	const uint64_t skipped = (fits.size() - entries.size())
+			* sizeof(EphemerisBody);
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i].offset -= skipped;
+
+	EphemerisHeader header;
+	memcpy(header.magic, EPHEMERIS_MAGIC, 4);
+	header.version = EPHEMERIS_VERSION;
+	header.bodyCount = entries.size();
+	header.reserved = 0;
+
+	FILE *file = fopen(output, "wb");
+	if (file == NULL) {
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	if (!entries.empty())
+		fwrite(&entries[0], sizeof(EphemerisBody), entries.size(), file);
+	for (size_t i = 0; i < fits.size(); i++)
+		if (fits[i].segments > 0)
+			fwrite(&fits[i].coefficients[0], sizeof(double),
+					fits[i].coefficients.size(), file);
+	if (fclose(file) != 0) {
+		printf("Error writing %s\n", output);
+		return 1;
+	}
+	printf("Wrote %s: %u bodies\n", output, (unsigned) entries.size());
+	return 0;
+}
@@ -0,0 +1,92 @@
+/* Writes a star catalog (see starcatalog.h).
+ *
+ *   starcat output.cat [table.txt]
+ *   starcat --generate N output.cat
+ *
+ * The table holds one star per line: right ascension and declination in
+ * degrees (J2000), visual magnitude and B-V colour index, separated by
+ * spaces, tabs or commas, as they can be cut from the Hipparcos main
+ * catalogue. Lines that do not start with four numbers, such as headers,
+ * are skipped. Without a table the lines are read from standard input.
+ * --generate writes N stars of the sky that is drawn without a catalog.
+ *
+ * Build: compile this file with src/mappedfile.cpp and src/starcatalog.cpp.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/starcatalog.h"
+
+// Reads the stars of a table, skipping the lines that are not stars.
+static void readTable(FILE *file, std::vector<StarRecord> &stars) {
+	char line[1024];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		for (char *p = line; *p != '\0'; p++)
+			if (*p == ',')
+				*p = ' ';
+		float ra, dec, magnitude, colorIndex;
+		if (sscanf(line, "%f %f %f %f", &ra, &dec, &magnitude,
+				&colorIndex) != 4)
+			continue;
+		StarRecord star;
+		star.rightAscension = (float) (ra * M_PI / 180.0);
+		star.declination = (float) (dec * M_PI / 180.0);
+		star.magnitude = magnitude;
+		star.colorIndex = colorIndex;
+		stars.push_back(star);
+	}
+}
+
+int main(int argc, char **argv) {
+	std::vector<StarRecord> stars;
+	const char *output;
+
+	if (argc == 4 && strcmp(argv[1], "--generate") == 0) {
+		int count = atoi(argv[2]);
+		if (count <= 0) {
+			printf("Bad star count: %s\n", argv[2]);
+			return 1;
+		}
+		generateStars(count, 1, stars);
+		output = argv[3];
+	} else if (argc == 2 || argc == 3) {
+		output = argv[1];
+		FILE *table = argc == 3 ? fopen(argv[2], "r") : stdin;
+		if (table == NULL) {
+			printf("File Not Found : %s\n", argv[2]);
+			return 1;
+		}
+		readTable(table, stars);
+		if (table != stdin)
+			fclose(table);
+	} else {
+		printf("usage: %s output.cat [table.txt]\n"
+				"       %s --generate N output.cat\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	StarCatalogHeader header;
+	memcpy(header.magic, STARCAT_MAGIC, 4);
+	header.version = STARCAT_VERSION;
+	header.starCount = stars.size();
+	header.reserved = 0;
+
+	FILE *file = fopen(output, "wb");
+	if (file == NULL) {
+		printf("Cannot write %s\n", output);
+		return 1;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	if (!stars.empty())
+		fwrite(&stars[0], sizeof(StarRecord), stars.size(), file);
+	if (fclose(file) != 0) {
+		printf("Error writing %s\n", output);
+		return 1;
+	}
+	printf("Wrote %s: %u stars\n", output, (unsigned) stars.size());
+	return 0;
+}